@@ -0,0 +1,10 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Byte swaps count words from src into dst, uses SSSE3 when available.
+//  src and dst may be the same but must not otherwise overlap.
+void
+byte_swap_array(uint32_t *dst,
+                const uint32_t *src,
+                std::size_t count);
@@ -0,0 +1,146 @@
+#pragma once
+#include "ticketlock.h"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// A bounded multiple producer, single consumer queue.
+//
+// Producers are serialised by a ticket lock, which is not contended in
+//  practice.  Past that neither push nor tryPop take a mutex, it is only used
+//  to put the consumer to sleep in waitPop or producers to sleep in push
+//  while the queue is full, and the other side only touches it when someone
+//  is actually sleeping.
+template<typename Type, std::size_t Capacity>
+class MpscQueue
+{
+   static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+   // Can be called from any thread, blocks while the queue is full
+   void push(const Type &value)
+   {
+      while (!tryPush(value)) {
+         waitForSpace();
+      }
+
+      // The store of mTail in tryPush must be ordered before this load,
+      //  which pairs with the store of mConsumerSleeping and load of mTail
+      //  in waitPop.
+      if (mConsumerSleeping.load(std::memory_order_seq_cst)) {
+         std::unique_lock<std::mutex> lock { mSleepMutex };
+         mDataCV.notify_one();
+      }
+   }
+
+   // Must only be called from the consumer thread
+   bool tryPop(Type &value)
+   {
+      auto head = mHead.load(std::memory_order_relaxed);
+
+      if (head == mTail.load(std::memory_order_acquire)) {
+         return false;
+      }
+
+      value = mData[head & (Capacity - 1)];
+
+      // Pairs with the store of mProducersSleeping and load of mHead in
+      //  waitForSpace
+      mHead.store(head + 1, std::memory_order_seq_cst);
+
+      if (mProducersSleeping.load(std::memory_order_seq_cst)) {
+         std::unique_lock<std::mutex> lock { mSleepMutex };
+         mSpaceCV.notify_all();
+      }
+
+      return true;
+   }
+
+   // Must only be called from the consumer thread, blocks until a value is
+   //  available or wake is called.  Returns false for the latter.
+   bool waitPop(Type &value)
+   {
+      while (true) {
+         if (tryPop(value)) {
+            return true;
+         }
+
+         if (mWakeRequested.exchange(false)) {
+            return false;
+         }
+
+         std::unique_lock<std::mutex> lock { mSleepMutex };
+         mConsumerSleeping.store(true, std::memory_order_seq_cst);
+
+         // Check again now that the producer is guaranteed to see us sleeping
+         if (mHead.load(std::memory_order_relaxed) == mTail.load(std::memory_order_seq_cst)
+          && !mWakeRequested.load(std::memory_order_seq_cst)) {
+            mDataCV.wait(lock);
+         }
+
+         mConsumerSleeping.store(false, std::memory_order_relaxed);
+      }
+   }
+
+   // Wakes the consumer out of waitPop, can be called from any thread
+   void wake()
+   {
+      mWakeRequested.store(true, std::memory_order_seq_cst);
+
+      if (mConsumerSleeping.load(std::memory_order_seq_cst)) {
+         std::unique_lock<std::mutex> lock { mSleepMutex };
+         mDataCV.notify_one();
+      }
+   }
+
+   bool empty() const
+   {
+      return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+   }
+
+private:
+   bool tryPush(const Type &value)
+   {
+      std::unique_lock<TicketLock> producerLock { mProducerLock };
+      auto tail = mTail.load(std::memory_order_relaxed);
+
+      if (tail - mHead.load(std::memory_order_acquire) == Capacity) {
+         return false;
+      }
+
+      mData[tail & (Capacity - 1)] = value;
+      mTail.store(tail + 1, std::memory_order_seq_cst);
+      return true;
+   }
+
+   // Sleeps until the consumer has made space, without holding the producer
+   //  lock so other producers do not spin on it meanwhile.
+   void waitForSpace()
+   {
+      std::unique_lock<std::mutex> lock { mSleepMutex };
+      mProducersSleeping.fetch_add(1, std::memory_order_seq_cst);
+
+      // Check again now that the consumer is guaranteed to see us sleeping
+      while (mTail.load(std::memory_order_seq_cst) - mHead.load(std::memory_order_seq_cst) == Capacity) {
+         mSpaceCV.wait(lock);
+      }
+
+      mProducersSleeping.fetch_sub(1, std::memory_order_relaxed);
+   }
+
+private:
+   // Keep the producer and consumer indices on separate cache lines
+   alignas(64) std::atomic<std::size_t> mHead { 0 };
+   alignas(64) std::atomic<std::size_t> mTail { 0 };
+   TicketLock mProducerLock;
+   alignas(64) std::atomic<bool> mConsumerSleeping { false };
+   std::atomic<uint32_t> mProducersSleeping { 0 };
+   std::atomic<bool> mWakeRequested { false };
+   std::mutex mSleepMutex;
+   std::condition_variable mDataCV;
+   std::condition_variable mSpaceCV;
+   std::array<Type, Capacity> mData;
+};
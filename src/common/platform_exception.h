@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <functional>
 
 namespace platform
@@ -20,6 +21,9 @@ struct Exception
    }
 
    Type type;
+
+   //! Host address of the instruction which raised the exception
+   uint64_t instructionPointer = 0;
 };
 
 struct AccessViolationException : Exception
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <functional>
 
 namespace platform
@@ -8,15 +9,25 @@ struct Fiber;
 
 using FiberEntryPoint = std::function<void(void *)>;
 
+static const size_t
+DefaultFiberStackSize = 1024 * 1024;
+
 Fiber *
 getThreadFiber();
 
 Fiber *
-createFiber(FiberEntryPoint entry, void *entryParam);
+createFiber(FiberEntryPoint entry, void *entryParam, size_t stackSize = DefaultFiberStackSize);
 
 void
 destroyFiber(Fiber *fiber);
 
+// Puts a fiber back into the state createFiber left it in, so that it starts
+//  from its entry point again next time it is switched to.  The memory of its
+//  stack is released to the OS until then.  Must not be called on the fiber
+//  which is currently running.
+void
+resetFiber(Fiber *fiber);
+
 void
 swapToFiber(Fiber *current, Fiber *target);
 
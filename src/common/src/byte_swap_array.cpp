@@ -0,0 +1,69 @@
+#include "byte_swap.h"
+#include "byte_swap_array.h"
+#include "platform.h"
+#include <tmmintrin.h>
+
+#ifdef PLATFORM_WINDOWS
+#include <intrin.h>
+#define SSSE3_TARGET
+#else
+#include <cpuid.h>
+#define SSSE3_TARGET __attribute__((target("ssse3")))
+#endif
+
+static bool
+hostHasSSSE3()
+{
+   static const bool hasSSSE3 = []() {
+#ifdef PLATFORM_WINDOWS
+      int cpuInfo[4];
+      __cpuid(cpuInfo, 1);
+      return (cpuInfo[2] & (1 << 9)) != 0;
+#else
+      unsigned int eax, ebx, ecx, edx;
+
+      if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+         return false;
+      }
+
+      return (ecx & bit_SSSE3) != 0;
+#endif
+   }();
+
+   return hasSSSE3;
+}
+
+SSSE3_TARGET static void
+byteSwapArraySSSE3(uint32_t *dst,
+                   const uint32_t *src,
+                   std::size_t count)
+{
+   const auto mask = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+   auto i = std::size_t { 0 };
+
+   for (; i + 8 <= count; i += 8) {
+      auto words0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+      auto words1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 4));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_shuffle_epi8(words0, mask));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 4), _mm_shuffle_epi8(words1, mask));
+   }
+
+   for (; i < count; ++i) {
+      dst[i] = byte_swap(src[i]);
+   }
+}
+
+void
+byte_swap_array(uint32_t *dst,
+                const uint32_t *src,
+                std::size_t count)
+{
+   if (hostHasSSSE3()) {
+      byteSwapArraySSSE3(dst, src, count);
+      return;
+   }
+
+   for (auto i = std::size_t { 0 }; i < count; ++i) {
+      dst[i] = byte_swap(src[i]);
+   }
+}
@@ -81,10 +81,18 @@ dispatchException(Exception *exception,
    return;
 }
 
+static uint64_t
+getInstructionPointer(void *context)
+{
+   auto ctx = reinterpret_cast<ucontext_t *>(context);
+   return static_cast<uint64_t>(ctx->uc_mcontext.gregs[REG_RIP]);
+}
+
 static void
 segvHandler(int signum, siginfo_t *info, void *context)
 {
    auto exception = AccessViolationException { reinterpret_cast<uint64_t>(info->si_addr) };
+   exception.instructionPointer = getInstructionPointer(context);
    dispatchException(&exception, context, signum, &sSegvHandler, &sSystemSegvHandler);
 }
 
@@ -92,6 +100,7 @@ static void
 illHandler(int signum, siginfo_t *info, void *context)
 {
    auto exception = InvalidInstructionException { };
+   exception.instructionPointer = getInstructionPointer(context);
    dispatchException(&exception, context, signum, &sIllHandler, &sSystemIllHandler);
 }
 
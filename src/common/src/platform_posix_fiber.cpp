@@ -1,34 +1,113 @@
 #include "platform.h"
 #include "platform_fiber.h"
+#include "align.h"
+#include "decaf_assert.h"
 #include "log.h"
 
 #ifdef PLATFORM_POSIX
-#include <array>
-#include <errno.h>
-#include <signal.h>
-#include <ucontext.h>
+#include <cstdint>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #ifdef DECAF_VALGRIND
    #include <valgrind/valgrind.h>
 #endif
 
+// glibc's swapcontext makes a rt_sigprocmask syscall on every switch, on
+//  x86-64 we use our own switch which only saves what the ABI requires.
+#if defined(__x86_64__)
+#define FIBER_USE_ASM_SWITCH
+#else
+#include <ucontext.h>
+#endif
+
+#ifdef FIBER_USE_ASM_SWITCH
+
+#ifdef PLATFORM_APPLE
+#define FIBER_ASM_SYMBOL(name) "_" #name
+#else
+#define FIBER_ASM_SYMBOL(name) #name
+#endif
+
+// Saves the callee-saved registers, MXCSR and the x87 control word on the
+//  current stack, stores the stack pointer to *saveStack and then restores
+//  the same from loadStack.
+extern "C" void
+platformFiberSwitch(void **saveStack, void *loadStack);
+
+// The first return address of a new fiber, calls r13(r12).
+extern "C" void
+platformFiberStart();
+
+asm(
+   ".text\n"
+   ".globl " FIBER_ASM_SYMBOL(platformFiberSwitch) "\n"
+   ".p2align 4\n"
+   FIBER_ASM_SYMBOL(platformFiberSwitch) ":\n"
+   "   pushq %rbp\n"
+   "   pushq %rbx\n"
+   "   pushq %r12\n"
+   "   pushq %r13\n"
+   "   pushq %r14\n"
+   "   pushq %r15\n"
+   "   subq $8, %rsp\n"
+   "   stmxcsr (%rsp)\n"
+   "   fnstcw 4(%rsp)\n"
+   "   movq %rsp, (%rdi)\n"
+   "   movq %rsi, %rsp\n"
+   "   ldmxcsr (%rsp)\n"
+   "   fldcw 4(%rsp)\n"
+   "   addq $8, %rsp\n"
+   "   popq %r15\n"
+   "   popq %r14\n"
+   "   popq %r13\n"
+   "   popq %r12\n"
+   "   popq %rbx\n"
+   "   popq %rbp\n"
+   "   ret\n"
+
+   ".globl " FIBER_ASM_SYMBOL(platformFiberStart) "\n"
+   ".p2align 4\n"
+   FIBER_ASM_SYMBOL(platformFiberStart) ":\n"
+   "   movq %r12, %rdi\n"
+   "   callq *%r13\n"
+   "   ud2\n"
+);
+
+#endif // FIBER_USE_ASM_SWITCH
+
 namespace platform
 {
 
-static const size_t
-DefaultStackSize = 1024 * 1024;
-
 struct Fiber
 {
+#ifdef FIBER_USE_ASM_SWITCH
+   //! Saved stack pointer while the fiber is not running
+   void *stackPointer = nullptr;
+#else
    ucontext_t context;
+#endif
+
    FiberEntryPoint entry = nullptr;
    void *entryParam = nullptr;
+
+   //! Mapping holding the stack and the guard page below it, null for
+   //!  fibers created by getThreadFiber
+   uint8_t *mapping = nullptr;
+   size_t mappingSize = 0;
+
 #ifdef DECAF_VALGRIND
    unsigned int valgrindStackId;
 #endif
-   std::array<char, DefaultStackSize> stack;
 };
 
+static size_t
+getPageSize()
+{
+   static const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+   return pageSize;
+}
+
 Fiber *
 getThreadFiber()
 {
@@ -40,46 +119,127 @@ static void
 fiberEntryPoint(Fiber *fiber)
 {
    fiber->entry(fiber->entryParam);
+   decaf_abort("Fiber entry point returned");
+}
+
+// Sets up the stack of a fiber so that switching to it calls fiberEntryPoint
+static void
+initialiseFiberStack(Fiber *fiber)
+{
+   auto stackTop = fiber->mapping + fiber->mappingSize;
+
+#ifdef FIBER_USE_ASM_SWITCH
+   // Build the frame platformFiberSwitch expects to pop, with r12 and r13
+   //  set up for platformFiberStart and its return address 16 byte aligned
+   //  so the entry point is called with the alignment the ABI requires.
+   auto frame = reinterpret_cast<uint64_t *>(stackTop) - 10;
+   uint32_t mxcsr;
+   uint16_t fpcw;
+   asm volatile ("stmxcsr %0" : "=m"(mxcsr));
+   asm volatile ("fnstcw %0" : "=m"(fpcw));
+
+   frame[0] = mxcsr | (static_cast<uint64_t>(fpcw) << 32);
+   frame[1] = 0; // r15
+   frame[2] = 0; // r14
+   frame[3] = reinterpret_cast<uint64_t>(&fiberEntryPoint); // r13
+   frame[4] = reinterpret_cast<uint64_t>(fiber); // r12
+   frame[5] = 0; // rbx
+   frame[6] = 0; // rbp
+   frame[7] = reinterpret_cast<uint64_t>(&platformFiberStart);
+   frame[8] = 0;
+   frame[9] = 0;
+   fiber->stackPointer = frame;
+#else
+   auto stackBottom = fiber->mapping + getPageSize();
+
+   getcontext(&fiber->context);
+   fiber->context.uc_stack.ss_sp = stackBottom;
+   fiber->context.uc_stack.ss_size = stackTop - stackBottom;
+   fiber->context.uc_link = nullptr;
+
+   makecontext(&fiber->context, reinterpret_cast<void(*)()>(&fiberEntryPoint), 1, fiber);
+#endif
 }
 
 Fiber *
-createFiber(FiberEntryPoint entry, void *entryParam)
+createFiber(FiberEntryPoint entry, void *entryParam, size_t stackSize)
 {
    auto fiber = new Fiber();
    fiber->entry = entry;
    fiber->entryParam = entryParam;
 
-#ifdef DECAF_VALGRIND
-   fiber->valgrindStackId = VALGRIND_STACK_REGISTER(&fiber->stack[0], &fiber->stack[fiber->stack.size() - 1]);
+   // Stacks grow down, so the guard page goes at the bottom of the mapping
+   //  to turn an overflow into a fault rather than silent corruption.
+   auto pageSize = getPageSize();
+   auto flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_STACK
+   flags |= MAP_STACK;
 #endif
 
-   getcontext(&fiber->context);
-   fiber->context.uc_stack.ss_sp = &fiber->stack[0];
-   fiber->context.uc_stack.ss_size = fiber->stack.size();
-   fiber->context.uc_link = nullptr;
+   stackSize = align_up(stackSize, pageSize);
+   fiber->mappingSize = stackSize + pageSize;
 
-   makecontext(&fiber->context, reinterpret_cast<void(*)()>(&fiberEntryPoint), 1, fiber);
+   auto mapping = mmap(nullptr, fiber->mappingSize, PROT_READ | PROT_WRITE, flags, -1, 0);
+
+   if (mapping == MAP_FAILED) {
+      gLog->error("Failed to allocate {} byte fiber stack", stackSize);
+      delete fiber;
+      return nullptr;
+   }
+
+   fiber->mapping = reinterpret_cast<uint8_t *>(mapping);
+   mprotect(fiber->mapping, pageSize, PROT_NONE);
+
+#ifdef DECAF_VALGRIND
+   fiber->valgrindStackId = VALGRIND_STACK_REGISTER(fiber->mapping + pageSize, fiber->mapping + fiber->mappingSize);
+#endif
+
+   initialiseFiberStack(fiber);
    return fiber;
 }
 
 void
 destroyFiber(Fiber *fiber)
 {
+   if (fiber->mapping) {
 #ifdef DECAF_VALGRIND
-   VALGRIND_STACK_DEREGISTER(fiber->valgrindStackId);
+      VALGRIND_STACK_DEREGISTER(fiber->valgrindStackId);
 #endif
 
+      munmap(fiber->mapping, fiber->mappingSize);
+   }
+
    delete fiber;
 }
 
+void
+resetFiber(Fiber *fiber)
+{
+   auto pageSize = getPageSize();
+
+   // The pages come back zeroed on next touch, so this has to happen before
+   //  the new initial frame is written.
+   madvise(fiber->mapping + pageSize, fiber->mappingSize - pageSize, MADV_DONTNEED);
+   initialiseFiberStack(fiber);
+}
+
 void
 swapToFiber(Fiber *current, Fiber *target)
 {
+#ifdef FIBER_USE_ASM_SWITCH
+   if (!current) {
+      void *discard;
+      platformFiberSwitch(&discard, target->stackPointer);
+   } else {
+      platformFiberSwitch(&current->stackPointer, target->stackPointer);
+   }
+#else
    if (!current) {
       setcontext(&target->context);
    } else {
       swapcontext(&current->context, &target->context);
    }
+#endif
 }
 
 } // namespace platform
@@ -2,7 +2,10 @@
 #include "platform_memory.h"
 
 #ifdef PLATFORM_POSIX
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace platform
 {
@@ -74,6 +77,41 @@ protectMemory(size_t address, size_t size, ProtectFlags flags)
    return mprotect(baseAddress, size, flagsToProt(flags)) == 0;
 }
 
+const void *
+mapFileReadOnly(const std::string &path, size_t &size)
+{
+   auto fd = open(path.c_str(), O_RDONLY);
+   size = 0;
+
+   if (fd == -1) {
+      return nullptr;
+   }
+
+   struct stat info;
+
+   if (fstat(fd, &info) != 0 || info.st_size == 0) {
+      close(fd);
+      return nullptr;
+   }
+
+   // The mapping keeps its own reference to the file, so we can close it
+   auto view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+
+   if (view == MAP_FAILED) {
+      return nullptr;
+   }
+
+   size = static_cast<size_t>(info.st_size);
+   return view;
+}
+
+bool
+unmapFile(const void *view, size_t size)
+{
+   return munmap(const_cast<void *>(view), size) == 0;
+}
+
 } // namespace platform
 
 #endif
@@ -41,10 +41,12 @@ exceptionHandler(PEXCEPTION_POINTERS info)
    case STATUS_ACCESS_VIOLATION: {
       auto address = info->ExceptionRecord->ExceptionInformation[1];
       auto exception = AccessViolationException{ address };
+      exception.instructionPointer = info->ContextRecord->Rip;
       return dispatchException(info, &exception);
    } break;
    case STATUS_ILLEGAL_INSTRUCTION: {
       auto exception = InvalidInstructionException{ };
+      exception.instructionPointer = info->ContextRecord->Rip;
       return dispatchException(info, &exception);
    } break;
    }
@@ -10,6 +10,7 @@ namespace platform
 struct Fiber
 {
    LPVOID handle = nullptr;
+   size_t stackSize = 0;
    FiberEntryPoint entry = nullptr;
    void *entryParam = nullptr;
 };
@@ -30,10 +31,11 @@ fiberEntryPoint(LPVOID lpFiberParameter)
 }
 
 Fiber *
-createFiber(FiberEntryPoint entry, void *entryParam)
+createFiber(FiberEntryPoint entry, void *entryParam, size_t stackSize)
 {
    auto fiber = new Fiber();
-   fiber->handle = CreateFiber(0, &fiberEntryPoint, fiber);
+   fiber->handle = CreateFiber(stackSize, &fiberEntryPoint, fiber);
+   fiber->stackSize = stackSize;
    fiber->entry = entry;
    fiber->entryParam = entryParam;
    return fiber;
@@ -46,6 +48,14 @@ destroyFiber(Fiber *fiber)
    delete fiber;
 }
 
+void
+resetFiber(Fiber *fiber)
+{
+   // A Windows fiber cannot be restarted, so replace it with a new one
+   DeleteFiber(fiber->handle);
+   fiber->handle = CreateFiber(fiber->stackSize, &fiberEntryPoint, fiber);
+}
+
 void
 swapToFiber(Fiber *current, Fiber *target)
 {
@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// A fair spin lock, waiters are granted the lock in the order they arrived.
+//
+// Waiters back off with pause in proportion to how many threads are ahead of
+//  them, so mostly only the next owner is polling when the lock is released.
+//  Once a waiter has spun for a long time it starts yielding, as the owner or
+//  the thread ahead of it may have been preempted.
+class TicketLock
+{
+   static const uint32_t BackoffPerWaiter = 16;
+   static const uint64_t YieldThreshold = 1 << 16;
+
+public:
+   struct Stats
+   {
+      //! Number of times the lock was taken
+      uint64_t acquisitions;
+
+      //! Number of times the lock was taken after waiting for another owner
+      uint64_t contended;
+
+      //! Number of pause instructions executed while waiting
+      uint64_t spins;
+   };
+
+   void
+   lock()
+   {
+      auto ticket = mNext.fetch_add(1, std::memory_order_relaxed);
+      auto serving = mServing.load(std::memory_order_acquire);
+      auto spins = uint64_t { 0 };
+
+      while (serving != ticket) {
+         auto backoff = (ticket - serving) * BackoffPerWaiter;
+
+         for (auto i = 0u; i < backoff; ++i) {
+            pause();
+         }
+
+         spins += backoff;
+
+         if (spins > YieldThreshold) {
+            std::this_thread::yield();
+         }
+
+         serving = mServing.load(std::memory_order_acquire);
+      }
+
+      // Only the owner writes the counters, so they do not need to be RMW
+      increment(mAcquisitions, 1);
+
+      if (spins) {
+         increment(mContended, 1);
+         increment(mSpins, spins);
+      }
+   }
+
+   void
+   unlock()
+   {
+      auto serving = mServing.load(std::memory_order_relaxed);
+      mServing.store(serving + 1, std::memory_order_release);
+   }
+
+   bool
+   isLocked() const
+   {
+      return mNext.load(std::memory_order_acquire) != mServing.load(std::memory_order_acquire);
+   }
+
+   Stats
+   stats() const
+   {
+      Stats stats;
+      stats.acquisitions = mAcquisitions.load(std::memory_order_relaxed);
+      stats.contended = mContended.load(std::memory_order_relaxed);
+      stats.spins = mSpins.load(std::memory_order_relaxed);
+      return stats;
+   }
+
+private:
+   static void
+   pause()
+   {
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+      _mm_pause();
+#endif
+   }
+
+   static void
+   increment(std::atomic<uint64_t> &counter,
+             uint64_t value)
+   {
+      counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+   }
+
+private:
+   std::atomic<uint32_t> mNext { 0 };
+   std::atomic<uint32_t> mServing { 0 };
+
+   //! Kept off the line waiters poll, as the owner writes to them
+   alignas(64) std::atomic<uint64_t> mAcquisitions { 0 };
+   std::atomic<uint64_t> mContended { 0 };
+   std::atomic<uint64_t> mSpins { 0 };
+};
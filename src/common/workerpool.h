@@ -0,0 +1,190 @@
+#pragma once
+#include "platform_thread.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A small pool of worker threads for splitting a job into independent items,
+//  or for running tasks in the background.
+//
+// The thread calling parallelFor also runs items, so a pool with no worker
+//  threads simply runs every item on the calling thread.
+class WorkerPool
+{
+   struct Batch
+   {
+      const std::function<void(unsigned)> *func;
+      unsigned count;
+      std::atomic<unsigned> next;
+      std::atomic<unsigned> remaining;
+      unsigned activeWorkers;
+   };
+
+public:
+   WorkerPool(const std::string &name, unsigned numThreads)
+   {
+      for (auto i = 0u; i < numThreads; ++i) {
+         mThreads.emplace_back(&WorkerPool::workerEntry, this);
+         platform::setThreadName(&mThreads.back(), name + " " + std::to_string(i));
+      }
+   }
+
+   ~WorkerPool()
+   {
+      {
+         std::unique_lock<std::mutex> lock { mMutex };
+         mShutdown = true;
+      }
+
+      mWorkCV.notify_all();
+
+      for (auto &thread : mThreads) {
+         thread.join();
+      }
+   }
+
+   unsigned
+   numThreads() const
+   {
+      return static_cast<unsigned>(mThreads.size());
+   }
+
+   // Queues func to be run on a worker thread and returns without waiting,
+   //  tasks which have not started when the pool is destroyed are dropped.
+   void
+   run(std::function<void()> func)
+   {
+      if (mThreads.empty()) {
+         func();
+         return;
+      }
+
+      {
+         std::unique_lock<std::mutex> lock { mMutex };
+         mTasks.emplace_back(std::move(func));
+      }
+
+      mWorkCV.notify_one();
+   }
+
+   // Runs func(i) for every i in [0, count) and waits for them all to finish
+   void
+   parallelFor(unsigned count,
+               const std::function<void(unsigned)> &func)
+   {
+      if (mThreads.empty() || count <= 1) {
+         for (auto i = 0u; i < count; ++i) {
+            func(i);
+         }
+
+         return;
+      }
+
+      // Only one batch can be in flight at a time
+      std::unique_lock<std::mutex> submitLock { mSubmitMutex };
+
+      Batch batch;
+      batch.func = &func;
+      batch.count = count;
+      batch.next = 0;
+      batch.remaining = count;
+      batch.activeWorkers = 0;
+
+      {
+         std::unique_lock<std::mutex> lock { mMutex };
+         mBatch = &batch;
+         ++mGeneration;
+      }
+
+      mWorkCV.notify_all();
+      runItems(batch);
+
+      // Wait for all items to complete and for every worker to stop
+      //  touching the batch, as it lives on our stack.
+      std::unique_lock<std::mutex> lock { mMutex };
+      mDoneCV.wait(lock, [&]() {
+         return batch.remaining.load() == 0 && batch.activeWorkers == 0;
+      });
+      mBatch = nullptr;
+   }
+
+private:
+   void
+   runItems(Batch &batch)
+   {
+      while (true) {
+         auto index = batch.next.fetch_add(1);
+
+         if (index >= batch.count) {
+            break;
+         }
+
+         (*batch.func)(index);
+
+         if (batch.remaining.fetch_sub(1) == 1) {
+            std::unique_lock<std::mutex> lock { mMutex };
+            mDoneCV.notify_all();
+         }
+      }
+   }
+
+   void
+   workerEntry()
+   {
+      auto seenGeneration = uint64_t { 0 };
+      std::unique_lock<std::mutex> lock { mMutex };
+
+      while (true) {
+         mWorkCV.wait(lock, [&]() {
+            return mShutdown || !mTasks.empty() || (mBatch && mGeneration != seenGeneration);
+         });
+
+         if (mShutdown) {
+            break;
+         }
+
+         // Batches are waited on, so they go before queued tasks
+         if (!mBatch || mGeneration == seenGeneration) {
+            auto task = std::move(mTasks.front());
+            mTasks.pop_front();
+            lock.unlock();
+
+            task();
+
+            lock.lock();
+            continue;
+         }
+
+         seenGeneration = mGeneration;
+         auto batch = mBatch;
+         batch->activeWorkers++;
+         lock.unlock();
+
+         runItems(*batch);
+
+         lock.lock();
+         batch->activeWorkers--;
+
+         if (batch->activeWorkers == 0) {
+            mDoneCV.notify_all();
+         }
+      }
+   }
+
+private:
+   std::vector<std::thread> mThreads;
+   std::mutex mSubmitMutex;
+   std::mutex mMutex;
+   std::condition_variable mWorkCV;
+   std::condition_variable mDoneCV;
+   Batch *mBatch = nullptr;
+   std::deque<std::function<void()>> mTasks;
+   uint64_t mGeneration = 0;
+   bool mShutdown = false;
+};
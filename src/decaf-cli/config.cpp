@@ -57,7 +57,8 @@ struct CerealJit
    {
       using namespace decaf::config::jit;
       ar(CEREAL_NVP(enabled),
-         CEREAL_NVP(verify));
+         CEREAL_NVP(verify),
+         CEREAL_NVP(trace_threshold));
    }
 };
 
@@ -80,7 +81,9 @@ struct CerealSystem
       using namespace decaf::config::system;
       ar(CEREAL_NVP(region),
          CEREAL_NVP(mlc_path),
-         CEREAL_NVP(timeout_ms));
+         CEREAL_NVP(timeout_ms),
+         CEREAL_NVP(fiber_stack_size),
+         CEREAL_NVP(instruction_timebase));
    }
 };
 
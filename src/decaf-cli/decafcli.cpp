@@ -1,6 +1,5 @@
 #include "decafcli.h"
 #include "config.h"
-#include "libdecaf/decaf_nullgraphicsdriver.h"
 #include "libdecaf/decaf_nullinputdriver.h"
 #include <chrono>
 #include <condition_variable>
@@ -13,7 +12,7 @@ DecafCLI::run(const std::string &gamePath)
    int result = 0;
 
    // Setup drivers
-   decaf::setGraphicsDriver(new decaf::NullGraphicsDriver());
+   decaf::setGraphicsDriver(decaf::createNullGraphicsDriver());
    decaf::setInputDriver(new decaf::NullInputDriver());
 
    // Initialise emulator
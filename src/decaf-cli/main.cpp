@@ -72,7 +72,9 @@ getCommandLineParser()
                   default_value<double> { 1.0 })
       .add_option("timeout_ms",
                   description { "How long to execute the game for before quitting." },
-                  value<uint32_t> {});
+                  value<uint32_t> {})
+      .add_option("instruction-timebase",
+                  description { "Drive the emulated clock by executed instructions and skip idle time." });
 
    parser.add_command("play")
       .add_option_group(jit_options)
@@ -183,6 +185,10 @@ start(excmd::parser &parser,
       config::system::timeout_ms = options.get<uint32_t>("timeout_ms");
    }
 
+   if (options.has("instruction-timebase")) {
+      decaf::config::system::instruction_timebase = true;
+   }
+
    auto gamePath = options.get<std::string>("game directory");
    auto logFile = getPathBasename(gamePath);
    auto logLevel = spdlog::level::info;
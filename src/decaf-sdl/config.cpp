@@ -112,7 +112,9 @@ struct CerealGPU
       using namespace decaf::config::gpu;
       ar(CEREAL_NVP(debug),
          CEREAL_NVP(debug_filters),
-         CEREAL_NVP(force_sync));
+         CEREAL_NVP(force_sync),
+         CEREAL_NVP(shader_cache),
+         CEREAL_NVP(async_shaders));
    }
 };
 
@@ -186,7 +188,8 @@ struct CerealJit
    {
       using namespace decaf::config::jit;
       ar(CEREAL_NVP(enabled),
-         CEREAL_NVP(verify));
+         CEREAL_NVP(verify),
+         CEREAL_NVP(trace_threshold));
    }
 };
 
@@ -209,7 +212,9 @@ struct CerealSystem
    {
       using namespace decaf::config::system;
       ar(CEREAL_NVP(region),
-         CEREAL_NVP(mlc_path));
+         CEREAL_NVP(mlc_path),
+         CEREAL_NVP(fiber_stack_size),
+         CEREAL_NVP(instruction_timebase));
    }
 };
 
@@ -33,6 +33,11 @@ enum class jit_mode {
    verify
 };
 
+enum class timebase_mode {
+   realtime,
+   instructions
+};
+
 static const uint32_t CALLBACK_ADDR = 0xFBADCDE0;
 
 using EntrypointHandler = std::function<void()>;
@@ -54,6 +59,17 @@ initialise();
 void
 setJitMode(jit_mode mode);
 
+// Blocks executed more than threshold times are translated again as
+//  traces which follow branches, 0 disables trace formation.
+void
+setJitTraceThreshold(uint32_t threshold);
+
+// In instructions mode the timebase of each core advances with the guest
+//  instructions it retires instead of host time, and skips ahead to the next
+//  alarm whenever every core is idle.  Must be set before cpu::start.
+void
+setTimebaseMode(timebase_mode mode);
+
 void
 setCoreEntrypointHandler(EntrypointHandler handler);
 
@@ -107,9 +123,19 @@ bool
 removeBreakpoint(ppcaddr_t address,
                  uint32_t flags);
 
+void
+invalidateInstructionCache(ppcaddr_t address,
+                           uint32_t size);
+
 uint64_t *
 getJitFallbackStats();
 
+JitBranchStats
+getJitBranchStats();
+
+WakeupLatencyStats
+getWakeupLatencyStats();
+
 namespace this_core
 {
 
@@ -138,7 +164,13 @@ void
 clearInterrupt(uint32_t flags);
 
 void
-setNextAlarm(std::chrono::steady_clock::time_point alarm_time);
+setNextAlarm(uint64_t alarm_tb);
+
+// Moves this core's timebase forward to at least tb, for when a guest thread
+//  which last ran at tb moves to this core.  Only timebase_mode::instructions
+//  has a timebase per core, otherwise this does nothing.
+void
+syncTimebase(uint64_t tb);
 
 cpu::Core *
 state();
@@ -3,6 +3,7 @@
 #include <common/bitutils.h>
 #include <common/decaf_assert.h>
 #include <algorithm>
+#include <array>
 
 namespace espresso
 {
@@ -70,6 +71,33 @@ sAliasData;
 static TableEntry
 sInstructionTable;
 
+/*
+ * The flat decode table is a direct-indexed alternative to the decode tree
+ * above.  The first level is indexed by the primary opcode, the second level
+ * by instruction bits 21-30 which hold every extended opcode field (xo1 - xo4).
+ * Extended opcodes narrower than 10 bits are replicated across the unused
+ * index bits.  Each entry stores the full opcode mask and value so reserved
+ * fields (e.g. !_16_20) are still validated with a single compare.
+ */
+struct FlatDecodeEntry
+{
+   uint32_t mask = 0;
+   uint32_t value = 0;
+   InstructionInfo *instr = nullptr;
+};
+
+struct FlatDecodeTable
+{
+   uint32_t indexMask = 0;
+   std::vector<FlatDecodeEntry> entries;
+};
+
+static const uint32_t FlatExtendedShift = 1;
+static const uint32_t FlatExtendedBits = 0x3FF;
+
+static std::array<FlatDecodeTable, 64>
+sFlatDecodeTable;
+
 #define FLD(x, y, z, ...) {y, z},
 #define MRKR(x, ...) {-1, -1},
 static std::pair<int, int>
@@ -185,6 +213,20 @@ decodeInstruction(Instruction instr)
    return nullptr;
 }
 
+// Decode Instruction to InstructionInfo using the flat decode table
+InstructionInfo *
+decodeInstructionFlat(Instruction instr)
+{
+   auto &table = sFlatDecodeTable[instr.opcd];
+   auto &entry = table.entries[(instr.value >> FlatExtendedShift) & table.indexMask];
+
+   if ((instr.value & entry.mask) != entry.value) {
+      return nullptr;
+   }
+
+   return entry.instr;
+}
+
 // Encode specified instruction
 Instruction
 encodeInstruction(InstructionID id)
@@ -278,6 +320,56 @@ initialiseInstructionTable()
    }
 }
 
+// Initialise sFlatDecodeTable
+static void
+initialiseFlatDecodeTable()
+{
+   auto opcdMask = getInstructionFieldBitmask(InstructionField::opcd);
+   auto opcdStart = getInstructionFieldStart(InstructionField::opcd);
+   auto extendedMask = FlatExtendedBits << FlatExtendedShift;
+
+   // Find which primary opcodes need an extended opcode sub-table
+   for (auto &instr : sInstructionInfo) {
+      auto opcode = encodeInstruction(instr.id);
+      auto &table = sFlatDecodeTable[(opcode & opcdMask) >> opcdStart];
+
+      for (auto &op : instr.opcode) {
+         if (getInstructionFieldBitmask(op.field) & extendedMask) {
+            table.indexMask = FlatExtendedBits;
+         }
+      }
+   }
+
+   for (auto &table : sFlatDecodeTable) {
+      table.entries.resize(table.indexMask + 1);
+   }
+
+   // Fill every sub-table slot whose index bits match the instruction
+   for (auto &instr : sInstructionInfo) {
+      auto entry = FlatDecodeEntry { };
+      entry.value = encodeInstruction(instr.id);
+      entry.instr = &instr;
+
+      for (auto &op : instr.opcode) {
+         entry.mask |= getInstructionFieldBitmask(op.field);
+      }
+
+      auto &table = sFlatDecodeTable[(entry.value & opcdMask) >> opcdStart];
+      auto indexMask = (entry.mask >> FlatExtendedShift) & table.indexMask;
+      auto indexValue = (entry.value >> FlatExtendedShift) & table.indexMask;
+
+      for (auto index = 0u; index <= table.indexMask; ++index) {
+         if ((index & indexMask) != indexValue) {
+            continue;
+         }
+
+         auto &slot = table.entries[index];
+         decaf_check(!slot.instr);
+         slot = entry;
+      }
+   }
+}
+
 static std::string
 cleanInsName(const std::string& name)
 {
@@ -365,6 +457,9 @@ initialiseInstructionSet()
 
    // Create instruction table
    initialiseInstructionTable();
+
+   // Create flat decode table
+   initialiseFlatDecodeTable();
 };
 
 #undef INS
@@ -66,6 +66,9 @@ initialiseInstructionSet();
 InstructionInfo *
 decodeInstruction(Instruction instr);
 
+InstructionInfo *
+decodeInstructionFlat(Instruction instr);
+
 Instruction
 encodeInstruction(InstructionID id);
 
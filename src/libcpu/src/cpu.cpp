@@ -7,10 +7,12 @@
 #include "interpreter/interpreter.h"
 #include "jit/jit.h"
 #include "mem.h"
+#include <algorithm>
 #include <atomic>
 #include <cfenv>
 #include <chrono>
 #include <condition_variable>
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -38,6 +40,12 @@ gBranchTraceHandler;
 jit_mode
 gJitMode = jit_mode::disabled;
 
+uint32_t
+gJitTraceThreshold = 0;
+
+timebase_mode
+gTimebaseMode = timebase_mode::realtime;
+
 Core
 gCore[3];
 
@@ -47,6 +55,14 @@ tCurrentCore = nullptr;
 static thread_local uint32_t
 sSegfaultAddr = 0;
 
+static const uint32_t
+CodePageShift = 12;
+
+// One bit per guest page which has ever had code translated or predecoded
+//  from it, lets us skip invalidation of pages which only hold data.
+static std::atomic<uint32_t>
+sCodePages[(0x100000000ull >> CodePageShift) / 32];
+
 void
 initialise()
 {
@@ -63,6 +79,18 @@ setJitMode(jit_mode mode)
    gJitMode = mode;
 }
 
+void
+setJitTraceThreshold(uint32_t threshold)
+{
+   gJitTraceThreshold = threshold;
+}
+
+void
+setTimebaseMode(timebase_mode mode)
+{
+   gTimebaseMode = mode;
+}
+
 static void
 coreSegfaultEntry()
 {
@@ -77,11 +105,26 @@ coreIllInstEntry()
    decaf_abort("The CPU illegal instruction handler must never return.");
 }
 
+// The JIT does not keep nia up to date for every instruction, so when the
+//  fault came from generated code we recover it from the host address.
+static void
+updateFaultNia(platform::Exception *exception)
+{
+   auto core = this_core::state();
+   auto cia = ppcaddr_t { 0 };
+
+   if (core && gJitMode != jit_mode::disabled
+    && jit::findGuestAddress(exception->instructionPointer, cia)) {
+      core->nia = cia + 4;
+   }
+}
+
 static platform::ExceptionResumeFunc
 exceptionHandler(platform::Exception *exception)
 {
    // Handle illegal instructions!
    if (exception->type == platform::Exception::InvalidInstruction) {
+      updateFaultNia(exception);
       return coreIllInstEntry;
    }
 
@@ -106,6 +149,7 @@ exceptionHandler(platform::Exception *exception)
    }
 
    sSegfaultAddr = static_cast<uint32_t>(address - memBase);
+   updateFaultNia(exception);
    return coreSegfaultEntry;
 }
 
@@ -137,7 +181,7 @@ start()
       auto &core = gCore[i];
       core.id = i;
       core.thread = std::thread(coreEntryPoint, &core);
-      core.next_alarm = std::chrono::steady_clock::time_point::max();
+      core.next_alarm = std::numeric_limits<uint64_t>::max();
 
       static const std::string coreNames[] = { "Core #0", "Core #1", "Core #2" };
       platform::setThreadName(&core.thread, coreNames[core.id]);
@@ -200,6 +244,51 @@ setBranchTraceHandler(BranchTraceHandler handler)
    gBranchTraceHandler = handler;
 }
 
+void
+markCodePages(ppcaddr_t start,
+              ppcaddr_t end)
+{
+   auto first = start >> CodePageShift;
+   auto last = (end - 1) >> CodePageShift;
+
+   for (auto page = first; page <= last; ++page) {
+      sCodePages[page / 32].fetch_or(1u << (page % 32), std::memory_order_relaxed);
+   }
+}
+
+static bool
+hasCodePages(ppcaddr_t address,
+             uint32_t size)
+{
+   auto first = address >> CodePageShift;
+   auto end = std::min<uint64_t>(static_cast<uint64_t>(address) + size - 1, 0xFFFFFFFF);
+   auto last = static_cast<uint32_t>(end >> CodePageShift);
+
+   for (auto page = first; page <= last; ++page) {
+      if (sCodePages[page / 32].load(std::memory_order_relaxed) & (1u << (page % 32))) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void
+invalidateInstructionCache(ppcaddr_t address,
+                           uint32_t size)
+{
+   // Pairs with the fence after marking pages, either the code generator
+   //  sees the new instructions or we see its page.
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+
+   if (!size || !hasCodePages(address, size)) {
+      return;
+   }
+
+   interpreter::invalidateBlockCache(address, size);
+   jit::invalidateCache(address, size);
+}
+
 std::chrono::steady_clock::time_point
 tbToTimePoint(uint64_t ticks)
 {
@@ -208,9 +297,18 @@ tbToTimePoint(uint64_t ticks)
    return sStartupTime + nanos;
 }
 
+// In instructions mode every core keeps its own timebase, counted from the
+//  instructions it has retired.  Cores only sync with each other when one
+//  is idle, when all of them are idle and skip to the next alarm, and when
+//  a guest thread moves to a core which is behind the one it came from.
 uint64_t
 Core::tb()
 {
+   if (gTimebaseMode == timebase_mode::instructions) {
+      return retired_instructions.load(std::memory_order_relaxed) / instructionsPerTick
+           + timebase_offset.load(std::memory_order_relaxed);
+   }
+
    auto now = std::chrono::steady_clock::now();
    auto ticks = std::chrono::duration_cast<TimerDuration>(now - sStartupTime);
    return ticks.count();
@@ -228,15 +326,6 @@ state()
 void
 resume()
 {
-   // If we have breakpoints set, we have to fall back to interpreter loop
-   // This is because JIT wont check for breakpoints on each instruction.
-   // TODO: Make JIT account for breakpoints by inserting breakpoint checks
-   // in the appropriate places in the instruction stream.
-   if (hasBreakpoints()) {
-      interpreter::resume();
-      return;
-   }
-
    // Use appropriate jit mode
    if (gJitMode != jit_mode::disabled) {
       jit::resume();
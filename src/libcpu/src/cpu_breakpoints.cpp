@@ -1,233 +1,176 @@
 #include <common/decaf_assert.h>
 #include "cpu.h"
-#include "mem.h"
+#include "cpu_internal.h"
+#include "jit/jit.h"
 
 #include <atomic>
-#include <cstring>
-#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 namespace cpu
 {
 
-static std::atomic<uint32_t*>
-gBreakpoints;
+// Breakpoints are looked up for every instruction the interpreter steps, so
+//  reading them never takes a lock.  Each guest page with a breakpoint on it
+//  has a bit set in sBreakpointPages, which makes the common case a single
+//  bit test, only lookups in those pages probe the hash table.
+//
+// Edits are rare, they are serialised by sBreakpointMutex and publish a new
+//  table atomically.  A replaced table is only freed once there are no
+//  lookups in progress, which may still be reading it.
 
-using BreakpointListFn = std::function<uint32_t * (uint32_t*)>;
+static const uint32_t
+BreakpointPageShift = 12;
 
-static inline void
-compareAndSwapBreakpoints(uint32_t *bpList, BreakpointListFn functor)
+static const uint32_t
+BreakpointPageSize = 1 << BreakpointPageShift;
+
+struct BreakpointEntry
 {
-   uint32_t *newBpList = nullptr;
+   ppcaddr_t address;
 
-   do {
-      newBpList = functor(bpList);
+   //! An entry with no flags is empty
+   uint32_t flags;
+};
 
-      if (newBpList == bpList) {
-         // No changes were made
-         return;
-      }
-   } while (!gBreakpoints.compare_exchange_strong(bpList, newBpList));
-}
-
-static inline bool
-addBreakpoint(uint32_t* bpList, ppcaddr_t address, uint32_t flags)
+struct BreakpointTable
 {
-   std::vector<uint32_t> newBpListVec;
-   bool bp_changed = true;
-
-   compareAndSwapBreakpoints(bpList, [&](auto oldList) {
-      // Reset from any last iteration attempt
-      newBpListVec.clear();
-      bp_changed = true;
-
-      // Copy all the existing BPs till the terminator
-      if (oldList) {
-         for (uint32_t *bpListIter = oldList; *bpListIter != 0xFFFFFFFF; ) {
-            auto bp_address = *bpListIter++;
-            auto bp_flags = *bpListIter++;
-
-            // If its already in the list, lets merge the flags
-            if (bp_address == address) {
-               // If it already has all the flags, we don't need to change anything
-               if ((bp_flags & flags) == flags) {
-                  bp_changed = false;
-                  return oldList;
-               }
-
-               // Flags are additive
-               flags |= bp_flags;
-               continue;
-            }
-
-            newBpListVec.push_back(bp_address);
-            newBpListVec.push_back(bp_flags);
-         }
-      }
+   //! Open addressed with linear probing, the size is a power of two and
+   //!  there is always at least one empty entry.
+   std::vector<BreakpointEntry> entries;
+};
 
-      // Add the new breakpoint to the list
-      newBpListVec.push_back(address);
-      newBpListVec.push_back(flags);
+static std::atomic<uint32_t>
+sBreakpointPages[(0x100000000ull >> BreakpointPageShift) / 32];
 
-      // Add the terminator to the end
-      newBpListVec.push_back(0xFFFFFFFF);
+static std::atomic<BreakpointTable *>
+sBreakpointTable { nullptr };
 
-      // Copy to heap memory and return it
-      auto newBpList = new uint32_t[newBpListVec.size()];
-      memcpy(newBpList, newBpListVec.data(), sizeof(uint32_t) * newBpListVec.size());
-      return newBpList;
-   });
+static std::mutex
+sBreakpointMutex;
 
-   return bp_changed;
-}
+//! Every breakpoint and its flags, guarded by sBreakpointMutex
+static std::map<ppcaddr_t, uint32_t>
+sBreakpoints;
 
-static inline bool
-removeBreakpoint(uint32_t *bpList,
-                 ppcaddr_t address,
-                 uint32_t flags)
-{
-   std::vector<uint32_t> newBpListVec;
-   bool bp_matched = false;
+//! Number of lookups currently probing a table
+static std::atomic<uint32_t>
+sBreakpointReaders { 0 };
 
-   compareAndSwapBreakpoints(bpList, [&](auto oldList) {
-      // If there is no existing list, we have nothing to do
-      if (!oldList) {
-         return oldList;
-      }
+static uint32_t
+hashBreakpoint(ppcaddr_t address)
+{
+   return (address >> 2) * 2654435761u;
+}
 
-      // Reset from any last iteration attempt
-      newBpListVec.clear();
-      bp_matched = false;
+static uint32_t
+findBreakpointFlags(ppcaddr_t address)
+{
+   auto page = address >> BreakpointPageShift;
 
-      // Copy all the data which has the system flag, otherwise ignore it
-      for (uint32_t *bpListIter = oldList; *bpListIter != 0xFFFFFFFF; ) {
-         auto bp_address = *bpListIter++;
-         auto bp_flags = *bpListIter++;
+   if (!(sBreakpointPages[page / 32].load(std::memory_order_acquire) & (1u << (page % 32)))) {
+      return 0;
+   }
 
-         if (bp_address == address) {
-            // If it has none of the flags, we have no changes to make
-            if ((bp_flags & flags) == 0) {
-               return oldList;
-            }
+   sBreakpointReaders.fetch_add(1, std::memory_order_seq_cst);
 
-            // If it has every flag, switch the return value
-            if ((bp_flags & flags) == flags) {
-               bp_matched = true;
-            }
+   auto table = sBreakpointTable.load(std::memory_order_seq_cst);
+   auto flags = 0u;
 
-            // Flags are subtractive
-            bp_flags &= ~flags;
-         }
+   if (table) {
+      auto mask = static_cast<uint32_t>(table->entries.size() - 1);
 
-         // Only put the breakpoint back in the list if it has flags left
-         if (bp_flags) {
-            newBpListVec.push_back(bp_address);
-            newBpListVec.push_back(bp_flags);
+      for (auto i = hashBreakpoint(address) & mask; table->entries[i].flags; i = (i + 1) & mask) {
+         if (table->entries[i].address == address) {
+            flags = table->entries[i].flags;
+            break;
          }
       }
+   }
 
-      // If we have no breakpoints, just return no list
-      if (newBpListVec.size() == 0) {
-         return static_cast<uint32_t*>(nullptr);
-      }
-
-      // Add the terminator to the end
-      newBpListVec.push_back(0xFFFFFFFF);
-
-      // Copy to heap memory and return it
-      auto newBpList = new uint32_t[newBpListVec.size()];
-      memcpy(newBpList, newBpListVec.data(), sizeof(uint32_t) * newBpListVec.size());
-      return newBpList;
-   });
-
-   return bp_matched;
+   sBreakpointReaders.fetch_sub(1, std::memory_order_release);
+   return flags;
 }
 
-static inline bool
-clearBreakpoints(uint32_t *bpList,
-                 uint32_t flags_mask)
+// Must be called with sBreakpointMutex held
+static void
+publishBreakpoints()
 {
-   std::vector<uint32_t> newBpListVec;
-   bool bps_changed = false;
+   auto table = std::unique_ptr<BreakpointTable> { };
 
-   compareAndSwapBreakpoints(bpList, [&](auto oldList) {
-      // If there is no existing list, we have nothing to do
-      if (!oldList) {
-         return oldList;
+   if (!sBreakpoints.empty()) {
+      // Keep the table at most half full so probe sequences stay short
+      auto size = 16u;
+
+      while (size < sBreakpoints.size() * 2) {
+         size *= 2;
       }
 
-      // Reset from any last iteration attempt
-      bps_changed = false;
-      newBpListVec.clear();
+      table = std::make_unique<BreakpointTable>();
+      table->entries.resize(size, BreakpointEntry { 0, 0 });
 
-      // Copy all the data which has the system flag, otherwise ignore it
-      for (uint32_t *bpListIter = oldList; *bpListIter != 0xFFFFFFFF; ) {
-         auto bp_address = *bpListIter++;
-         auto bp_flags = *bpListIter++;
+      for (auto &bp : sBreakpoints) {
+         auto i = hashBreakpoint(bp.first) & (size - 1);
 
-         // If it has any of these flags, clear them
-         if (bp_flags & flags_mask) {
-            bp_flags &= ~flags_mask;
-            bps_changed = true;
+         while (table->entries[i].flags) {
+            i = (i + 1) & (size - 1);
          }
 
-         // If it still has flags, put it back on the list
-         if (bp_flags) {
-            newBpListVec.push_back(bp_address);
-            newBpListVec.push_back(bp_flags);
-         }
+         table->entries[i] = BreakpointEntry { bp.first, bp.second };
       }
+   }
 
-      // If we have no changes, dont update
-      if (!bps_changed) {
-         return oldList;
-      }
+   auto old = std::unique_ptr<BreakpointTable> {
+      sBreakpointTable.exchange(table.release(), std::memory_order_seq_cst)
+   };
 
-      // If we have no breakpoints, just return no list
-      if (newBpListVec.size() == 0) {
-         return static_cast<uint32_t*>(nullptr);
-      }
+   // Any lookup which could still see the old table started before the
+   //  exchange, and those only take a moment.
+   while (old && sBreakpointReaders.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+   }
+}
 
-      // Add the terminator to the end
-      newBpListVec.push_back(0xFFFFFFFF);
+// Must be called with sBreakpointMutex held, after publishing the table
+static void
+updateBreakpointPage(ppcaddr_t address)
+{
+   auto page = address >> BreakpointPageShift;
+   auto start = page << BreakpointPageShift;
+   auto itr = sBreakpoints.lower_bound(start);
+
+   if (itr != sBreakpoints.end() && itr->first - start < BreakpointPageSize) {
+      sBreakpointPages[page / 32].fetch_or(1u << (page % 32), std::memory_order_release);
+   } else {
+      sBreakpointPages[page / 32].fetch_and(~(1u << (page % 32)), std::memory_order_release);
+   }
+}
 
-      // Copy to heap memory and return it
-      auto newBpList = new uint32_t[newBpListVec.size()];
-      memcpy(newBpList, newBpListVec.data(), sizeof(uint32_t) * newBpListVec.size());
-      return newBpList;
-   });
+// Must be called with sBreakpointMutex held, after publishing the table
+static void
+breakpointAddressChanged(ppcaddr_t address)
+{
+   updateBreakpointPage(address);
 
-   return bps_changed;
+   // Translated code only checks for breakpoints on the instructions which
+   //  had one when it was generated, so the code translated from this
+   //  address has to be generated again.
+   jit::invalidateCache(address, 4);
 }
 
 bool
-hasBreakpoints()
+hasBreakpoint(ppcaddr_t address)
 {
-   return !!gBreakpoints.load(std::memory_order_acquire);
+   return findBreakpointFlags(address) != 0;
 }
 
 bool
 popBreakpoint(ppcaddr_t address)
 {
-   auto bpList = gBreakpoints.load(std::memory_order_acquire);
-
-   if (bpList == nullptr) {
-      // No breakpoints
-      return false;
-   }
-
-   auto flags = 0u;
-
-   for (auto *bpListIter = bpList; *bpListIter != 0xFFFFFFFF; ) {
-      auto bp_address = *bpListIter++;
-      auto bp_flags = *bpListIter++;
-
-      if (bp_address == address) {
-         flags = bp_flags;
-         break;
-      }
-   }
+   auto flags = findBreakpointFlags(address);
 
    // Short circuit normal flags
    if (!flags) {
@@ -237,42 +180,102 @@ popBreakpoint(ppcaddr_t address)
    }
 
    // We have a system flag, which are one-hit this means we need to remove it
-   // remove_breakpoint will return false if it fails to find and remove that
-   // breakpoint.  We have no need to loop as we are guarenteed not to find it
-   // by looping again since we only pass remove_breakpoint one flag.
-   return removeBreakpoint(bpList, address, SYSTEM_BPFLAG);
+   // removeBreakpoint will return false if another core got to remove that
+   // breakpoint first.
+   return removeBreakpoint(address, SYSTEM_BPFLAG);
 }
 
 bool
 clearBreakpoints(uint32_t flags_mask)
 {
-   auto bpList = gBreakpoints.load(std::memory_order_acquire);
-   return clearBreakpoints(bpList, flags_mask);
+   std::unique_lock<std::mutex> lock { sBreakpointMutex };
+   auto removed = std::vector<ppcaddr_t> { };
+   auto changed = false;
+
+   for (auto itr = sBreakpoints.begin(); itr != sBreakpoints.end(); ) {
+      // If it has any of these flags, clear them
+      if (itr->second & flags_mask) {
+         itr->second &= ~flags_mask;
+         changed = true;
+      }
+
+      // If it has no flags left, take it off the list
+      if (!itr->second) {
+         removed.push_back(itr->first);
+         itr = sBreakpoints.erase(itr);
+      } else {
+         ++itr;
+      }
+   }
+
+   if (!changed) {
+      return false;
+   }
+
+   publishBreakpoints();
+
+   for (auto address : removed) {
+      breakpointAddressChanged(address);
+   }
+
+   return true;
 }
 
 bool
 addBreakpoint(ppcaddr_t address,
               uint32_t flags)
 {
-   if (address == 0xFFFFFFFF) {
-      // Cannot use this address as it is the terminator
-      decaf_abort("0xFFFFFFFF is not a valid address to set a breakpoint on");
-   }
-
    if (!flags) {
       decaf_abort("You must specify at least a single flag for a breakpoint");
    }
 
-   auto bpList = gBreakpoints.load(std::memory_order_acquire);
-   return addBreakpoint(bpList, address, flags);
+   std::unique_lock<std::mutex> lock { sBreakpointMutex };
+   auto &bpFlags = sBreakpoints[address];
+   auto added = (bpFlags == 0);
+
+   // If it already has all the flags, we don't need to change anything
+   if ((bpFlags & flags) == flags) {
+      return false;
+   }
+
+   // Flags are additive
+   bpFlags |= flags;
+   publishBreakpoints();
+
+   if (added) {
+      breakpointAddressChanged(address);
+   }
+
+   return true;
 }
 
 bool
 removeBreakpoint(ppcaddr_t address,
                  uint32_t flags)
 {
-   auto bpList = gBreakpoints.load(std::memory_order_acquire);
-   return removeBreakpoint(bpList, address, flags);
+   std::unique_lock<std::mutex> lock { sBreakpointMutex };
+   auto itr = sBreakpoints.find(address);
+
+   // If it has none of the flags, we have no changes to make
+   if (itr == sBreakpoints.end() || !(itr->second & flags)) {
+      return false;
+   }
+
+   // It only counts as removed if it had every flag
+   auto matched = ((itr->second & flags) == flags);
+
+   // Flags are subtractive
+   itr->second &= ~flags;
+
+   if (itr->second) {
+      publishBreakpoints();
+      return matched;
+   }
+
+   sBreakpoints.erase(itr);
+   publishBreakpoints();
+   breakpointAddressChanged(address);
+   return matched;
 }
 
 } // namespace cpu
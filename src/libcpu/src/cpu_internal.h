@@ -25,6 +25,12 @@ gBranchTraceHandler;
 extern jit_mode
 gJitMode;
 
+extern uint32_t
+gJitTraceThreshold;
+
+extern timebase_mode
+gTimebaseMode;
+
 extern std::condition_variable
 gTimerCondition;
 
@@ -32,7 +38,7 @@ extern std::thread
 gTimerThread;
 
 bool
-hasBreakpoints();
+hasBreakpoint(ppcaddr_t address);
 
 bool
 popBreakpoint(ppcaddr_t address);
@@ -40,15 +46,29 @@ popBreakpoint(ppcaddr_t address);
 void
 timerEntryPoint();
 
+// Raises ALARM_INTERRUPT once the core's own timebase reaches its next
+//  alarm, in timebase_mode::instructions.  Must be called by the core.
+void
+checkInstructionAlarm(Core *core);
+
 KernelCallEntry *
 getKernelCall(uint32_t id);
 
+void
+markCodePages(ppcaddr_t start,
+              ppcaddr_t end);
+
 namespace this_core
 {
 
 void
 updateRoundingMode();
 
+// Like checkInterrupts but without checking for a breakpoint at nia, for
+//  the JIT which checks breakpoints inline at the instructions they are on.
+void
+checkPendingInterrupts();
+
 } // namespace this_core
 
 } // namespace cpu
@@ -1,8 +1,10 @@
 #include "cpu.h"
 #include "cpu_internal.h"
 #include <common/decaf_assert.h>
+#include <algorithm>
 #include <condition_variable>
 #include <atomic>
+#include <limits>
 
 namespace cpu
 {
@@ -10,18 +12,17 @@ namespace cpu
 InterruptHandler
 gInterruptHandler;
 
-std::mutex
-gInterruptMutex;
-
-std::condition_variable
-gInterruptCondition;
-
 std::mutex
 gTimerMutex;
 
 std::condition_variable
 gTimerCondition;
 
+//! Timebase tick the realtime timer thread is sleeping until, it only has to
+//!  be woken for an alarm earlier than this.  Guarded by gTimerMutex.
+static uint64_t
+sTimerDeadline = std::numeric_limits<uint64_t>::max();
+
 std::thread
 gTimerThread;
 
@@ -31,35 +32,66 @@ setInterruptHandler(InterruptHandler handler)
    gInterruptHandler = handler;
 }
 
+static int64_t
+getWakeupClock()
+{
+   auto now = std::chrono::steady_clock::now().time_since_epoch();
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
 void
 interrupt(int core_idx, uint32_t flags)
 {
-   std::unique_lock<std::mutex> lock { gInterruptMutex };
-   gCore[core_idx].interrupt.fetch_or(flags);
-   gInterruptCondition.notify_all();
+   auto core = &gCore[core_idx];
+   core->interrupt.fetch_or(flags);
+
+   // waitForInterrupt sets waiting before it checks the interrupt flags, so
+   //  either it sees the flags we just set or we see it waiting.  Taking its
+   //  wait_mutex means it is either still checking or already asleep.
+   if (core->waiting.load()) {
+      auto posted = int64_t { 0 };
+      core->wakeup_posted.compare_exchange_strong(posted, getWakeupClock());
+
+      std::unique_lock<std::mutex> lock { core->wait_mutex };
+      core->wait_condition.notify_one();
+   }
 }
 
-void
-timerEntryPoint()
+// How often the timer thread lets idle cores catch up with the timebase of
+//  the busy ones in timebase_mode::instructions
+static const auto InstructionTimerPollInterval = std::chrono::milliseconds { 1 };
+
+static void
+realtimeTimerEntryPoint()
 {
    while (gRunning.load()) {
       std::unique_lock<std::mutex> lock{ gTimerMutex };
       auto now = std::chrono::steady_clock::now();
       auto next = std::chrono::steady_clock::time_point::max();
+      auto deadline = std::numeric_limits<uint64_t>::max();
       bool timedWait = false;
 
       for (auto i = 0; i < 3; ++i) {
          auto core = &gCore[i];
 
-         if (core->next_alarm <= now) {
-            core->next_alarm = std::chrono::steady_clock::time_point::max();
+         if (core->next_alarm == std::numeric_limits<uint64_t>::max()) {
+            continue;
+         }
+
+         auto alarm = tbToTimePoint(core->next_alarm);
+
+         if (alarm <= now) {
+            core->next_alarm = std::numeric_limits<uint64_t>::max();
             cpu::interrupt(i, ALARM_INTERRUPT);
-         } else if (core->next_alarm < next) {
-            next = core->next_alarm;
+         } else if (alarm < next) {
+            next = alarm;
+            deadline = core->next_alarm;
             timedWait = true;
          }
       }
 
+      sTimerDeadline = deadline;
+
       if (timedWait) {
          gTimerCondition.wait_until(lock, next);
       } else {
@@ -68,6 +100,144 @@ timerEntryPoint()
    }
 }
 
+// Cores set waiting before checking their interrupt flags, and only clear
+//  it after waking, so a core seen waiting with nothing deliverable has not
+//  been woken yet.
+static bool
+allCoresIdle()
+{
+   for (auto &core : gCore) {
+      auto mask = core.interrupt_mask | NONMASKABLE_INTERRUPTS;
+
+      if (!core.waiting.load() || (core.interrupt.load() & mask)) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+// Busy cores raise their own alarms from their own timebase, this only
+//  moves the timebase of idle cores, which retire no instructions.
+static void
+instructionTimerEntryPoint()
+{
+   while (gRunning.load()) {
+      std::unique_lock<std::mutex> lock{ gTimerMutex };
+      auto allIdle = allCoresIdle();
+      auto anyIdle = false;
+      auto latest = uint64_t { 0 };
+      auto next = std::numeric_limits<uint64_t>::max();
+
+      for (auto &core : gCore) {
+         latest = std::max(latest, core.tb());
+
+         if (core.waiting.load()) {
+            anyIdle = true;
+            next = std::min(next, core.next_alarm);
+         }
+      }
+
+      // Nothing can run until the next alarm fires, so rather than wait
+      //  for the host clock we jump straight to it.
+      auto skipped = allIdle && next != std::numeric_limits<uint64_t>::max();
+
+      if (skipped) {
+         latest = std::max(latest, next);
+      }
+
+      // An idle core catches up with the busiest one.  How far that is
+      //  depends on host scheduling, so alarms raised this way are not
+      //  repeatable unless every core was idle.
+      for (auto i = 0; i < 3; ++i) {
+         auto core = &gCore[i];
+
+         if (!core->waiting.load()) {
+            continue;
+         }
+
+         core->timebase_sync.store(latest);
+
+         if (core->next_alarm <= latest) {
+            core->next_alarm = std::numeric_limits<uint64_t>::max();
+            cpu::interrupt(i, ALARM_INTERRUPT);
+         }
+      }
+
+      if (skipped) {
+         continue;
+      }
+
+      if (anyIdle) {
+         gTimerCondition.wait_for(lock, InstructionTimerPollInterval);
+      } else {
+         gTimerCondition.wait(lock);
+      }
+   }
+}
+
+void
+timerEntryPoint()
+{
+   if (gTimebaseMode == timebase_mode::instructions) {
+      instructionTimerEntryPoint();
+   } else {
+      realtimeTimerEntryPoint();
+   }
+}
+
+// Must be called with gTimerMutex held, by the core itself
+static void
+updateAlarmRetired(Core *core)
+{
+   auto offset = core->timebase_offset.load(std::memory_order_relaxed);
+
+   if (core->next_alarm == std::numeric_limits<uint64_t>::max()) {
+      core->alarm_retired = std::numeric_limits<uint64_t>::max();
+   } else if (core->next_alarm <= offset) {
+      core->alarm_retired = 0;
+   } else if (core->next_alarm - offset > std::numeric_limits<uint64_t>::max() / instructionsPerTick) {
+      core->alarm_retired = std::numeric_limits<uint64_t>::max();
+   } else {
+      core->alarm_retired = (core->next_alarm - offset) * instructionsPerTick;
+   }
+}
+
+void
+checkInstructionAlarm(Core *core)
+{
+   if (core->retired_instructions.load(std::memory_order_relaxed) < core->alarm_retired) {
+      return;
+   }
+
+   std::unique_lock<std::mutex> lock { gTimerMutex };
+
+   if (core->next_alarm <= core->tb()) {
+      core->next_alarm = std::numeric_limits<uint64_t>::max();
+      core->interrupt.fetch_or(ALARM_INTERRUPT);
+   }
+
+   updateAlarmRetired(core);
+}
+
+// Must be called by the core itself
+static void
+syncCoreTimebase(Core *core,
+                 uint64_t tb)
+{
+   auto now = core->tb();
+
+   if (tb <= now) {
+      return;
+   }
+
+   auto offset = core->timebase_offset.load(std::memory_order_relaxed);
+   core->timebase_offset.store(offset + (tb - now), std::memory_order_relaxed);
+
+   std::unique_lock<std::mutex> lock { gTimerMutex };
+   updateAlarmRetired(core);
+}
+
 namespace this_core
 {
 
@@ -92,28 +262,65 @@ setInterruptMask(uint32_t mask)
    return old_mask;
 }
 
+static void
+handleInterrupts(Core *core,
+                 uint32_t flags)
+{
+   if (gTimebaseMode == timebase_mode::instructions) {
+      checkInstructionAlarm(core);
+   }
+
+   auto mask = core->interrupt_mask | NONMASKABLE_INTERRUPTS;
+   flags |= core->interrupt.fetch_and(~mask);
+
+   if (flags & mask) {
+      cpu::gInterruptHandler(flags);
+   }
+}
+
 void
 checkInterrupts()
 {
    auto core = state();
-   auto mask = core->interrupt_mask | NONMASKABLE_INTERRUPTS;
-   auto flags = core->interrupt.fetch_and(~mask);
+   auto flags = 0u;
 
    // Check if we hit any breakpoints
    if (popBreakpoint(core->nia)) {
       flags |= DBGBREAK_INTERRUPT;
    }
 
-   if (flags & mask) {
-      cpu::gInterruptHandler(flags);
+   handleInterrupts(core, flags);
+}
+
+void
+checkPendingInterrupts()
+{
+   handleInterrupts(state(), 0);
+}
+
+static void
+recordWakeupLatency(Core *core)
+{
+   auto posted = core->wakeup_posted.exchange(0);
+
+   if (!posted) {
+      return;
    }
+
+   auto micros = std::max<int64_t>(getWakeupClock() - posted, 0) / 1000;
+   auto bucket = 0u;
+
+   while (bucket < WakeupLatencyBuckets - 1 && micros >= (int64_t { 1 } << bucket)) {
+      ++bucket;
+   }
+
+   core->wakeup_latency.buckets[bucket]++;
 }
 
 void
 waitForInterrupt()
 {
    auto core = this_core::state();
-   std::unique_lock<std::mutex> lock { gInterruptMutex };
 
    while (true) {
       if (!(core->interrupt_mask & ~NONMASKABLE_INTERRUPTS)) {
@@ -123,25 +330,76 @@ waitForInterrupt()
       auto mask = core->interrupt_mask | NONMASKABLE_INTERRUPTS;
       auto flags = core->interrupt.fetch_and(~mask);
 
+      if (gTimebaseMode == timebase_mode::instructions) {
+         // The timer thread posts the timebase before any alarm it raises
+         //  for it, so this has to come after taking the flags.
+         auto sync = core->timebase_sync.exchange(0);
+
+         if (sync) {
+            syncCoreTimebase(core, sync);
+         }
+      }
+
       if (flags & mask) {
-         lock.unlock();
+         recordWakeupLatency(core);
          gInterruptHandler(flags);
-         lock.lock();
-      } else {
-         gInterruptCondition.wait(lock);
+         continue;
       }
+
+      std::unique_lock<std::mutex> lock { core->wait_mutex };
+      core->wakeup_posted.store(0);
+      core->waiting.store(true);
+
+      if (!(core->interrupt.load() & mask)) {
+         if (gTimebaseMode == timebase_mode::instructions) {
+            // Let the timer thread skip ahead if this was the last busy core
+            gTimerCondition.notify_all();
+         }
+
+         core->wait_condition.wait(lock);
+      }
+
+      core->waiting.store(false);
    }
 }
 
 void
-setNextAlarm(std::chrono::steady_clock::time_point time)
+setNextAlarm(uint64_t alarm_tb)
 {
    auto core = this_core::state();
    std::unique_lock<std::mutex> lock { gTimerMutex };
-   core->next_alarm = time;
-   gTimerCondition.notify_all();
+   core->next_alarm = alarm_tb;
+
+   if (gTimebaseMode == timebase_mode::instructions) {
+      // The core raises the alarm itself when it reaches it
+      updateAlarmRetired(core);
+   } else if (alarm_tb < sTimerDeadline) {
+      gTimerCondition.notify_all();
+   }
+}
+
+void
+syncTimebase(uint64_t tb)
+{
+   if (gTimebaseMode == timebase_mode::instructions) {
+      syncCoreTimebase(state(), tb);
+   }
 }
 
 } // namespace this_core
 
+WakeupLatencyStats
+getWakeupLatencyStats()
+{
+   auto stats = WakeupLatencyStats { };
+
+   for (auto &core : gCore) {
+      for (auto i = 0u; i < WakeupLatencyBuckets; ++i) {
+         stats.buckets[i] += core.wakeup_latency.buckets[i];
+      }
+   }
+
+   return stats;
+}
+
 } // namespace cpu
@@ -1,4 +1,5 @@
 #include <common/decaf_assert.h>
+#include <common/fastregionmap.h>
 #include <common/log.h>
 #include "cpu_internal.h"
 #include "espresso/espresso_instructionset.h"
@@ -6,7 +7,11 @@
 #include "interpreter_insreg.h"
 #include "mem.h"
 #include "trace.h"
+#include <algorithm>
+#include <atomic>
 #include <cfenv>
+#include <map>
+#include <mutex>
 
 namespace cpu
 {
@@ -14,9 +19,60 @@ namespace cpu
 namespace interpreter
 {
 
+static const uint32_t INTERP_MAX_BLOCK_INST = 256;
+
+struct PredecodedInstruction
+{
+   espresso::Instruction instr;
+   espresso::InstructionInfo *data;
+   instrfptr_t fptr;
+};
+
+struct PredecodedBlock
+{
+   uint32_t start;
+   uint32_t end;
+   std::atomic<bool> valid;
+
+   //! Number of executeBlock calls using this block, a retired block is
+   //!  only freed once this reaches zero.
+   std::atomic<uint32_t> users;
+   std::vector<PredecodedInstruction> instrs;
+};
+
+//! Set by a core while it looks up a block and takes a reference to it
+struct alignas(64) BlockLookup
+{
+   std::atomic<bool> active { false };
+};
+
 static std::vector<instrfptr_t>
 sInstructionMap;
 
+static FastRegionMap<PredecodedBlock *>
+sBlockCache;
+
+static std::mutex
+sBlockMutex;
+
+// All live blocks sorted by their start address, used to find the blocks
+//  which overlap an invalidated range.  Protected by sBlockMutex.
+static std::multimap<uint32_t, PredecodedBlock *>
+sBlockList;
+
+// Invalidated blocks might still be executing on another core, they are
+//  freed once nothing uses them.  Protected by sBlockMutex.
+static std::vector<PredecodedBlock *>
+sRetiredBlocks;
+
+// Bumped by every invalidation, a block decoded while this changed may have
+//  been built from stale instructions.
+static std::atomic<uint32_t>
+sBlockGeneration { 0 };
+
+static BlockLookup
+sBlockLookups[3];
+
 void
 initialise()
 {
@@ -56,34 +112,225 @@ hasInstruction(espresso::InstructionID id)
    return getInstructionHandler(id) != nullptr;
 }
 
-Core *
-step_one(Core *core)
+static bool
+isBlockTerminator(espresso::InstructionID id)
 {
-   this_core::checkInterrupts();
+   switch (id) {
+   case espresso::InstructionID::b:
+   case espresso::InstructionID::bc:
+   case espresso::InstructionID::bcctr:
+   case espresso::InstructionID::bclr:
+   case espresso::InstructionID::kc:
+   case espresso::InstructionID::sc:
+   case espresso::InstructionID::rfi:
+   case espresso::InstructionID::tw:
+   case espresso::InstructionID::twi:
+      return true;
+   default:
+      return false;
+   }
+}
 
-   // The interrupt call above may have switched what core we are on,
-   //  we need to pick up the new core, who knows why we even pass
-   //  the core into this function really...
-   core = this_core::state();
+static PredecodedBlock *
+buildBlock(uint32_t start)
+{
+   auto block = new PredecodedBlock { };
+   block->start = start;
+   block->valid.store(true);
 
-   // This is volatile because otherwise we appear to encounter
-   //  some kind of compiler optimization error, where the value
-   //  in cia is not correctly persisted.
-   uint32_t cia = core->nia;
+   // The pages have to be marked before we read them, otherwise a write to
+   //  them while we are decoding would not be passed on to
+   //  invalidateBlockCache.
+   auto maxEnd = std::min<uint64_t>(static_cast<uint64_t>(start) + INTERP_MAX_BLOCK_INST * 4, 0xFFFFFFFF);
+   markCodePages(start, static_cast<uint32_t>(maxEnd));
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+
+   for (auto cia = start; block->instrs.size() < INTERP_MAX_BLOCK_INST; cia += 4) {
+      auto instr = mem::read<espresso::Instruction>(cia);
+      auto data = espresso::decodeInstructionFlat(instr);
+
+      if (!data) {
+         // The block ends before the failed decode, decodeAndExecute reports
+         //  it when execution reaches it.
+         break;
+      }
+
+      auto fptr = sInstructionMap[static_cast<size_t>(data->id)];
+
+      if (!fptr) {
+         break;
+      }
+
+      block->instrs.push_back({ instr, data, fptr });
+
+      if (isBlockTerminator(data->id)) {
+         break;
+      }
+   }
+
+   block->end = start + static_cast<uint32_t>(block->instrs.size() * 4);
+   return block;
+}
+
+// Frees the retired blocks which nothing uses any more.
+// Must be called with sBlockMutex held.
+static void
+freeRetiredBlocks()
+{
+   // A core which found a block in sBlockCache before it was retired might
+   //  not have taken its reference yet.
+   for (auto &lookup : sBlockLookups) {
+      if (lookup.active.load(std::memory_order_seq_cst)) {
+         return;
+      }
+   }
+
+   auto itr = sRetiredBlocks.begin();
+
+   while (itr != sRetiredBlocks.end()) {
+      if ((*itr)->users.load(std::memory_order_acquire)) {
+         ++itr;
+         continue;
+      }
+
+      delete *itr;
+      itr = sRetiredBlocks.erase(itr);
+   }
+}
+
+// Returns the block starting at address with a reference held, which must
+//  be dropped with releaseBlock.
+static PredecodedBlock *
+getBlock(Core *core,
+         uint32_t address)
+{
+   auto &lookup = sBlockLookups[core->id];
+   lookup.active.store(true, std::memory_order_seq_cst);
+
+   auto block = sBlockCache.find(address);
+
+   if (block) {
+      block->users.fetch_add(1, std::memory_order_seq_cst);
+   }
+
+   lookup.active.store(false, std::memory_order_release);
+
+   if (block) {
+      return block;
+   }
+
+   auto generation = sBlockGeneration.load(std::memory_order_acquire);
+   block = buildBlock(address);
+
+   if (block->instrs.empty()) {
+      delete block;
+      return nullptr;
+   }
+
+   std::unique_lock<std::mutex> lock { sBlockMutex };
+
+   // The instructions changed while we were decoding, so we cannot trust
+   //  this block.  Let decodeAndExecute step the current ones instead.
+   if (sBlockGeneration.load(std::memory_order_relaxed) != generation) {
+      delete block;
+      return nullptr;
+   }
+
+   // Another core may have built this block while we were decoding
+   auto existing = sBlockCache.find(address);
+
+   if (existing) {
+      delete block;
+      block = existing;
+   } else {
+      sBlockList.emplace(block->start, block);
+      sBlockCache.set(address, block);
+   }
+
+   block->users.fetch_add(1, std::memory_order_relaxed);
+   freeRetiredBlocks();
+   return block;
+}
+
+static void
+releaseBlock(PredecodedBlock *block)
+{
+   block->users.fetch_sub(1, std::memory_order_release);
+}
+
+void
+invalidateBlockCache(ppcaddr_t address, uint32_t size)
+{
+   auto end = static_cast<uint64_t>(address) + size;
+   auto minStart = address > INTERP_MAX_BLOCK_INST * 4 ? address - INTERP_MAX_BLOCK_INST * 4 : 0;
+   std::unique_lock<std::mutex> lock { sBlockMutex };
+   auto itr = sBlockList.lower_bound(minStart);
+   sBlockGeneration.fetch_add(1, std::memory_order_release);
+
+   while (itr != sBlockList.end() && itr->first < end) {
+      auto block = itr->second;
+
+      if (block->end <= address) {
+         ++itr;
+         continue;
+      }
+
+      block->valid.store(false);
+      sBlockCache.set(block->start, nullptr);
+      sRetiredBlocks.push_back(block);
+      itr = sBlockList.erase(itr);
+   }
+
+   freeRetiredBlocks();
+}
+
+static Core *
+executeInstruction(Core *core,
+                   uint32_t cia,
+                   espresso::Instruction instr,
+                   espresso::InstructionInfo *data,
+                   instrfptr_t fptr)
+{
    core->nia = cia + 4;
 
    // For debugging purposes.
    core->cia = cia;
 
+   // Only this core writes to the counter, so it does not need to be RMW
+   auto retired = core->retired_instructions.load(std::memory_order_relaxed);
+   core->retired_instructions.store(retired + 1, std::memory_order_relaxed);
+
+   auto trace = traceInstructionStart(instr, data, core);
+   fptr(core, instr);
+
+   if (data->id == InstructionID::kc) {
+      // If this is a KC, there is the potential that we are running on a
+      //  different core now.  Lets make sure that we are using the right one.
+      core = this_core::state();
+   }
+
+   decaf_check(core->cia == cia);
+   traceInstructionEnd(trace, instr, data, core);
+
+   return core;
+}
+
+static Core *
+decodeAndExecute(Core *core)
+{
+   // This is volatile because otherwise we appear to encounter
+   //  some kind of compiler optimization error, where the value
+   //  in cia is not correctly persisted.
+   uint32_t cia = core->nia;
+
    auto instr = mem::read<espresso::Instruction>(cia);
-   auto data = espresso::decodeInstruction(instr);
+   auto data = espresso::decodeInstructionFlat(instr);
 
    if (!data) {
       gLog->error("Could not decode instruction at {:08x} = {:08x}", cia, instr.value);
    }
    decaf_check(data);
 
-   auto trace = traceInstructionStart(instr, data, core);
    auto fptr = sInstructionMap[static_cast<size_t>(data->id)];
 
    if (!fptr) {
@@ -91,16 +338,36 @@ step_one(Core *core)
    }
    decaf_check(fptr);
 
-   fptr(core, instr);
+   return executeInstruction(core, cia, instr, data, fptr);
+}
 
-   if (data->id == InstructionID::kc) {
-      // If this is a KC, there is the potential that we are running on a
-      //  different core now.  Lets make sure that we are using the right one.
-      core = this_core::state();
-   }
+// Executes a predecoded block, interrupts must already have been checked
+//  for the first instruction of the block.
+static Core *
+executeBlock(Core *core, PredecodedBlock *block)
+{
+   auto cia = block->start;
 
-   decaf_check(core->cia == cia);
-   traceInstructionEnd(trace, instr, data, core);
+   for (auto i = 0u; i < block->instrs.size(); ++i, cia += 4) {
+      if (i > 0) {
+         this_core::checkInterrupts();
+         core = this_core::state();
+      }
+
+      // If an interrupt moved us elsewhere or the block was invalidated we
+      //  must not run the rest of it, but the interrupts for this
+      //  instruction have already been checked so we step it directly.
+      if (core->nia != cia || !block->valid.load(std::memory_order_relaxed)) {
+         return decodeAndExecute(core);
+      }
+
+      auto &entry = block->instrs[i];
+      core = executeInstruction(core, cia, entry.instr, entry.data, entry.fptr);
+
+      if (core->nia != cia + 4) {
+         break;
+      }
+   }
 
    return core;
 }
@@ -114,7 +381,17 @@ resume()
 
    auto core = cpu::this_core::state();
    while (core->nia != cpu::CALLBACK_ADDR) {
-      core = step_one(core);
+      this_core::checkInterrupts();
+      core = this_core::state();
+
+      auto block = getBlock(core, core->nia);
+
+      if (block) {
+         core = executeBlock(core, block);
+         releaseBlock(block);
+      } else {
+         core = decodeAndExecute(core);
+      }
    }
 }
 
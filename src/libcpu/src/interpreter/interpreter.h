@@ -13,6 +13,10 @@ initialise();
 void
 resume();
 
+void
+invalidateBlockCache(ppcaddr_t address,
+                     uint32_t size);
+
 } // namespace interpreter
 
 } // namespace cpu
@@ -10,13 +10,18 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <common/align.h>
 #include <common/bitutils.h>
 #include <common/decaf_assert.h>
 #include <common/fastregionmap.h>
 #include <common/log.h>
 #include <cfenv>
+#include <iterator>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 namespace cpu
@@ -25,9 +30,15 @@ namespace cpu
 namespace jit
 {
 
-static const bool JIT_DEBUG = true;
+// Store nia before every instruction and pad each one with a NOP. The guest
+//  address of faulting code is recovered from the code map instead, so this
+//  is only useful when reading the generated code.
+static const bool JIT_DEBUG = false;
 static const int JIT_MAX_INST = 3000;
+static const int JIT_MAX_TRACE_INST = 1000;
+static const int JIT_MAX_TRACE_BRANCHES = 16;
 static const bool JIT_REGCACHE = true;
+static const size_t JIT_MAX_CODE_SIZE = 0x40000000;
 
 // Insert NOPs at the beginning of a generated block of code.
 //  The Visual Studio disassembler can get confused without these.
@@ -47,6 +58,77 @@ sRuntime;
 static FastRegionMap<JitCode>
 sJitBlocks;
 
+// Bookkeeping for a generated block so it can be invalidated when the
+//  guest code it was translated from is modified.
+struct JitBlockInfo
+{
+   // Guest address ranges this block was translated from
+   std::vector<std::pair<uint32_t, uint32_t>> ranges;
+
+   // Execution counter if this block may still be promoted to a trace
+   uint32_t *profileCounter;
+
+   // Set when an invalidation removes this block
+   uint32_t *invalidated;
+
+   // Guest addresses this block registered in sJitBlocks
+   std::vector<std::pair<uint32_t, JitCode>> entries;
+
+   // Relocation slots inside this block's code, and their guest target
+   std::vector<std::pair<uint32_t, JitCode *>> exits;
+};
+
+// Protects sBlockList and sBlockLinks
+static std::mutex
+sBlockMutex;
+
+// All live blocks sorted by the start of each of their guest ranges
+static std::multimap<uint32_t, JitBlockInfo *>
+sBlockList;
+
+// Bumped by every invalidation, code generated while this changed may have
+//  been translated from stale instructions.
+static std::atomic<uint32_t>
+sInvalidateGeneration { 0 };
+
+// Guest ranges of the most recent invalidations indexed by their generation,
+//  so we only throw away code which was translated from one of them.
+static const uint32_t InvalidatedRangeHistory = 64;
+
+static std::array<std::pair<uint32_t, uint64_t>, InvalidatedRangeHistory>
+sInvalidatedRanges;
+
+// Number of times get() will generate a block without holding sBlockMutex
+//  before it gives up racing against invalidations.
+static const int MaxUnlockedGenerateAttempts = 3;
+
+// Relocation slots which have been linked directly to a guest address
+static std::unordered_map<uint32_t, std::vector<JitCode *>>
+sBlockLinks;
+
+// Execution counters for profiled blocks and the invalidated flag of every
+//  block, these are only released by clearCache as code for invalidated
+//  blocks may still be running.
+static const size_t ProfileCounterChunkSize = 4096;
+
+static std::vector<std::unique_ptr<uint32_t[]>>
+sProfileCounters;
+
+static size_t
+sProfileCountersUsed = ProfileCounterChunkSize;
+
+// Maps generated host code back to guest instructions for the fault
+//  handlers, keyed by the host address of each block.  Like the profile
+//  counters these are kept until clearCache.
+struct JitCodeMap
+{
+   size_t size;
+   std::vector<std::pair<uint32_t, uint32_t>> offsets;
+};
+
+static std::map<asmjit::Ptr, JitCodeMap>
+sCodeMaps;
+
 static std::array<uint8_t, 32>
 sBaseRelocCode;
 
@@ -62,6 +144,15 @@ gCallFn;
 JitFinale
 gFinaleFn;
 
+static JitFinale
+sPromoteFn;
+
+uint64_t
+gIndirectTargetCache[IndirectTargetCacheSize];
+
+asmjit::Ptr
+gCodeBase;
+
 void
 registerUnwindTable(VMemRuntime *runtime, intptr_t jitCallAddr);
 
@@ -71,6 +162,9 @@ unregisterUnwindTable();
 JitCode
 jit_continue(uint32_t addr, JitCode *jumpSource);
 
+JitCode
+jit_promote(uint32_t addr);
+
 static void
 initStubs()
 {
@@ -85,6 +179,7 @@ initStubs()
    auto introLabel = a.newLabel();
    auto extroLabel = a.newLabel();
    auto exitLabel = a.newLabel();
+   auto promoteLabel = a.newLabel();
    auto verifyPreLabel = a.newLabel();
    auto verifyPostLabel = a.newLabel();
 
@@ -133,6 +228,13 @@ initStubs()
    a.call(asmjit::x86::rax);
    a.jmp(asmjit::x86::rax);
 
+   // This is jumped to by a profiled block once it has become hot enough
+   //  to be translated again as a trace.
+   a.bind(promoteLabel);
+   a.mov(asmjit::x86::rax, asmjit::Ptr(jit_promote));
+   a.call(asmjit::x86::rax);
+   a.jmp(asmjit::x86::rax);
+
    // This is how we exit back to the caller
    a.bind(exitLabel);
    a.mov(a.niaMem, a.finaleNiaArgReg);
@@ -231,6 +333,7 @@ initStubs()
    auto basePtr = a.make();
    gCallFn = asmjit_cast<JitCall>(basePtr, a.getLabelOffset(introLabel));
    gFinaleFn = asmjit_cast<JitCall>(basePtr, a.getLabelOffset(extroLabel));
+   sPromoteFn = asmjit_cast<JitCall>(basePtr, a.getLabelOffset(promoteLabel));
    if (gJitMode == jit_mode::verify) {
       sPreInstr = asmjit_cast<void *>(basePtr, a.getLabelOffset(verifyPreLabel));
       sPostInstr = asmjit_cast<void *>(basePtr, a.getLabelOffset(verifyPostLabel));
@@ -255,9 +358,18 @@ initStubs()
 void
 initialiseRuntime()
 {
-   sRuntime = new VMemRuntime(0x20000, 0x40000000);
+   sRuntime = new VMemRuntime(0x20000, JIT_MAX_CODE_SIZE);
+   gCodeBase = sRuntime->getRootAddress();
    initStubs();
    registerUnwindTable(sRuntime, reinterpret_cast<intptr_t>(gCallFn));
+
+   // Any cached host addresses now point into the old runtime
+   std::fill(std::begin(gIndirectTargetCache), std::end(gIndirectTargetCache), IndirectTargetEmpty);
+
+   for (auto &core : gCore) {
+      core.jit_ras_top = 0;
+      std::fill(std::begin(core.jit_ras), std::end(core.jit_ras), IndirectTargetEmpty);
+   }
 }
 
 void
@@ -321,38 +433,283 @@ clearCache()
    initialiseRuntime();
 
    sJitBlocks.clear();
+
+   // Traces are in the list once for each of their ranges
+   for (auto &block : sBlockList) {
+      if (block.first == block.second->ranges.front().first) {
+         delete block.second;
+      }
+   }
+
+   sBlockList.clear();
+   sBlockLinks.clear();
+   sProfileCounters.clear();
+   sProfileCountersUsed = ProfileCounterChunkSize;
+   sCodeMaps.clear();
+}
+
+// Must be called with sBlockMutex held
+static uint32_t *
+allocProfileCounter()
+{
+   if (sProfileCountersUsed == ProfileCounterChunkSize) {
+      sProfileCounters.emplace_back(new uint32_t[ProfileCounterChunkSize]);
+      sProfileCountersUsed = 0;
+   }
+
+   auto counter = &sProfileCounters.back()[sProfileCountersUsed++];
+   *counter = 0;
+   return counter;
+}
+
+// Must be called with sBlockMutex held
+static uint32_t *
+allocInvalidatedFlag()
+{
+   return allocProfileCounter();
+}
+
+// Must be called with sBlockMutex held
+static void
+linkBlock(uint32_t addr, JitCode *slot, JitCode target)
+{
+   // Aligned writes on x64 are guarenteed to be atomic
+   *slot = target;
+   sBlockLinks[addr].push_back(slot);
+}
+
+// Must be called with sBlockMutex held
+static void
+unlinkSlot(uint32_t addr, JitCode *slot)
+{
+   auto itr = sBlockLinks.find(addr);
+
+   if (itr == sBlockLinks.end()) {
+      return;
+   }
+
+   auto &slots = itr->second;
+   slots.erase(std::remove(slots.begin(), slots.end(), slot), slots.end());
+
+   if (slots.empty()) {
+      sBlockLinks.erase(itr);
+   }
+}
+
+// Must be called with sBlockMutex held
+static void
+freeBlock(JitBlockInfo *block)
+{
+   for (auto &entry : block->entries) {
+      // Only remove the lookup if it still points at this block, another
+      //  block may have registered the same guest address since.
+      if (sJitBlocks.find(entry.first) == entry.second) {
+         sJitBlocks.set(entry.first, nullptr);
+      }
+
+      // Send everything which jumps directly here back to the dispatcher
+      auto itr = sBlockLinks.find(entry.first);
+
+      if (itr != sBlockLinks.end()) {
+         for (auto slot : itr->second) {
+            *slot = reinterpret_cast<JitCode>(gFinaleFn);
+         }
+
+         sBlockLinks.erase(itr);
+      }
+
+      // Remove any indirect branch target cache entry for it
+      auto &cached = gIndirectTargetCache[indirectTargetIndex(entry.first)];
+
+      if (cached == packIndirectTarget(entry.first, entry.second)) {
+         cached = IndirectTargetEmpty;
+      }
+   }
+
+   // Our own relocation slots can still be reached through the return
+   //  address stack, so they must go back through the dispatcher too.
+   for (auto &exit : block->exits) {
+      unlinkSlot(exit.first, exit.second);
+      *exit.second = reinterpret_cast<JitCode>(gFinaleFn);
+   }
+
+   // The host code itself is not reclaimed as another core may still be
+   //  executing inside it, it is released with the rest of the runtime
+   //  on the next clearCache.
+   delete block;
+}
+
+// Must be called with sBlockMutex held
+static void
+removeBlock(JitBlockInfo *block)
+{
+   for (auto &range : block->ranges) {
+      auto itrs = sBlockList.equal_range(range.first);
+
+      for (auto itr = itrs.first; itr != itrs.second; ) {
+         if (itr->second == block) {
+            itr = sBlockList.erase(itr);
+         } else {
+            ++itr;
+         }
+      }
+   }
+
+   freeBlock(block);
+}
+
+void
+invalidateCache(ppcaddr_t address,
+                uint32_t size)
+{
+   auto end = static_cast<uint64_t>(address) + size;
+   auto maxBlockSize = static_cast<uint32_t>((JIT_MAX_INST + 1) * 4);
+   auto minStart = address > maxBlockSize ? address - maxBlockSize : 0;
+   auto overlapping = std::vector<JitBlockInfo *> { };
+
+   std::unique_lock<std::mutex> lock { sBlockMutex };
+   auto generation = sInvalidateGeneration.fetch_add(1, std::memory_order_release) + 1;
+   sInvalidatedRanges[generation % InvalidatedRangeHistory] = { address, end };
+
+   for (auto itr = sBlockList.lower_bound(minStart); itr != sBlockList.end() && itr->first < end; ++itr) {
+      auto block = itr->second;
+
+      for (auto &range : block->ranges) {
+         if (range.first < end && range.second > address) {
+            overlapping.push_back(block);
+            break;
+         }
+      }
+   }
+
+   // A trace can appear once for each of its ranges
+   std::sort(overlapping.begin(), overlapping.end());
+   overlapping.erase(std::unique(overlapping.begin(), overlapping.end()), overlapping.end());
+
+   for (auto block : overlapping) {
+      *block->invalidated = 1;
+      removeBlock(block);
+   }
 }
 
 using JumpTargetList = std::vector<uint32_t>;
 
+void
+jit_b_reloc(PPCEmuAssembler& a, ppcaddr_t addr)
+{
+   // Even if we already know where the target is, we always go through
+   //  a relocation so that the link can be undone if the target block is
+   //  invalidated.  Let's allocate some space for an aligned MOV
+   //  instruction, then mark it as a relocation so it can be filled by
+   //  the 'linker' below.
+   auto relocLbl = a.newLabel();
+   a.bind(relocLbl);
+
+   // Save 32 bytes of memory so we have room to do set up the
+   //  call during relocation once we know where its going to
+   //  reside in the host jit memory section.
+   for (auto i = 0; i < 32; ++i) {
+      a.int3();
+   }
+   a.jmp(asmjit::x86::rax);
+
+   a.relocLabels.emplace_back(addr, relocLbl);
+}
+
 void
 jit_b_direct(PPCEmuAssembler& a, ppcaddr_t addr)
 {
    a.saveAll();
+   jit_b_reloc(a, addr);
+}
 
-   auto target = sJitBlocks.find(addr);
-   if (target) {
-      // We already know where this function is, let's just jump
-      //  directly to it rather than wasting time going through
-      //  the JIT dispatcher!
-      a.jmp(asmjit::Ptr(target));
-   } else {
-      // We have not JIT'd this section yet.  Let's allocate some
-      //  space for an aligned MOV instruction, then mark it as a
-      //  relocation so it can be filled by the 'linker' below.
-      auto relocLbl = a.newLabel();
-      a.bind(relocLbl);
+static const uint32_t
+NoBreakpointResume = 0xFFFFFFFF;
+
+// Called by translated code to check for interrupts, and for the breakpoint
+//  at nia when checkBreakpoint is set.  The core may stop in the debugger.
+//  invalidated is the flag of the block which is calling us.
+Core *
+jit_handle_stop(uint32_t *invalidated,
+                bool checkBreakpoint)
+{
+   auto core = this_core::state();
+   auto atBreakpoint = checkBreakpoint;
 
-      // Save 32 bytes of memory so we have room to do set up the
-      //  call during relocation once we know where its going to
-      //  reside in the host jit memory section.
-      for (auto i = 0; i < 32; ++i) {
-         a.int3();
+   if (atBreakpoint) {
+      if (core->jit_breakpoint_resume == core->nia) {
+         // We already stopped here before leaving the old translation
+         checkBreakpoint = false;
       }
-      a.jmp(asmjit::x86::rax);
 
-      a.relocLabels.emplace_back(addr, relocLbl);
+      core->jit_breakpoint_resume = NoBreakpointResume;
+   }
+
+   auto generation = sInvalidateGeneration.load(std::memory_order_acquire);
+
+   if (checkBreakpoint) {
+      this_core::checkInterrupts();
+   } else {
+      this_core::checkPendingInterrupts();
+   }
+
+   core = this_core::state();
+
+   // Stepping adds breakpoints while we are stopped, which invalidates the
+   //  code they are on.  If that removed our block, the rest of it was
+   //  translated without them so we have to leave it for the new
+   //  translation.  If that starts with the breakpoint we stopped at, it
+   //  must not stop there again.
+   if (generation != sInvalidateGeneration.load(std::memory_order_acquire)) {
+      std::unique_lock<std::mutex> lock { sBlockMutex };
+
+      if (*invalidated) {
+         core->jit_block_stale = 1;
+
+         if (atBreakpoint && hasBreakpoint(core->nia)) {
+            core->jit_breakpoint_resume = core->nia;
+         }
+      }
    }
+
+   return core;
+}
+
+// Must directly follow a call to jit_handle_stop, leaves the block to
+//  continue at nia if it found the block stale.
+void
+jit_leave_if_stale(PPCEmuAssembler& a, ppcaddr_t nia)
+{
+   auto continueLbl = a.newLabel();
+
+   a.cmp(a.blockStaleMem, 0);
+   a.je(continueLbl);
+
+   a.mov(a.blockStaleMem, 0);
+   a.mov(a.finaleNiaArgReg, nia);
+   a.mov(a.finaleJmpSrcArgReg, 0);
+   a.jmp(asmjit::Ptr(gFinaleFn));
+
+   a.bind(continueLbl);
+}
+
+static Core *
+jit_breakpoint_stub(uint32_t *invalidated)
+{
+   return jit_handle_stop(invalidated, true);
+}
+
+// Stops at the breakpoint on the instruction at cia, the stub only returns
+//  once the debugger lets the core continue.
+static void
+jit_check_breakpoint(PPCEmuAssembler& a, ppcaddr_t cia)
+{
+   a.evictAll();
+   a.mov(a.niaMem, cia);
+   a.mov(a.sysArgReg[0], asmjit::Ptr(a.blockInvalidated));
+   a.call(asmjit::Ptr(jit_breakpoint_stub));
+   a.mov(a.stateReg, asmjit::x86::rax);
+   jit_leave_if_stale(a, cia);
 }
 
 bool
@@ -360,6 +717,7 @@ gen(JitBlock &block)
 {
    PPCEmuAssembler a(sRuntime);
    a.relocLabels.reserve(10);
+   a.blockInvalidated = block.invalidated;
 
    struct TargetLblPair {
       uint32_t idx;
@@ -380,63 +738,130 @@ gen(JitBlock &block)
       }
    }
 
-   for (lclCia = block.start; lclCia < block.end; lclCia += 4)
-   {
-      auto targetIter = targetLbls.find(lclCia);
-      if (targetIter != targetLbls.end()) {
-         // This is a jump target, we should flush any register caches
-         //  and then also insert a label so we can find this location.
-         a.bind(targetIter->second.label);
-      }
+   // A normal block is just a trace with a single range
+   auto ranges = block.ranges;
+
+   if (ranges.empty()) {
+      ranges.emplace_back(block.start, block.end);
+   }
+
+   if (block.profileCounter) {
+      // Count executions of this block and jump to the promoter once it
+      //  has become hot enough to be worth translating as a trace.
+      auto notHotLbl = a.newLabel();
+      a.mov(asmjit::x86::rax, asmjit::Ptr(block.profileCounter));
+      a.inc(asmjit::X86Mem(asmjit::x86::rax, 0, 4));
+      a.cmp(asmjit::X86Mem(asmjit::x86::rax, 0, 4), gJitTraceThreshold);
+      a.jb(notHotLbl);
+      a.mov(a.finaleNiaArgReg, block.start);
+      a.jmp(asmjit::Ptr(sPromoteFn));
+      a.bind(notHotLbl);
+   }
+
+   // Verification compares nia after every instruction
+   auto storeNia = JIT_DEBUG || gJitMode == jit_mode::verify;
+
+   // For the instruction counted timebase each run of instructions between
+   //  jump targets adds its length to the retired count when it is entered.
+   //  A branch out of the middle of a run still counts the whole run, which
+   //  is fine as it only has to be repeatable, not exact.
+   auto countRetired = gTimebaseMode == timebase_mode::instructions;
+   auto runStart = true;
+
+   auto runLength = [&](uint32_t rangeIdx, uint32_t cia) {
+      auto length = 0;
+
+      for (auto i = rangeIdx; i < ranges.size(); ++i) {
+         auto start = (i == rangeIdx) ? cia : ranges[i].first;
 
-      if (JIT_DEBUG) {
-         a.mov(a.niaMem, lclCia + 4);
+         for (auto addr = start; addr < ranges[i].second; addr += 4) {
+            if (length > 0 && targetLbls.count(addr)) {
+               return length;
+            }
+
+            ++length;
+         }
       }
 
-      auto instr = mem::read<espresso::Instruction>(lclCia);
-      auto data = espresso::decodeInstruction(instr);
+      return length;
+   };
 
-      if (!data) {
-         a.ud2();
-      } else {
-         // Don't attempt to verify non-repeatable instructions
-         bool doVerify = (gJitMode == jit_mode::verify
-                          && data->id != espresso::InstructionID::kc
-                          && data->id != espresso::InstructionID::lwarx
-                          && data->id != espresso::InstructionID::stwcx);
-         if (doVerify) {
-            insertVerifyCall(a, instr, sPreInstr);
+   for (auto i = 0u; i < ranges.size(); ++i) {
+      for (lclCia = ranges[i].first; lclCia < ranges[i].second; lclCia += 4) {
+         auto targetIter = targetLbls.find(lclCia);
+         if (targetIter != targetLbls.end()) {
+            // This is a jump target, we should flush any register caches
+            //  and then also insert a label so we can find this location.
+            a.bind(targetIter->second.label);
+            runStart = true;
+         }
+
+         if (countRetired && runStart) {
+            a.add(a.retiredMem, runLength(i, lclCia));
          }
 
-         a.genCia = lclCia;
+         runStart = false;
 
-         auto genSuccess = false;
+         block.codeMap.emplace_back(static_cast<uint32_t>(a.getOffset()), lclCia);
 
-         auto fptr = sInstructionMap[static_cast<size_t>(data->id)];
-         if (fptr) {
-            genSuccess = fptr(a, instr);
+         if (hasBreakpoint(lclCia)) {
+            jit_check_breakpoint(a, lclCia);
          }
 
-         if (!genSuccess) {
-            a.int3();
+         if (storeNia) {
+            a.mov(a.niaMem, lclCia + 4);
          }
 
-         if (doVerify) {
-            insertVerifyCall(a, instr, sPostInstr);
+         auto instr = mem::read<espresso::Instruction>(lclCia);
+         auto data = espresso::decodeInstructionFlat(instr);
+
+         if (!data) {
+            a.ud2();
+         } else if (i + 1 < ranges.size() && lclCia + 4 == ranges[i].second) {
+            // This is a branch the trace continues through
+            a.genCia = lclCia;
+            jit_trace_branch(a, data->id, instr, ranges[i + 1].first);
+         } else {
+            // Don't attempt to verify non-repeatable instructions
+            bool doVerify = (gJitMode == jit_mode::verify
+                             && data->id != espresso::InstructionID::kc
+                             && data->id != espresso::InstructionID::lwarx
+                             && data->id != espresso::InstructionID::stwcx);
+            if (doVerify) {
+               insertVerifyCall(a, instr, sPreInstr);
+            }
+
+            a.genCia = lclCia;
+
+            auto genSuccess = false;
+
+            auto fptr = sInstructionMap[static_cast<size_t>(data->id)];
+            if (fptr) {
+               genSuccess = fptr(a, instr);
+            }
+
+            if (!genSuccess) {
+               a.int3();
+            }
+
+            if (doVerify) {
+               insertVerifyCall(a, instr, sPostInstr);
+            }
          }
-      }
 
-      if (!JIT_REGCACHE) {
-         a.evictAll();
-      }
+         if (!JIT_REGCACHE) {
+            a.evictAll();
+         }
 
-      if (JIT_DEBUG) {
-         a.nop();
+         if (JIT_DEBUG) {
+            a.nop();
+         }
       }
    }
 
    jit_b_direct(a, lclCia);
 
+   block.codeSize = a.getCodeSize();
    auto func = asmjit_cast<JitCode>(a.make());
 
    if (func == nullptr) {
@@ -477,6 +902,8 @@ gen(JitBlock &block)
       auto atomicAddr = &mem[aligned_mov_offset + 2];
       decaf_check(align_up(atomicAddr, 8) == atomicAddr);
       *reinterpret_cast<uint64_t*>(atomicAddr) = targetAddr;
+
+      block.exits.emplace_back(reloc.first, reinterpret_cast<JitCode *>(atomicAddr));
    }
 
    // Calculate the starting address of the block
@@ -494,6 +921,16 @@ gen(JitBlock &block)
    return true;
 }
 
+// Marks the page of addr as code before instructions are read from it,
+//  otherwise a write to it while we are generating would not be passed on
+//  to invalidateCache.
+static void
+markCodePage(uint32_t addr)
+{
+   markCodePages(addr, addr + 4);
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
 bool
 identBlock(JitBlock& block)
 {
@@ -502,8 +939,10 @@ identBlock(JitBlock& block)
    auto lclCia = fnStart;
 
    while (lclCia) {
+      markCodePage(lclCia);
+
       auto instr = mem::read<espresso::Instruction>(lclCia);
-      auto data = espresso::decodeInstruction(instr);
+      auto data = espresso::decodeInstructionFlat(instr);
 
       if (!data) {
          // Looks like we found a tail call function??
@@ -544,6 +983,212 @@ identBlock(JitBlock& block)
    return true;
 }
 
+static bool
+isBranchInstruction(espresso::InstructionID id)
+{
+   return id == espresso::InstructionID::b
+       || id == espresso::InstructionID::bc
+       || id == espresso::InstructionID::bcctr
+       || id == espresso::InstructionID::bclr;
+}
+
+bool
+identTrace(JitBlock& block)
+{
+   auto rangeStart = block.start;
+   auto lclCia = block.start;
+   auto numInstrs = 0;
+
+   auto isInTrace = [&](uint32_t addr) {
+      if (addr >= rangeStart && addr <= lclCia) {
+         return true;
+      }
+
+      for (auto &range : block.ranges) {
+         if (addr >= range.first && addr < range.second) {
+            return true;
+         }
+      }
+
+      return false;
+   };
+
+   while (++numInstrs <= JIT_MAX_TRACE_INST) {
+      markCodePage(lclCia);
+
+      auto instr = mem::read<espresso::Instruction>(lclCia);
+      auto data = espresso::decodeInstructionFlat(instr);
+
+      if (!data) {
+         break;
+      }
+
+      if (isBranchInstruction(data->id)) {
+         // We never follow the first instruction so that there is always
+         //  a block at a followed branch which checks for interrupts, and
+         //  loops back into the trace are left to the normal branch code.
+         auto next = uint32_t { 0 };
+
+         if (lclCia == block.start
+          || static_cast<int>(block.ranges.size()) + 1 >= JIT_MAX_TRACE_BRANCHES
+          || !jit_trace_can_follow(data->id, instr, lclCia, next)
+          || isInTrace(next)) {
+            break;
+         }
+
+         block.ranges.emplace_back(rangeStart, lclCia + 4);
+         rangeStart = next;
+         lclCia = next;
+         continue;
+      }
+
+      lclCia += 4;
+   }
+
+   if (numInstrs > JIT_MAX_TRACE_INST) {
+      // We stopped due to the length limit, lclCia was never included
+      lclCia -= 4;
+   }
+
+   block.ranges.emplace_back(rangeStart, lclCia + 4);
+   block.end = lclCia + 4;
+   return true;
+}
+
+// Must be called with sBlockMutex held
+static JitBlockInfo *
+registerBlock(JitBlock &block)
+{
+   auto info = new JitBlockInfo { };
+   info->ranges = block.ranges;
+   info->exits = block.exits;
+   info->profileCounter = block.profileCounter;
+   info->invalidated = block.invalidated;
+
+   if (info->ranges.empty()) {
+      info->ranges.emplace_back(block.start, block.end);
+   }
+
+   sJitBlocks.set(block.start, block.entry);
+   info->entries.emplace_back(block.start, block.entry);
+
+   for (auto i = block.targets.cbegin(); i != block.targets.cend(); ++i) {
+      if (i->second) {
+         sJitBlocks.set(i->first, i->second);
+         info->entries.emplace_back(i->first, i->second);
+      }
+   }
+
+   // Link any exits whose target has already been generated
+   if (!gBranchTraceHandler) {
+      for (auto &exit : info->exits) {
+         auto target = sJitBlocks.find(exit.first);
+
+         if (target) {
+            linkBlock(exit.first, exit.second, target);
+         }
+      }
+   }
+
+   for (auto &range : info->ranges) {
+      sBlockList.emplace(range.first, info);
+      markCodePages(range.first, range.second);
+   }
+
+   auto &codeMap = sCodeMaps[reinterpret_cast<asmjit::Ptr>(block.entry)];
+   codeMap.size = block.codeSize;
+   codeMap.offsets = std::move(block.codeMap);
+   return info;
+}
+
+bool
+findGuestAddress(uint64_t hostAddress,
+                 ppcaddr_t &guestAddress)
+{
+   // Cheap check first as this is called for every fault
+   if (!sRuntime || hostAddress - gCodeBase >= JIT_MAX_CODE_SIZE) {
+      return false;
+   }
+
+   std::unique_lock<std::mutex> lock { sBlockMutex };
+   auto itr = sCodeMaps.upper_bound(hostAddress);
+
+   if (itr == sCodeMaps.begin()) {
+      return false;
+   }
+
+   --itr;
+
+   auto offset = hostAddress - itr->first;
+   auto &codeMap = itr->second;
+
+   if (offset >= codeMap.size) {
+      return false;
+   }
+
+   // Find the last instruction which starts at or before the offset
+   auto instr = std::upper_bound(codeMap.offsets.begin(), codeMap.offsets.end(), offset,
+      [](uint64_t offset, const std::pair<uint32_t, uint32_t> &entry) {
+         return offset < entry.first;
+      });
+
+   if (instr == codeMap.offsets.begin()) {
+      return false;
+   }
+
+   guestAddress = std::prev(instr)->second;
+   return true;
+}
+
+// Must be called with sBlockMutex held, returns true if any invalidation
+//  after generation overlapped the guest code block was translated from.
+static bool
+wasInvalidatedSince(const JitBlock &block,
+                    uint32_t generation)
+{
+   auto current = sInvalidateGeneration.load(std::memory_order_relaxed);
+
+   if (current - generation > InvalidatedRangeHistory) {
+      // Too many to know which ranges they covered
+      return true;
+   }
+
+   auto ranges = block.ranges;
+
+   if (ranges.empty()) {
+      ranges.emplace_back(block.start, block.end);
+   }
+
+   for (auto i = generation; i != current; ) {
+      auto &invalidated = sInvalidatedRanges[++i % InvalidatedRangeHistory];
+
+      for (auto &range : ranges) {
+         if (range.first < invalidated.second && range.second > invalidated.first) {
+            return true;
+         }
+      }
+   }
+
+   return false;
+}
+
+// Must be called with sBlockMutex held
+static JitBlockInfo *
+findProfiledBlock(uint32_t addr)
+{
+   auto itrs = sBlockList.equal_range(addr);
+
+   for (auto itr = itrs.first; itr != itrs.second; ++itr) {
+      auto block = itr->second;
+
+      if (block->profileCounter && block->ranges.front().first == addr) {
+         return block;
+      }
+   }
+
+   return nullptr;
+}
+
 JitCode
 get(uint32_t addr)
 {
@@ -552,25 +1197,98 @@ get(uint32_t addr)
       return foundBlock;
    }
 
-   auto block = JitBlock { addr };
+   auto profileCounter = static_cast<uint32_t *>(nullptr);
+   auto invalidated = static_cast<uint32_t *>(nullptr);
 
-   if (!identBlock(block)) {
-      return nullptr;
+   {
+      std::unique_lock<std::mutex> lock { sBlockMutex };
+      invalidated = allocInvalidatedFlag();
+
+      // Branch tracing needs to see every branch, so never form traces then
+      if (gJitTraceThreshold && !gBranchTraceHandler) {
+         profileCounter = allocProfileCounter();
+      }
    }
 
-   if (!gen(block)) {
-      return nullptr;
+   for (auto attempt = 0; ; ++attempt) {
+      auto block = JitBlock { addr };
+      block.profileCounter = profileCounter;
+      block.invalidated = invalidated;
+
+      // After losing a few races we generate with the lock held, any
+      //  invalidation then has to wait until the block is registered and
+      //  removes it again if it overlapped.
+      auto holdLock = attempt >= MaxUnlockedGenerateAttempts;
+      auto lock = std::unique_lock<std::mutex> { sBlockMutex, std::defer_lock };
+
+      if (holdLock) {
+         lock.lock();
+      }
+
+      auto generation = sInvalidateGeneration.load(std::memory_order_acquire);
+
+      if (!identBlock(block) || !gen(block)) {
+         return nullptr;
+      }
+
+      if (!holdLock) {
+         lock.lock();
+      }
+
+      // Another core may have generated this block while we were busy, in
+      //  which case we just throw away our copy of it.
+      foundBlock = sJitBlocks.find(addr);
+      if (foundBlock) {
+         return foundBlock;
+      }
+
+      // The guest code of this block or a breakpoint in it changed while we
+      //  were generating, which we may have missed, so generate it again.
+      if (holdLock || !wasInvalidatedSince(block, generation)) {
+         registerBlock(block);
+         return block.entry;
+      }
    }
+}
 
-   sJitBlocks.set(addr, block.entry);
+JitCode
+jit_promote(uint32_t addr)
+{
+   auto trace = JitBlock { addr };
 
-   for (auto i = block.targets.cbegin(); i != block.targets.cend(); ++i) {
-      if (i->second) {
-         sJitBlocks.set(i->first, i->second);
+   {
+      std::unique_lock<std::mutex> lock { sBlockMutex };
+      trace.invalidated = allocInvalidatedFlag();
+   }
+
+   auto generation = sInvalidateGeneration.load(std::memory_order_acquire);
+   auto generated = identTrace(trace) && gen(trace);
+
+   std::unique_lock<std::mutex> lock { sBlockMutex };
+   auto block = findProfiledBlock(addr);
+
+   if (!block) {
+      // Another core beat us to it, or the block was invalidated
+      auto current = sJitBlocks.find(addr);
+
+      if (current) {
+         return current;
       }
+
+      lock.unlock();
+      return get(addr);
    }
 
-   return block.entry;
+   if (!generated || wasInvalidatedSince(trace, generation)) {
+      // The trace may have been translated from stale instructions, or
+      //  without a breakpoint, try again after another round of profiling
+      *block->profileCounter = 0;
+      return block->entries.front().second;
+   }
+
+   removeBlock(block);
+   registerBlock(trace);
+   return trace.entry;
 }
 
 JitCode
@@ -590,9 +1308,19 @@ jit_continue(uint32_t nia, JitCode *jumpSource)
    // We do not update the jumpSource if branch tracing is enabled,
    //  this is because it would cause those branches to avoid calling
    //  here ever again...
-   if (jumpSource && !gBranchTraceHandler) {
-      // Aligned writes on x64 are guarenteed to be atomic
-      *jumpSource = jitFn;
+   if (!gBranchTraceHandler) {
+      std::unique_lock<std::mutex> lock { sBlockMutex };
+
+      // Make sure the block was not invalidated before we could link it
+      if (sJitBlocks.find(nia) == jitFn) {
+         if (jumpSource) {
+            linkBlock(nia, jumpSource, jitFn);
+         } else {
+            // Indirect branches have no slot to patch, so we remember
+            //  the target in the inline target cache instead.
+            gIndirectTargetCache[indirectTargetIndex(nia)] = packIndirectTarget(nia, jitFn);
+         }
+      }
    }
 
    return jitFn;
@@ -14,9 +14,17 @@ initialise();
 void
 clearCache();
 
+void
+invalidateCache(ppcaddr_t address,
+                uint32_t size);
+
 void
 resume();
 
+bool
+findGuestAddress(uint64_t hostAddress,
+                 ppcaddr_t &guestAddress);
+
 bool
 hasInstruction(espresso::InstructionID instrId);
 
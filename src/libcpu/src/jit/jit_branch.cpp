@@ -10,6 +10,7 @@ namespace jit
 
 enum BoBits
 {
+   PredictHint = 0,
    CtrValue = 1,
    NoCheckCtr = 2,
    CondValue = 3,
@@ -25,10 +26,9 @@ enum BcFlags
 };
 
 static Core*
-jit_interrupt_stub()
+jit_interrupt_stub(uint32_t *invalidated)
 {
-   this_core::checkInterrupts();
-   return this_core::state();
+   return jit_handle_stop(invalidated, false);
 }
 
 static void
@@ -39,19 +39,113 @@ jit_b_check_interrupt(PPCEmuAssembler& a)
    a.evictAll();
 
    // Jump to interrupt handler if there is an interrupt
+   auto interrupt = a.newLabel();
    auto noInterrupt = a.newLabel();
 
    a.cmp(a.interruptMem, 0);
-   a.je(noInterrupt);
 
+   if (gTimebaseMode == timebase_mode::instructions) {
+      // Or if this core's own timebase has reached its next alarm
+      auto tmp = a.allocGpTmp();
+      a.jne(interrupt);
+      a.mov(tmp, a.retiredMem);
+      a.cmp(tmp, a.alarmRetiredMem);
+      a.jb(noInterrupt);
+   } else {
+      a.je(noInterrupt);
+   }
+
+   a.bind(interrupt);
    a.mov(a.niaMem, a.genCia + 4);
+   a.mov(a.sysArgReg[0], asmjit::Ptr(a.blockInvalidated));
    a.call(asmjit::Ptr(jit_interrupt_stub));
    a.mov(a.stateReg, asmjit::x86::rax);
 
+   // Nothing of the branch has run yet, so it can run again from the start
+   jit_leave_if_stale(a, a.genCia);
+
    a.bind(noInterrupt);
 }
 
 void jit_b_direct(PPCEmuAssembler& a, ppcaddr_t addr);
+void jit_b_reloc(PPCEmuAssembler& a, ppcaddr_t addr);
+
+// Pushes the return address of a call onto the return address stack along
+//  with the landing pad which continues execution there.  This clobbers
+//  rax, r10 and r11 so must only be used once everything is saved.
+static void
+jit_push_return(PPCEmuAssembler& a, asmjit::Label landingPad)
+{
+   auto rasOffset = static_cast<int32_t>(offsetof2(Core, jit_ras));
+
+   a.mov(asmjit::x86::eax, a.rasTopMem);
+   a.add(asmjit::x86::eax, 1);
+   a.and_(asmjit::x86::eax, JitReturnStackSize - 1);
+   a.mov(a.rasTopMem, asmjit::x86::eax);
+
+   a.lea(asmjit::x86::r10, asmjit::x86::ptr(landingPad));
+   a.mov(asmjit::x86::r11, gCodeBase);
+   a.sub(asmjit::x86::r10, asmjit::x86::r11);
+   a.mov(asmjit::x86::r11, static_cast<uint64_t>(a.genCia + 4) << 32);
+   a.or_(asmjit::x86::r10, asmjit::x86::r11);
+   a.mov(asmjit::x86::ptr(a.stateReg, asmjit::x86::rax, 3, rasOffset), asmjit::x86::r10);
+}
+
+// Checks whether packed entry in r10 matches the target in finaleNiaArgReg,
+//  and if so jumps straight to the host code it refers to.
+static void
+jit_jump_if_match(PPCEmuAssembler& a, asmjit::X86Mem hitCounter, asmjit::Label missLbl)
+{
+   a.mov(asmjit::x86::r11, asmjit::x86::r10);
+   a.shr(asmjit::x86::r11, 32);
+   a.cmp(asmjit::x86::r11d, a.finaleNiaArgReg);
+   a.jne(missLbl);
+
+   a.inc(hitCounter);
+   a.mov(asmjit::x86::eax, asmjit::x86::r10d);
+   a.mov(asmjit::x86::r10, gCodeBase);
+   a.add(asmjit::x86::rax, asmjit::x86::r10);
+   a.jmp(asmjit::x86::rax);
+}
+
+// Jumps to the target in finaleNiaArgReg, first trying the return address
+//  stack for returns, then the indirect target cache and finally falling
+//  back to the dispatcher.
+static void
+jit_b_indirect(PPCEmuAssembler& a, bool isReturn)
+{
+   if (isReturn) {
+      auto rasOffset = static_cast<int32_t>(offsetof2(Core, jit_ras));
+      auto rasMissLbl = a.newLabel();
+
+      // Always pop, even on a miss, to keep calls and returns paired up
+      a.mov(asmjit::x86::eax, a.rasTopMem);
+      a.mov(asmjit::x86::r10, asmjit::x86::ptr(a.stateReg, asmjit::x86::rax, 3, rasOffset));
+      a.sub(asmjit::x86::eax, 1);
+      a.and_(asmjit::x86::eax, JitReturnStackSize - 1);
+      a.mov(a.rasTopMem, asmjit::x86::eax);
+
+      jit_jump_if_match(a, a.rasHitsMem, rasMissLbl);
+
+      a.bind(rasMissLbl);
+      a.inc(a.rasMissesMem);
+   }
+
+   auto cacheMissLbl = a.newLabel();
+
+   // The index is scaled by 4 here and by another 2 in the address
+   a.mov(asmjit::x86::r10d, a.finaleNiaArgReg);
+   a.and_(asmjit::x86::r10d, (IndirectTargetCacheSize - 1) << 2);
+   a.mov(asmjit::x86::r11, asmjit::Ptr(&gIndirectTargetCache[0]));
+   a.mov(asmjit::x86::r10, asmjit::x86::ptr(asmjit::x86::r11, asmjit::x86::r10, 1));
+
+   jit_jump_if_match(a, a.targetCacheHitsMem, cacheMissLbl);
+
+   a.bind(cacheMissLbl);
+   a.inc(a.targetCacheMissesMem);
+   a.mov(a.finaleJmpSrcArgReg, 0);
+   a.jmp(asmjit::Ptr(cpu::jit::gFinaleFn));
+}
 
 static bool
 b(PPCEmuAssembler& a, Instruction instr)
@@ -69,18 +163,29 @@ b(PPCEmuAssembler& a, Instruction instr)
       a.mov(a.lrMem, tmp);
    }
 
-   jit_b_direct(a, nia);
+   a.saveAll();
+
+   if (instr.lk) {
+      auto landingPad = a.newLabel();
+      jit_push_return(a, landingPad);
+      jit_b_reloc(a, nia);
+
+      a.bind(landingPad);
+      jit_b_reloc(a, a.genCia + 4);
+   } else {
+      jit_b_reloc(a, nia);
+   }
+
    return true;
 }
 
+// Emits the CTR and CR checks of a bc style branch, jumping to condFailLbl
+//  when the branch is not taken.
 template<unsigned flags>
-static bool
-bcGeneric(PPCEmuAssembler& a, Instruction instr)
+static void
+jit_bc_conditions(PPCEmuAssembler& a, Instruction instr, asmjit::Label condFailLbl)
 {
-   jit_b_check_interrupt(a);
-
    uint32_t bo = instr.bo;
-   auto doCondFailLbl = a.newLabel();
 
    if (flags & BcCheckCtr) {
       if (!get_bit<NoCheckCtr>(bo)) {
@@ -90,9 +195,9 @@ bcGeneric(PPCEmuAssembler& a, Instruction instr)
          a.mov(tmp, a.ctrMem);
          a.cmp(tmp, 0);
          if (get_bit<CtrValue>(bo)) {
-            a.jne(doCondFailLbl);
+            a.jne(condFailLbl);
          } else {
-            a.je(doCondFailLbl);
+            a.je(condFailLbl);
          }
       }
    }
@@ -105,12 +210,23 @@ bcGeneric(PPCEmuAssembler& a, Instruction instr)
          a.cmp(tmp, 0);
 
          if (get_bit<CondValue>(bo)) {
-            a.je(doCondFailLbl);
+            a.je(condFailLbl);
          } else {
-            a.jne(doCondFailLbl);
+            a.jne(condFailLbl);
          }
       }
    }
+}
+
+template<unsigned flags>
+static bool
+bcGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   jit_b_check_interrupt(a);
+
+   auto doCondFailLbl = a.newLabel();
+
+   jit_bc_conditions<flags>(a, instr, doCondFailLbl);
 
    // Make sure no JMP related instructions end up above
    //   this if-block as we use a JMP instruction with
@@ -128,15 +244,22 @@ bcGeneric(PPCEmuAssembler& a, Instruction instr)
 
       // This is here because we need to record LR before we update
       //  LR in the case of a bclrl instruction...
+      auto landingPad = a.newLabel();
+
       if (instr.lk) {
          auto tmp = a.finaleJmpSrcArgReg.r32();
          a.mov(tmp, a.genCia + 4);
          a.mov(a.lrMem, tmp);
+         jit_push_return(a, landingPad);
       }
 
       a.and_(a.finaleNiaArgReg, ~0x3);
-      a.mov(a.finaleJmpSrcArgReg, 0);
-      a.jmp(asmjit::Ptr(cpu::jit::gFinaleFn));
+      jit_b_indirect(a, (flags & BcBranchLR) && !instr.lk);
+
+      if (instr.lk) {
+         a.bind(landingPad);
+         jit_b_reloc(a, a.genCia + 4);
+      }
    } else {
       if (instr.lk) {
          auto tmp = a.allocGpTmp().r32();
@@ -145,7 +268,18 @@ bcGeneric(PPCEmuAssembler& a, Instruction instr)
       }
 
       uint32_t nia = a.genCia + sign_extend<16>(instr.bd << 2);
-      jit_b_direct(a, nia);
+      a.saveAll();
+
+      if (instr.lk) {
+         auto landingPad = a.newLabel();
+         jit_push_return(a, landingPad);
+         jit_b_reloc(a, nia);
+
+         a.bind(landingPad);
+         jit_b_reloc(a, a.genCia + 4);
+      } else {
+         jit_b_reloc(a, nia);
+      }
    }
 
    a.bind(doCondFailLbl);
@@ -171,6 +305,85 @@ bclr(PPCEmuAssembler& a, Instruction instr)
    return bcGeneric<BcBranchLR | BcCheckCtr | BcCheckCond>(a, instr);
 }
 
+// Decides whether a trace should continue through this branch rather than
+//  ending at it, and if so which way.  Calls and indirect branches always
+//  end the trace.  Conditional branches follow the static prediction, where
+//  backwards branches are taken unless the hint bit says otherwise.
+bool
+jit_trace_can_follow(espresso::InstructionID id, Instruction instr, uint32_t cia, uint32_t &next)
+{
+   if (instr.lk) {
+      return false;
+   }
+
+   if (id == espresso::InstructionID::b) {
+      next = sign_extend<26>(instr.li << 2);
+
+      if (!instr.aa) {
+         next += cia;
+      }
+
+      return true;
+   }
+
+   if (id == espresso::InstructionID::bc) {
+      uint32_t bo = instr.bo;
+      auto offset = sign_extend<16>(instr.bd << 2);
+      auto target = instr.aa ? offset : cia + offset;
+      auto likelyTaken = (get_bit<NoCheckCtr>(bo) && get_bit<NoCheckCond>(bo))
+                      || ((static_cast<int32_t>(offset) < 0) != get_bit<PredictHint>(bo));
+
+      next = likelyTaken ? target : cia + 4;
+      return true;
+   }
+
+   return false;
+}
+
+// Emits a branch inside a trace which continues at next, leaving the trace
+//  through a side exit when it goes the other way.  Unlike the normal branch
+//  handlers this keeps the register cache intact on the path through.
+void
+jit_trace_branch(PPCEmuAssembler& a, espresso::InstructionID id, Instruction instr, uint32_t next)
+{
+   // Pending interrupts are handled by leaving the trace at the branch
+   //  itself, traces never follow their first instruction so the block
+   //  generated there will do the interrupt check.
+   auto noInterrupt = a.newLabel();
+
+   a.cmp(a.interruptMem, 0);
+   a.je(noInterrupt);
+   a.saveAll();
+   jit_b_reloc(a, a.genCia);
+   a.bind(noInterrupt);
+
+   if (id == espresso::InstructionID::b) {
+      return;
+   }
+
+   auto offset = sign_extend<16>(instr.bd << 2);
+   auto target = instr.aa ? offset : a.genCia + offset;
+   auto condFailLbl = a.newLabel();
+   auto continueLbl = a.newLabel();
+
+   jit_bc_conditions<BcCheckCtr | BcCheckCond>(a, instr, condFailLbl);
+
+   if (next == target) {
+      a.jmp(continueLbl);
+
+      a.bind(condFailLbl);
+      a.saveAll();
+      jit_b_reloc(a, a.genCia + 4);
+   } else {
+      a.saveAll();
+      jit_b_reloc(a, target);
+
+      a.bind(condFailLbl);
+   }
+
+   a.bind(continueLbl);
+}
+
 void registerBranchInstructions()
 {
    RegisterInstruction(b);
@@ -181,4 +394,19 @@ void registerBranchInstructions()
 
 } // namespace jit
 
+JitBranchStats
+getJitBranchStats()
+{
+   auto stats = JitBranchStats { };
+
+   for (auto &core : gCore) {
+      stats.returnStackHits += core.jit_branch_stats.returnStackHits;
+      stats.returnStackMisses += core.jit_branch_stats.returnStackMisses;
+      stats.targetCacheHits += core.jit_branch_stats.targetCacheHits;
+      stats.targetCacheMisses += core.jit_branch_stats.targetCacheMisses;
+   }
+
+   return stats;
+}
+
 } // namespace cpu
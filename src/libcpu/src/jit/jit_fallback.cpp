@@ -19,7 +19,7 @@ static uint64_t sFallbackCalls[static_cast<size_t>(espresso::InstructionID::Inst
 
 bool jit_fallback(PPCEmuAssembler& a, espresso::Instruction instr)
 {
-   auto data = espresso::decodeInstruction(instr);
+   auto data = espresso::decodeInstructionFlat(instr);
    decaf_assert(data, fmt::format("Failed to decode instruction {:08X}", instr.value));
 
    auto fptr = cpu::interpreter::getInstructionHandler(data->id);
@@ -33,6 +33,10 @@ bool jit_fallback(PPCEmuAssembler& a, espresso::Instruction instr)
       a.lock().inc(asmjit::X86Mem(asmjit::x86::rax, 0));
    }
 
+   // A fault inside the interpreter cannot be traced back through the
+   //  code map, so make sure nia is correct for it.
+   a.mov(a.niaMem, a.genCia + 4);
+
    a.mov(a.sysArgReg[0], a.stateReg);
    a.mov(a.sysArgReg[1], (uint32_t)instr);
    a.call(asmjit::Ptr(fptr));
@@ -11,7 +11,7 @@ namespace cpu
 namespace jit
 {
 
-static bool
+bool
 hostHasFMA3()
 {
    static bool checked = false;
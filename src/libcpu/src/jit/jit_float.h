@@ -7,6 +7,9 @@ namespace cpu
 namespace jit
 {
 
+bool
+hostHasFMA3();
+
 void
 roundToSingleSd(PPCEmuAssembler& a,
                 const PPCEmuAssembler::XmmRegister& dst,
@@ -26,6 +26,9 @@ void registerSystemInstructions();
 
 bool jit_fallback(PPCEmuAssembler& a, Instruction instr);
 
+bool jit_trace_can_follow(espresso::InstructionID id, Instruction instr, uint32_t cia, uint32_t &next);
+void jit_trace_branch(PPCEmuAssembler& a, espresso::InstructionID id, Instruction instr, uint32_t next);
+
 } // namespace jit
 
 } // namespace cpu
@@ -115,6 +115,14 @@ public:
       PPCMemRef(niaMem, nia);
       PPCMemRef(coreIdMem, id);
       PPCMemRef(interruptMem, interrupt);
+      PPCMemRef(retiredMem, retired_instructions);
+      PPCMemRef(alarmRetiredMem, alarm_retired);
+      PPCMemRef(rasTopMem, jit_ras_top);
+      PPCMemRef(blockStaleMem, jit_block_stale);
+      PPCMemRef(rasHitsMem, jit_branch_stats.returnStackHits);
+      PPCMemRef(rasMissesMem, jit_branch_stats.returnStackMisses);
+      PPCMemRef(targetCacheHitsMem, jit_branch_stats.targetCacheHits);
+      PPCMemRef(targetCacheMissesMem, jit_branch_stats.targetCacheMisses);
 
 #undef PPCMemRef
 
@@ -183,6 +191,7 @@ public:
    }
 
    uint32_t genCia;
+   uint32_t *blockInvalidated;
    std::vector<std::pair<uint32_t, asmjit::Label>> relocLabels;
 
    asmjit::X86GpReg sysArgReg[4];
@@ -199,6 +208,14 @@ public:
    asmjit::X86Mem niaMem;
    asmjit::X86Mem coreIdMem;
    asmjit::X86Mem interruptMem;
+   asmjit::X86Mem retiredMem;
+   asmjit::X86Mem alarmRetiredMem;
+   asmjit::X86Mem rasTopMem;
+   asmjit::X86Mem blockStaleMem;
+   asmjit::X86Mem rasHitsMem;
+   asmjit::X86Mem rasMissesMem;
+   asmjit::X86Mem targetCacheHitsMem;
+   asmjit::X86Mem targetCacheMissesMem;
 
    PpcGpRef gpr[32];
    PpcXmmRef fprps[32];
@@ -720,6 +737,34 @@ using JumpLabelMap = std::map<uint32_t, asmjit::Label>;
 extern JitCall gCallFn;
 extern JitFinale gFinaleFn;
 
+Core *
+jit_handle_stop(uint32_t *invalidated,
+                bool checkBreakpoint);
+
+void
+jit_leave_if_stale(PPCEmuAssembler& a, ppcaddr_t nia);
+
+// The indirect branch target cache maps guest addresses to host code, each
+//  entry is packed the same way as the return address stack entries.
+static const uint32_t IndirectTargetCacheSize = 4096;
+static const uint64_t IndirectTargetEmpty = 0xFFFFFFFF00000000ull;
+
+extern uint64_t gIndirectTargetCache[IndirectTargetCacheSize];
+extern asmjit::Ptr gCodeBase;
+
+static inline uint64_t
+packIndirectTarget(uint32_t guest, JitCode host)
+{
+   auto offset = static_cast<uint32_t>(reinterpret_cast<asmjit::Ptr>(host) - gCodeBase);
+   return (static_cast<uint64_t>(guest) << 32) | offset;
+}
+
+static inline uint32_t
+indirectTargetIndex(uint32_t guest)
+{
+   return (guest >> 2) & (IndirectTargetCacheSize - 1);
+}
+
 struct JitBlock
 {
    JitBlock(uint32_t _start) {
@@ -733,6 +778,23 @@ struct JitBlock
 
    JitCode entry;
    std::vector<std::pair<uint32_t, JitCode>> targets;
+   std::vector<std::pair<uint32_t, JitCode *>> exits;
+
+   // For traces, the guest address ranges making up the trace in execution
+   //  order.  Each range but the last ends with a branch which is followed
+   //  into the next range.  Empty for a normal block.
+   std::vector<std::pair<uint32_t, uint32_t>> ranges;
+
+   // Execution counter used to decide when to promote to a trace
+   uint32_t *profileCounter = nullptr;
+
+   // Set when an invalidation removes this block, so a core stopped inside
+   //  it knows the rest of it may be stale
+   uint32_t *invalidated = nullptr;
+
+   // Offset from entry of the host code for each guest instruction
+   std::vector<std::pair<uint32_t, uint32_t>> codeMap;
+   size_t codeSize = 0;
 };
 
 } // namespace jit
@@ -1,7 +1,10 @@
 #include "jit_insreg.h"
+#include "../cpu_internal.h"
+#include <common/bit_cast.h>
 #include <common/bitutils.h>
 #include <common/decaf_assert.h>
 #include <algorithm>
+#include <limits>
 
 using espresso::XERegisterBits;
 using espresso::ConditionRegisterFlag;
@@ -674,6 +677,104 @@ stswx(PPCEmuAssembler& a, Instruction instr)
    return stswGeneric<StswIndexed>(a, instr);
 }
 
+// Paired Single quantization helpers
+using espresso::QuantizedDataType;
+
+static const uint32_t GqrLoadMask = 0x3F070000;
+static const uint32_t GqrStoreMask = 0x00003F07;
+
+static bool
+isValidQuantizedType(QuantizedDataType type)
+{
+   return type == QuantizedDataType::Floating
+       || type == QuantizedDataType::Unsigned8
+       || type == QuantizedDataType::Unsigned16
+       || type == QuantizedDataType::Signed8
+       || type == QuantizedDataType::Signed16;
+}
+
+static uint32_t
+getQuantizedTypeSize(QuantizedDataType type)
+{
+   if (type == QuantizedDataType::Unsigned8 || type == QuantizedDataType::Signed8) {
+      return 1;
+   } else if (type == QuantizedDataType::Unsigned16 || type == QuantizedDataType::Signed16) {
+      return 2;
+   } else {
+      return 4;
+   }
+}
+
+// Returns the bits of the double 2^exp, exp is a sign extended gqr scale
+static uint64_t
+getScaleConstant(int exp)
+{
+   return static_cast<uint64_t>(1023 + exp) << 52;
+}
+
+// Loads a 64-bit constant into both lanes of reg
+static void
+loadConstantPd(PPCEmuAssembler& a,
+               const PPCEmuAssembler::XmmRegister& reg,
+               uint64_t value)
+{
+   auto tmp = a.allocGpTmp().r64();
+   a.mov(tmp, value);
+   a.movq(reg, tmp);
+   a.movddup(reg, reg);
+}
+
+// Emits truncate_double_bits on the double in bits, which is how the
+//  interpreter stores a double as a single, leaving the result in the low
+//  half of bits.
+static void
+truncateDoubleBits(PPCEmuAssembler& a,
+                   const asmjit::X86GpReg& bits)
+{
+   auto low = a.allocGpTmp().r64();
+   a.mov(low, bits);
+   a.shr(low, 29);
+   a.and_(low.r32(), 0x3FFFFFFF);
+   a.shr(bits, 32);
+   a.and_(bits.r32(), 0xC0000000);
+   a.or_(bits.r32(), low.r32());
+}
+
+// The quantized load and store instructions are specialised for the gqr
+//  value of the translating core.  A guard compares the relevant half of the
+//  gqr at runtime and calls the interpreter instead if it has changed.  The
+//  register cache is flushed on both sides so the two paths join with the
+//  same state.
+static void
+beginGqrGuard(PPCEmuAssembler& a,
+              uint32_t i,
+              uint32_t mask,
+              uint32_t value,
+              const asmjit::Label& slowLbl)
+{
+   a.evictAll();
+
+   auto tmp = a.allocGpTmp().r32();
+   a.mov(tmp, asmjit::X86Mem(a.stateReg, a.gqr[i].offset, 4));
+   a.and_(tmp, mask);
+   a.cmp(tmp, value);
+   a.jne(slowLbl);
+}
+
+static void
+endGqrGuard(PPCEmuAssembler& a,
+            Instruction instr,
+            const asmjit::Label& slowLbl)
+{
+   auto doneLbl = a.newLabel();
+   a.evictAll();
+   a.jmp(doneLbl);
+
+   a.bind(slowLbl);
+   jit_fallback(a, instr);
+   a.bind(doneLbl);
+}
+
 // Paired Single Load
 enum PsqLoadFlags
 {
@@ -686,7 +787,146 @@ template<unsigned flags = 0>
 static bool
 psqLoad(PPCEmuAssembler& a, Instruction instr)
 {
-   return jit_fallback(a, instr);
+   uint32_t i, w;
+
+   if (flags & PsqLoadIndexed) {
+      i = instr.qi;
+      w = instr.qw;
+   } else {
+      i = instr.i;
+      w = instr.w;
+   }
+
+   auto gqr = this_core::state()->gqr[i];
+   auto type = static_cast<QuantizedDataType>(gqr.ld_type);
+
+   if (!isValidQuantizedType(type)) {
+      return jit_fallback(a, instr);
+   }
+
+   int exp = static_cast<int>(gqr.ld_scale);
+   exp -= (exp & 32) << 1;  // Sign extend.
+
+   auto size = getQuantizedTypeSize(type);
+   auto isSigned = (type == QuantizedDataType::Signed8 || type == QuantizedDataType::Signed16);
+
+   auto slowLbl = a.newLabel();
+   beginGqrGuard(a, i, GqrLoadMask, gqr.value & GqrLoadMask, slowLbl);
+
+   auto src = a.allocGpTmp().r32();
+
+   if ((flags & PsqLoadZeroRA) && instr.rA == 0) {
+      a.mov(src, 0);
+   } else {
+      a.mov(src, a.loadRegisterRead(a.gpr[instr.rA]));
+   }
+
+   if (flags & PsqLoadIndexed) {
+      a.add(src, a.loadRegisterRead(a.gpr[instr.rB]));
+   } else {
+      auto x = sign_extend<12, int32_t>(instr.qd);
+      if (x != 0) {
+         a.add(src, x);
+      }
+   }
+
+   auto result = a.allocXmmTmp();
+
+   {
+      auto hostSrc = a.allocGpTmp().r64();
+      a.mov(hostSrc, src);
+      a.add(hostSrc, a.membaseReg);
+
+      auto data = a.allocGpTmp().r64();
+
+      if (type == QuantizedDataType::Floating) {
+         if (w == 0) {
+            // Swap the two words back after the byte swap so ps0 is in the low half
+            a.mov(data, asmjit::X86Mem(hostSrc, 0));
+            a.bswap(data);
+            a.rol(data, 32);
+         } else {
+            a.mov(data.r32(), asmjit::X86Mem(hostSrc, 0));
+            a.bswap(data.r32());
+         }
+
+         a.movq(result, data);
+         a.cvtps2pd(result, result);
+
+         // The conversion quietens signalling NaNs, which the interpreter
+         //  keeps as they are.  Offset the magnitude of each single so only
+         //  signalling NaNs are below 0x803FFFFF as a signed integer, then
+         //  clear the quiet bit the conversion set for them.
+         auto snan = a.allocXmmTmp();
+         auto constant = a.allocXmmTmp();
+         a.movq(snan, data);
+         loadConstantPd(a, constant, UINT64_C(0x7FFFFFFF7FFFFFFF));
+         a.pand(snan, constant);
+         loadConstantPd(a, constant, UINT64_C(0x007FFFFF007FFFFF));
+         a.paddd(snan, constant);
+         loadConstantPd(a, constant, UINT64_C(0x803FFFFF803FFFFF));
+         a.pcmpgtd(constant, snan);
+         a.punpckldq(constant, constant);
+         loadConstantPd(a, snan, UINT64_C(0x0008000000000000));
+         a.pand(snan, constant);
+         a.xorpd(result, snan);
+      } else {
+         // Build two 32-bit integers and convert them both at once
+         auto hi = a.allocGpTmp().r64();
+
+         for (auto j = 0; j < 2 - static_cast<int>(w); ++j) {
+            auto dst = (j == 0) ? data : hi;
+
+            if (size == 1) {
+               if (isSigned) {
+                  a.movsx(dst.r32(), asmjit::X86Mem(hostSrc, j, 1));
+               } else {
+                  a.movzx(dst.r32(), asmjit::X86Mem(hostSrc, j, 1));
+               }
+            } else {
+               a.movzx(dst.r32(), asmjit::X86Mem(hostSrc, j * 2, 2));
+               a.rol(dst.r16(), 8);
+
+               if (isSigned) {
+                  a.movsx(dst.r32(), dst.r16());
+               }
+            }
+         }
+
+         if (w == 0) {
+            a.shl(hi, 32);
+            a.or_(data, hi);
+         }
+
+         a.movq(result, data);
+         a.cvtdq2pd(result, result);
+
+         if (exp != 0) {
+            auto scale = a.allocXmmTmp();
+            loadConstantPd(a, scale, getScaleConstant(-exp));
+            a.mulpd(result, scale);
+         }
+      }
+
+      if (w != 0) {
+         // ps1 is always 1.0 for a single load
+         auto one = a.allocXmmTmp();
+         a.mov(data, UINT64_C(0x3FF0000000000000));
+         a.movq(one, data);
+         a.unpcklpd(result, one);
+      }
+   }
+
+   auto dst = a.loadRegisterWrite(a.fprps[instr.frD]);
+   a.movapd(dst, result);
+
+   if (flags & PsqLoadUpdate) {
+      auto addrDst = a.loadRegisterWrite(a.gpr[instr.rA]);
+      a.mov(addrDst, src);
+   }
+
+   endGqrGuard(a, instr, slowLbl);
+   return true;
 }
 
 static bool
@@ -725,7 +965,164 @@ template<unsigned flags = 0>
 static bool
 psqStore(PPCEmuAssembler& a, Instruction instr)
 {
-   return jit_fallback(a, instr);
+   uint32_t i, w;
+
+   if (flags & PsqStoreIndexed) {
+      i = instr.qi;
+      w = instr.qw;
+   } else {
+      i = instr.i;
+      w = instr.w;
+   }
+
+   auto gqr = this_core::state()->gqr[i];
+   auto type = static_cast<QuantizedDataType>(gqr.st_type);
+
+   if (!isValidQuantizedType(type)) {
+      return jit_fallback(a, instr);
+   }
+
+   int exp = static_cast<int>(gqr.st_scale);
+   exp -= (exp & 32) << 1;  // Sign extend.
+
+   auto size = getQuantizedTypeSize(type);
+
+   auto slowLbl = a.newLabel();
+   beginGqrGuard(a, i, GqrStoreMask, gqr.value & GqrStoreMask, slowLbl);
+
+   auto dst = a.allocGpTmp().r32();
+
+   if ((flags & PsqStoreZeroRA) && instr.rA == 0) {
+      a.mov(dst, 0);
+   } else {
+      a.mov(dst, a.loadRegisterRead(a.gpr[instr.rA]));
+   }
+
+   if (flags & PsqStoreIndexed) {
+      a.add(dst, a.loadRegisterRead(a.gpr[instr.rB]));
+   } else {
+      auto x = sign_extend<12, int32_t>(instr.qd);
+      if (x != 0) {
+         a.add(dst, x);
+      }
+   }
+
+   auto data = a.allocGpTmp().r64();
+
+   {
+      auto value = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frS]));
+      auto mask = a.allocXmmTmp();
+      auto constant = a.allocXmmTmp();
+
+      if (type == QuantizedDataType::Floating) {
+         // Values too small for a normal single are written as a signed zero
+         a.movapd(mask, value);
+         loadConstantPd(a, constant, UINT64_C(0x7FFFFFFFFFFFFFFF));
+         a.andpd(mask, constant);
+         loadConstantPd(a, constant, getScaleConstant(-126));
+         a.cmppd(mask, constant, 1);  // LT_OS
+         loadConstantPd(a, constant, UINT64_C(0x7FFFFFFFFFFFFFFF));
+         a.andpd(mask, constant);
+         a.andnpd(mask, value);
+
+         // Everything else is truncated the same way as the interpreter's
+         //  storeDoubleAsFloat, cvtpd2ps would round it instead.
+         a.movq(data, mask);
+         truncateDoubleBits(a, data);
+
+         if (w == 0) {
+            auto hi = a.allocGpTmp().r64();
+            a.unpckhpd(mask, mask);
+            a.movq(hi, mask);
+            truncateDoubleBits(a, hi);
+            a.shl(hi, 32);
+            a.or_(data, hi);
+
+            a.rol(data, 32);
+            a.bswap(data);
+         } else {
+            a.bswap(data.r32());
+         }
+      } else {
+         if (exp != 0) {
+            loadConstantPd(a, constant, getScaleConstant(exp));
+            a.mulpd(value, constant);
+         }
+
+         // NaN saturates towards its sign, replace it with an infinity
+         a.movapd(mask, value);
+         a.cmppd(mask, mask, 3);  // UNORD_Q
+         loadConstantPd(a, constant, UINT64_C(0xFFF0000000000000));
+         a.andpd(constant, value);
+         a.andpd(constant, mask);
+         a.andnpd(mask, value);
+         a.orpd(mask, constant);
+
+         double min, max;
+
+         switch (type) {
+         case QuantizedDataType::Unsigned8:
+            min = std::numeric_limits<uint8_t>::min();
+            max = std::numeric_limits<uint8_t>::max();
+            break;
+         case QuantizedDataType::Unsigned16:
+            min = std::numeric_limits<uint16_t>::min();
+            max = std::numeric_limits<uint16_t>::max();
+            break;
+         case QuantizedDataType::Signed8:
+            min = std::numeric_limits<int8_t>::min();
+            max = std::numeric_limits<int8_t>::max();
+            break;
+         default:
+            min = std::numeric_limits<int16_t>::min();
+            max = std::numeric_limits<int16_t>::max();
+            break;
+         }
+
+         loadConstantPd(a, constant, bit_cast<uint64_t>(min));
+         a.maxpd(mask, constant);
+         loadConstantPd(a, constant, bit_cast<uint64_t>(max));
+         a.minpd(mask, constant);
+
+         a.cvttpd2dq(value, mask);
+         a.movq(data, value);
+      }
+   }
+
+   {
+      auto hostDst = a.allocGpTmp().r64();
+      a.mov(hostDst, dst);
+      a.add(hostDst, a.membaseReg);
+
+      if (type == QuantizedDataType::Floating) {
+         if (w == 0) {
+            a.mov(asmjit::X86Mem(hostDst, 0), data);
+         } else {
+            a.mov(asmjit::X86Mem(hostDst, 0), data.r32());
+         }
+      } else {
+         for (auto j = 0; j < 2 - static_cast<int>(w); ++j) {
+            if (j != 0) {
+               a.shr(data, 32);
+            }
+
+            if (size == 1) {
+               a.mov(asmjit::X86Mem(hostDst, j), data.r8());
+            } else {
+               a.rol(data.r16(), 8);
+               a.mov(asmjit::X86Mem(hostDst, j * 2), data.r16());
+            }
+         }
+      }
+   }
+
+   if (flags & PsqStoreUpdate) {
+      auto addrDst = a.loadRegisterWrite(a.gpr[instr.rA]);
+      a.mov(addrDst, dst);
+   }
+
+   endGqrGuard(a, instr, slowLbl);
+   return true;
 }
 
 static bool
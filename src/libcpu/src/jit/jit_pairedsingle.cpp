@@ -8,6 +8,394 @@ namespace cpu
 namespace jit
 {
 
+// cmppd predicates
+constexpr auto CMP_UNORD = 3;
+constexpr auto CMP_NLE_US = 6;
+constexpr auto CMP_ORD = 7;
+
+// Rounds both lanes to single precision
+static void
+roundToSinglePd(PPCEmuAssembler& a,
+                const PPCEmuAssembler::XmmRegister& reg)
+{
+   a.cvtpd2ps(reg, reg);
+   a.cvtps2pd(reg, reg);
+}
+
+// Rounds the multiplier to 24 bits of mantissa the same way as
+//  roundTo24BitSd in jit_float.cpp.  Only lane 0 is rounded unless
+//  bothLanes is set, as the interpreter only rounds a multiplier taken
+//  from ps0.
+static void
+roundTo24BitPd(PPCEmuAssembler& a,
+               const PPCEmuAssembler::XmmRegister& reg,
+               bool bothLanes)
+{
+   auto maskGp = a.allocGpTmp();
+   auto maskXmm = a.allocXmmTmp();
+   auto tmp = a.allocXmmTmp();
+
+   // Clear the bits below the rounding bit...
+   a.mov(maskGp, UINT64_C(0x7FFFFFF));
+   a.movq(maskXmm, maskGp);
+   if (bothLanes) {
+      a.punpcklqdq(maskXmm, maskXmm);
+   }
+   a.movapd(tmp, reg);
+   a.pand(tmp, maskXmm);
+   a.psubq(reg, tmp);
+
+   // ...then add the rounding bit back in to round up, except for NaNs which
+   //  the interpreter returns unrounded, so it must not carry into them
+   a.mov(maskGp, UINT64_C(0x8000000));
+   a.movq(maskXmm, maskGp);
+   if (bothLanes) {
+      a.punpcklqdq(maskXmm, maskXmm);
+   }
+   a.movapd(tmp, reg);
+   a.cmppd(tmp, tmp, CMP_ORD);
+   a.pand(maskXmm, tmp);
+   a.movapd(tmp, reg);
+   a.pand(tmp, maskXmm);
+   a.paddq(reg, tmp);
+}
+
+// Invalid operations produce a negative default NaN on x86 but a positive
+//  one on the PowerPC, so clear the sign of any NaN in the result which
+//  did not come from one of the sources.  inputNaN must hold an all ones
+//  mask in each lane where one of the sources was a NaN, and is clobbered.
+static void
+fixDefaultNaNPd(PPCEmuAssembler& a,
+                const PPCEmuAssembler::XmmRegister& result,
+                const PPCEmuAssembler::XmmRegister& inputNaN)
+{
+   auto mask = a.allocXmmTmp();
+   a.movapd(mask, result);
+   a.cmppd(mask, mask, CMP_UNORD);
+   a.andnpd(inputNaN, mask);
+
+   // Turn the all ones lanes into just the sign bit and clear it
+   a.psllq(inputNaN, 63);
+   a.andnpd(inputNaN, result);
+   a.movapd(result, inputNaN);
+}
+
+// Paired-single arithmetic
+enum PSArithOperator
+{
+   PSAdd,
+   PSSub,
+   PSMul,
+   PSDiv,
+};
+
+enum PSSlotFlags
+{
+   PSSlotsNormal,     // ps0 with ps0, ps1 with ps1
+   PSSlotsBroadcast0, // both lanes use ps0 of the second operand
+   PSSlotsBroadcast1, // both lanes use ps1 of the second operand
+};
+
+// Loads the second operand of an arithmetic instruction into tmp,
+//  broadcasting one of its lanes if needed.
+static void
+loadSecondOperand(PPCEmuAssembler& a,
+                  const PPCEmuAssembler::XmmRegister& tmp,
+                  const PPCEmuAssembler::XmmRegister& src,
+                  PSSlotFlags slots)
+{
+   if (slots == PSSlotsBroadcast0) {
+      a.movddup(tmp, src);
+   } else {
+      a.movapd(tmp, src);
+
+      if (slots == PSSlotsBroadcast1) {
+         a.unpckhpd(tmp, tmp);
+      }
+   }
+}
+
+template<PSArithOperator op, PSSlotFlags slots>
+static bool
+psArithGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   // FPSCR, FPRF supposed to be updated here...
+
+   auto frB = (op == PSMul) ? instr.frC : instr.frB;
+   auto result = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frA]));
+   auto inputNaN = a.allocXmmTmp(result);
+   {
+      auto tmpSrcB = a.allocXmmTmp();
+      loadSecondOperand(a, tmpSrcB, a.loadRegisterRead(a.fprps[frB]), slots);
+      a.cmppd(inputNaN, tmpSrcB, CMP_UNORD);
+
+      switch (op) {
+      case PSAdd:
+         a.addpd(result, tmpSrcB);
+         break;
+      case PSSub:
+         a.subpd(result, tmpSrcB);
+         break;
+      case PSMul:
+         // Same as fmuls, a multiplier from ps0 is rounded to 24 bits first
+         if (slots != PSSlotsBroadcast1) {
+            roundTo24BitPd(a, tmpSrcB, slots == PSSlotsBroadcast0);
+         }
+
+         a.mulpd(result, tmpSrcB);
+         break;
+      case PSDiv:
+         a.divpd(result, tmpSrcB);
+         break;
+      }
+   }
+
+   roundToSinglePd(a, result);
+   fixDefaultNaNPd(a, result, inputNaN);
+
+   auto dst = a.loadRegisterWrite(a.fprps[instr.frD]);
+   a.movapd(dst, result);
+   return true;
+}
+
+static bool
+ps_add(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PSAdd, PSSlotsNormal>(a, instr);
+}
+
+static bool
+ps_sub(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PSSub, PSSlotsNormal>(a, instr);
+}
+
+static bool
+ps_mul(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PSMul, PSSlotsNormal>(a, instr);
+}
+
+static bool
+ps_muls0(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PSMul, PSSlotsBroadcast0>(a, instr);
+}
+
+static bool
+ps_muls1(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PSMul, PSSlotsBroadcast1>(a, instr);
+}
+
+static bool
+ps_div(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PSDiv, PSSlotsNormal>(a, instr);
+}
+
+// Sum, adds ps0 of frA to ps1 of frB and places the result in slot of frD,
+//  with the other slot coming from frC
+template<int slot>
+static bool
+psSumGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   // FPSCR, FPRF supposed to be updated here...
+
+   auto sum = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frA]));
+   {
+      auto inputNaN = a.allocXmmTmp(sum);
+      auto tmpSrcB = a.allocXmmTmp();
+      loadSecondOperand(a, tmpSrcB, a.loadRegisterRead(a.fprps[instr.frB]), PSSlotsBroadcast1);
+      a.cmppd(inputNaN, tmpSrcB, CMP_UNORD);
+      a.addsd(sum, tmpSrcB);
+      roundToSingleSd(a, sum, sum);
+      fixDefaultNaNPd(a, sum, inputNaN);
+   }
+
+   auto result = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frC]));
+
+   if (slot == 0) {
+      // ps1 of frC is copied across untouched
+      a.movsd(result, sum);
+   } else {
+      roundToSingleSd(a, result, result);
+      a.unpcklpd(result, sum);
+   }
+
+   auto dst = a.loadRegisterWrite(a.fprps[instr.frD]);
+   a.movapd(dst, result);
+   return true;
+}
+
+static bool
+ps_sum0(PPCEmuAssembler& a, Instruction instr)
+{
+   return psSumGeneric<0>(a, instr);
+}
+
+static bool
+ps_sum1(PPCEmuAssembler& a, Instruction instr)
+{
+   return psSumGeneric<1>(a, instr);
+}
+
+// Fused multiply-add instructions
+enum FMAFlags
+{
+   FMASubtract = 1 << 0, // Subtract instead of add
+   FMANegate = 1 << 1,   // Negate result
+};
+
+template<unsigned flags, PSSlotFlags slots>
+static bool
+fmaGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   // FPSCR, FPRF supposed to be updated here...
+
+   auto result = a.allocXmmTmp();
+   {
+      // Do the rounding first so we don't run out of host registers
+      auto tmpSrcC = a.allocXmmTmp();
+      loadSecondOperand(a, tmpSrcC, a.loadRegisterRead(a.fprps[instr.frC]), slots);
+
+      if (slots != PSSlotsBroadcast1) {
+         roundTo24BitPd(a, tmpSrcC, slots == PSSlotsBroadcast0);
+      }
+
+      auto srcA = a.loadRegisterRead(a.fprps[instr.frA]);
+      auto srcB = a.loadRegisterRead(a.fprps[instr.frB]);
+
+      a.movapd(result, srcA);
+      if (hostHasFMA3()) {
+         if (flags & FMASubtract) {
+            a.vfmsub132pd(result, srcB, tmpSrcC);
+         } else {
+            a.vfmadd132pd(result, srcB, tmpSrcC);
+         }
+      } else {  // no FMA3
+         a.mulpd(result, tmpSrcC);
+         if (flags & FMASubtract) {
+            a.subpd(result, srcB);
+         } else {
+            a.addpd(result, srcB);
+         }
+
+         // A NaN in frC has been carried through the product ahead of one
+         //  in frB, but frA and frB come first like the FMA3 path, so take
+         //  the NaN from those in lanes where either of them is one.
+         auto mask = a.allocXmmTmp(srcA);
+         a.cmppd(mask, srcB, CMP_UNORD);
+
+         auto nan = a.allocXmmTmp(srcA);
+         a.addpd(nan, srcB);
+         a.andpd(nan, mask);
+         a.andnpd(mask, result);
+         a.orpd(mask, nan);
+         a.movapd(result, mask);
+      }
+   }
+
+   roundToSinglePd(a, result);
+
+   {
+      auto inputNaN = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frA]));
+      a.cmppd(inputNaN, a.loadRegisterRead(a.fprps[instr.frB]), CMP_UNORD);
+
+      auto tmpSrcC = a.allocXmmTmp();
+      loadSecondOperand(a, tmpSrcC, a.loadRegisterRead(a.fprps[instr.frC]), slots);
+      a.cmppd(tmpSrcC, tmpSrcC, CMP_UNORD);
+      a.orpd(inputNaN, tmpSrcC);
+
+      fixDefaultNaNPd(a, result, inputNaN);
+   }
+
+   if (flags & FMANegate) {
+      // NaN results keep their sign
+      auto signMask = a.allocXmmTmp();
+      a.movapd(signMask, result);
+      a.cmppd(signMask, signMask, CMP_ORD);
+      a.psllq(signMask, 63);
+      a.xorpd(result, signMask);
+   }
+
+   auto dst = a.loadRegisterWrite(a.fprps[instr.frD]);
+   a.movapd(dst, result);
+   return true;
+}
+
+static bool
+ps_madd(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<0, PSSlotsNormal>(a, instr);
+}
+
+static bool
+ps_madds0(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<0, PSSlotsBroadcast0>(a, instr);
+}
+
+static bool
+ps_madds1(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<0, PSSlotsBroadcast1>(a, instr);
+}
+
+static bool
+ps_msub(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<FMASubtract, PSSlotsNormal>(a, instr);
+}
+
+static bool
+ps_nmadd(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<FMANegate, PSSlotsNormal>(a, instr);
+}
+
+static bool
+ps_nmsub(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<FMANegate | FMASubtract, PSSlotsNormal>(a, instr);
+}
+
+// Select
+static bool
+ps_sel(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   // Mask is set in lanes where frA < 0 or NaN, which select frB
+   auto mask = a.allocXmmTmp();
+   a.xorpd(mask, mask);
+   a.cmppd(mask, a.loadRegisterRead(a.fprps[instr.frA]), CMP_NLE_US);
+
+   auto result = a.allocXmmTmp();
+   a.movapd(result, mask);
+   a.andpd(mask, a.loadRegisterRead(a.fprps[instr.frB]));
+   a.andnpd(result, a.loadRegisterRead(a.fprps[instr.frC]));
+   a.orpd(result, mask);
+
+   auto dst = a.loadRegisterWrite(a.fprps[instr.frD]);
+   a.movapd(dst, result);
+   return true;
+}
+
 // Merge registers
 enum MergeFlags
 {
@@ -77,27 +465,27 @@ ps_merge10(PPCEmuAssembler& a, Instruction instr)
 
 void registerPairedInstructions()
 {
-   RegisterInstructionFallback(ps_add);
-   RegisterInstructionFallback(ps_div);
-   RegisterInstructionFallback(ps_mul);
-   RegisterInstructionFallback(ps_sub);
+   RegisterInstruction(ps_add);
+   RegisterInstruction(ps_div);
+   RegisterInstruction(ps_mul);
+   RegisterInstruction(ps_sub);
    RegisterInstructionFallback(ps_abs);
    RegisterInstructionFallback(ps_nabs);
    RegisterInstructionFallback(ps_neg);
-   RegisterInstructionFallback(ps_sel);
+   RegisterInstruction(ps_sel);
    RegisterInstructionFallback(ps_res);
    RegisterInstructionFallback(ps_rsqrte);
-   RegisterInstructionFallback(ps_msub);
-   RegisterInstructionFallback(ps_madd);
-   RegisterInstructionFallback(ps_nmsub);
-   RegisterInstructionFallback(ps_nmadd);
+   RegisterInstruction(ps_msub);
+   RegisterInstruction(ps_madd);
+   RegisterInstruction(ps_nmsub);
+   RegisterInstruction(ps_nmadd);
    RegisterInstructionFallback(ps_mr);
-   RegisterInstructionFallback(ps_sum0);
-   RegisterInstructionFallback(ps_sum1);
-   RegisterInstructionFallback(ps_muls0);
-   RegisterInstructionFallback(ps_muls1);
-   RegisterInstructionFallback(ps_madds0);
-   RegisterInstructionFallback(ps_madds1);
+   RegisterInstruction(ps_sum0);
+   RegisterInstruction(ps_sum1);
+   RegisterInstruction(ps_muls0);
+   RegisterInstruction(ps_muls1);
+   RegisterInstruction(ps_madds0);
+   RegisterInstruction(ps_madds1);
    RegisterInstruction(ps_merge00);
    RegisterInstruction(ps_merge01);
    RegisterInstruction(ps_merge10);
@@ -13,13 +13,6 @@ namespace cpu
 namespace jit
 {
 
-// Instruction Cache Block Invalidate
-static bool
-icbi(PPCEmuAssembler& a, Instruction instr)
-{
-   return true;
-}
-
 // Data Cache Block Flush
 static bool
 dcbf(PPCEmuAssembler& a, Instruction instr)
@@ -267,7 +260,7 @@ registerSystemInstructions()
    RegisterInstruction(dcbz);
    RegisterInstruction(dcbz_l);
    RegisterInstruction(eieio);
-   RegisterInstruction(icbi);
+   RegisterInstructionFallback(icbi);
    RegisterInstruction(isync);
    RegisterInstruction(sync);
    RegisterInstruction(mfspr);
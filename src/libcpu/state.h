@@ -3,6 +3,8 @@
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 
 struct Tracer;
@@ -16,6 +18,31 @@ static const uint32_t timerClockSpeed = busClockSpeed / 4;
 
 using TimerDuration = std::chrono::duration < uint64_t, std::ratio<1, timerClockSpeed>>;
 
+// Number of retired instructions per timebase tick in timebase_mode::instructions
+static const uint32_t instructionsPerTick = coreClockSpeed / timerClockSpeed;
+
+// Number of entries in the JIT return address stack, must be a power of two
+static const uint32_t JitReturnStackSize = 16;
+
+struct JitBranchStats
+{
+   uint64_t returnStackHits = 0;
+   uint64_t returnStackMisses = 0;
+   uint64_t targetCacheHits = 0;
+   uint64_t targetCacheMisses = 0;
+};
+
+// Number of buckets in the interrupt wakeup latency histogram
+static const uint32_t WakeupLatencyBuckets = 16;
+
+// Bucket n counts wakeups where the core was running the interrupt handler
+//  less than 2^n microseconds after the interrupt was posted, the last bucket
+//  counts everything slower.
+struct WakeupLatencyStats
+{
+   uint64_t buckets[WakeupLatencyBuckets] = { };
+};
+
 struct CoreRegs
 {
    uint32_t cia;              // Current execution address
@@ -49,7 +76,51 @@ struct Core : CoreRegs
    uint32_t interrupt_mask { 0xFFFFFFFF };
    std::atomic<uint32_t> interrupt { 0 };
    uint64_t reserve { 0xFFFFFFFFFFFFFFFF };
-   std::chrono::steady_clock::time_point next_alarm;
+   uint64_t next_alarm;       // Timebase tick of the next alarm on this core
+
+   // Set while the core is idle in waitForInterrupt, sleeping on
+   //  wait_condition.  cpu::interrupt only notifies a core which is waiting.
+   std::atomic<bool> waiting { false };
+   std::mutex wait_mutex;
+   std::condition_variable wait_condition;
+
+   // steady_clock nanoseconds when an interrupt was first posted to the
+   //  waiting core, 0 if none has been since it went to sleep.
+   std::atomic<int64_t> wakeup_posted { 0 };
+   WakeupLatencyStats wakeup_latency;
+
+   // Guest instructions retired on this core, only the core itself writes
+   //  to it.  Drives the timebase in timebase_mode::instructions.
+   std::atomic<uint64_t> retired_instructions { 0 };
+
+   // Ticks added to retired_instructions to give this core's timebase in
+   //  timebase_mode::instructions.  Only the core itself writes to it, when
+   //  it syncs with the rest of the system.
+   std::atomic<uint64_t> timebase_offset { 0 };
+
+   // Timebase posted by the timer thread while the core was idle, the core
+   //  catches up to it when it wakes.  0 if there is none.
+   std::atomic<uint64_t> timebase_sync { 0 };
+
+   // Value of retired_instructions at which next_alarm is due in
+   //  timebase_mode::instructions, only used by the core itself.
+   uint64_t alarm_retired { 0xFFFFFFFFFFFFFFFF };
+
+   // Return address stack used by the JIT to predict bclr targets, each
+   //  entry holds the guest return address in the high 32 bits and the
+   //  host code offset in the low 32 bits.
+   uint32_t jit_ras_top { 0 };
+   uint64_t jit_ras[JitReturnStackSize];
+   JitBranchStats jit_branch_stats;
+
+   // Set when breakpoints changed while the core was stopped in translated
+   //  code, which means the rest of the block was translated without them
+   //  and the core has to leave it for the dispatcher.
+   uint32_t jit_block_stale { 0 };
+
+   // Set when the JIT leaves a block at a breakpoint it already stopped at,
+   //  the new translation skips the breakpoint at this address once.
+   uint32_t jit_breakpoint_resume { 0xFFFFFFFF };
 
    uint64_t tb();
 };
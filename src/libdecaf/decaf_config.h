@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <set>
 #include <string>
 #include <vector>
@@ -30,6 +31,14 @@ extern bool debug;
 // TODO: should really be a std::set, but cereal doesn't support those...
 extern std::vector<unsigned> debug_filters;
 
+//! Keep translated shaders in a cache under the config directory
+extern bool shader_cache;
+
+//! Translate new shaders on worker threads rather than stalling the draw
+//!  which first uses them: 0 = off, 1 = skip draws until their shaders are
+//!  ready, 2 = draw with the previous shaders until they are ready
+extern int async_shaders;
+
 } // namespace gpu
 
 namespace gx2
@@ -52,6 +61,9 @@ extern bool enabled;
 //! Use JIT in verification mode where it compares execution to interpreter
 extern bool verify;
 
+//! Number of executions after which a block is retranslated as a trace, 0 to disable
+extern uint32_t trace_threshold;
+
 } // namespace jit
 
 namespace log
@@ -97,6 +109,13 @@ extern std::string content_path;
 //! Time scale factor for emulated clock
 extern double time_scale;
 
+//! Size in bytes of the host stack given to each guest thread
+extern uint32_t fiber_stack_size;
+
+//! Drive the emulated clock of each core by the guest instructions it
+//! retires instead of host time, and skip time while every core is idle
+extern bool instruction_timebase;
+
 } // namespace system
 
 namespace ui
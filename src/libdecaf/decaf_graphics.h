@@ -33,6 +33,9 @@ createGLDriver();
 GraphicsDriver *
 createDX12Driver();
 
+GraphicsDriver *
+createNullGraphicsDriver();
+
 void
 setGraphicsDriver(GraphicsDriver *driver);
 
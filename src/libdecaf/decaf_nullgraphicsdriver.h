@@ -4,19 +4,15 @@
 namespace decaf
 {
 
+// Processes command buffers without rendering anything, for running
+//  without a GPU.  Create with createNullGraphicsDriver.
 class NullGraphicsDriver : public GraphicsDriver
 {
 public:
-   virtual ~NullGraphicsDriver();
+   virtual ~NullGraphicsDriver()
+   {
+   }
 
-   virtual void run() override;
-   virtual void stop() override;
-   virtual float getAverageFPS() override;
-   virtual void notifyCpuFlush(void *ptr, uint32_t size) override;
-   virtual void notifyGpuFlush(void *ptr, uint32_t size) override;
-
-private:
-   bool mRunning = false;
 };
 
 } // namespace decaf
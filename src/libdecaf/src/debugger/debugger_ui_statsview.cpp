@@ -2,6 +2,7 @@
 #include "libcpu/cpu.h"
 #include "libcpu/espresso/espresso_instructionid.h"
 #include "libcpu/espresso/espresso_instructionset.h"
+#include "modules/coreinit/coreinit_scheduler.h"
 #include <algorithm>
 #include <chrono>
 #include <cinttypes>
@@ -118,6 +119,102 @@ draw()
       ImGui::TreePop();
    }
 
+   if (ImGui::TreeNode("JIT Indirect Branches"))
+   {
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      auto branchStats = cpu::getJitBranchStats();
+
+      auto drawHitRate = [](const char *name, uint64_t hits, uint64_t misses) {
+         auto total = hits + misses;
+         auto rate = total ? 100.0f * static_cast<float>(hits) / static_cast<float>(total) : 0.0f;
+
+         ImGui::Text("%s Hits", name);
+         ImGui::NextColumn();
+         ImGui::Text("%" PRIu64, hits);
+         ImGui::NextColumn();
+         ImGui::Text("%.1f%%", rate);
+         ImGui::NextColumn();
+
+         ImGui::Text("%s Misses", name);
+         ImGui::NextColumn();
+         ImGui::Text("%" PRIu64, misses);
+         ImGui::NextColumn();
+         ImGui::NextColumn();
+      };
+
+      drawHitRate("Return Stack", branchStats.returnStackHits, branchStats.returnStackMisses);
+      drawHitRate("Target Cache", branchStats.targetCacheHits, branchStats.targetCacheMisses);
+
+      ImGui::TreePop();
+   }
+
+   if (ImGui::TreeNode("Scheduler Lock"))
+   {
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      auto lockStats = coreinit::internal::getSchedulerLockStats();
+      auto contendedRate = lockStats.acquisitions ? 100.0f * static_cast<float>(lockStats.contended) / static_cast<float>(lockStats.acquisitions) : 0.0f;
+
+      ImGui::Text("Acquisitions");
+      ImGui::NextColumn();
+      ImGui::Text("%" PRIu64, lockStats.acquisitions);
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      ImGui::Text("Contended");
+      ImGui::NextColumn();
+      ImGui::Text("%" PRIu64, lockStats.contended);
+      ImGui::NextColumn();
+      ImGui::Text("%.1f%%", contendedRate);
+      ImGui::NextColumn();
+
+      ImGui::Text("Spins");
+      ImGui::NextColumn();
+      ImGui::Text("%" PRIu64, lockStats.spins);
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      ImGui::TreePop();
+   }
+
+   if (ImGui::TreeNode("Interrupt Wakeup Latency"))
+   {
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      auto latencyStats = cpu::getWakeupLatencyStats();
+      auto total = uint64_t { 0 };
+
+      for (auto count : latencyStats.buckets) {
+         total += count;
+      }
+
+      for (auto i = 0u; i < cpu::WakeupLatencyBuckets; ++i) {
+         auto count = latencyStats.buckets[i];
+         auto rate = total ? 100.0f * static_cast<float>(count) / static_cast<float>(total) : 0.0f;
+
+         if (i < cpu::WakeupLatencyBuckets - 1) {
+            ImGui::Text("< %" PRIu64 " us", uint64_t { 1 } << i);
+         } else {
+            ImGui::Text(">= %" PRIu64 " us", uint64_t { 1 } << (i - 1));
+         }
+
+         ImGui::NextColumn();
+         ImGui::Text("%" PRIu64, count);
+         ImGui::NextColumn();
+         ImGui::Text("%.1f%%", rate);
+         ImGui::NextColumn();
+      }
+
+      ImGui::TreePop();
+   }
+
    ImGui::Columns(1);
    ImGui::End();
 }
@@ -1,4 +1,5 @@
 #include "debugger_ui_internal.h"
+#include "kernel/kernel.h"
 #include "modules/coreinit/coreinit_enum_string.h"
 #include "modules/coreinit/coreinit_scheduler.h"
 #include "modules/coreinit/coreinit_thread.h"
@@ -91,6 +92,11 @@ draw()
 
    coreinit::internal::unlockScheduler();
 
+   auto fiberStats = kernel::getFiberPoolStats();
+   ImGui::Text("Fibers: %u live (peak %u), %u pooled, %" PRIu64 " pool hits, %" PRIu64 " misses",
+               fiberStats.live, fiberStats.peakLive, fiberStats.pooled, fiberStats.hits, fiberStats.misses);
+   ImGui::Separator();
+
    ImGui::Columns(8, "threadList", false);
    ImGui::SetColumnOffset(0, ImGui::GetWindowWidth() * 0.00f);
    ImGui::SetColumnOffset(1, ImGui::GetWindowWidth() * 0.05f);
@@ -112,6 +112,14 @@ initialise(const std::string &gamePath)
       cpu::setJitMode(cpu::jit_mode::disabled);
    }
 
+   cpu::setJitTraceThreshold(decaf::config::jit::trace_threshold);
+
+   if (decaf::config::system::instruction_timebase) {
+      cpu::setTimebaseMode(cpu::timebase_mode::instructions);
+   } else {
+      cpu::setTimebaseMode(cpu::timebase_mode::realtime);
+   }
+
    // Setup core
    mem::initialise();
    cpu::initialise();
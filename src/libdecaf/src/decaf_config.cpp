@@ -20,6 +20,8 @@ namespace gpu
 
 bool debug = false;
 std::vector<unsigned> debug_filters = {};
+bool shader_cache = true;
+int async_shaders = 0;
 
 } // namespace gpu
 
@@ -36,6 +38,7 @@ namespace jit
 
 bool enabled = true;
 bool verify = false;
+uint32_t trace_threshold = 0;
 
 } // namespace jit
 
@@ -76,6 +79,8 @@ int region = static_cast<int>(coreinit::SCIRegion::USA);
 std::string mlc_path = "mlc";
 std::string content_path = {};
 double time_scale = 1.0;
+uint32_t fiber_stack_size = 1024 * 1024;
+bool instruction_timebase = false;
 
 } // namespace system
 
@@ -1,6 +1,7 @@
 #include "decaf_graphics.h"
 #include "gpu/opengl/opengl_driver.h"
 #include "gpu/dx12/dx12_driver.h"
+#include "gpu/null/null_driver.h"
 
 namespace decaf
 {
@@ -28,6 +29,12 @@ createDX12Driver()
 #endif
 }
 
+GraphicsDriver *
+createNullGraphicsDriver()
+{
+   return new gpu::null::Driver();
+}
+
 void
 setGraphicsDriver(GraphicsDriver *driver)
 {
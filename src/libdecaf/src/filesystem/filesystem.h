@@ -9,10 +9,14 @@
 #include "filesystem_path.h"
 #include "filesystem_virtual_folder.h"
 #include <common/log.h>
+#include <mutex>
 
 namespace fs
 {
 
+// The nodes of the tree are not thread safe, and FS commands run on several
+//  threads, so every operation on the tree holds mMutex.  Reads and writes
+//  through an open handle do not touch the tree and still run in parallel.
 class FileSystem
 {
 public:
@@ -23,6 +27,8 @@ public:
 
    Folder *makeFolder(Path path)
    {
+      std::unique_lock<std::mutex> lock { mMutex };
+
       auto node = createPath(path);
 
       if (!node || node->type() != Node::FolderNode) {
@@ -34,6 +40,8 @@ public:
 
    bool remove(Path path)
    {
+      std::unique_lock<std::mutex> lock { mMutex };
+
       auto parent = findNode(path.parentPath());
 
       if (!parent || parent->type() != Node::FolderNode) {
@@ -46,6 +54,8 @@ public:
 
    Error move(Path src, Path dst)
    {
+      std::unique_lock<std::mutex> lock { mMutex };
+
       // Find our parents
       auto srcParent = findNode(src.parentPath());
 
@@ -77,10 +87,18 @@ public:
 
    Node *makeLink(Path dst, Path src)
    {
-      return makeLink(dst, findNode(src));
+      std::unique_lock<std::mutex> lock { mMutex };
+      return makeLinkNoLock(dst, findNode(src));
    }
 
    Node *makeLink(Path dst, Node *srcNode)
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      return makeLinkNoLock(dst, srcNode);
+   }
+
+protected:
+   Node *makeLinkNoLock(Path dst, Node *srcNode)
    {
       // Ensure src exists
       if (!srcNode) {
@@ -117,8 +135,11 @@ public:
       return dstNode;
    }
 
+public:
    bool mountHostFolder(Path dst, HostPath src, Permissions permissions)
    {
+      std::unique_lock<std::mutex> lock { mMutex };
+
       auto parent = createPath(dst.parentPath());
 
       if (!parent || parent->type() != Node::FolderNode || parent->deviceType() != Node::VirtualDevice) {
@@ -133,6 +154,8 @@ public:
 
    bool mountHostFile(Path dst, HostPath src, Permissions permissions)
    {
+      std::unique_lock<std::mutex> lock { mMutex };
+
       auto parent = createPath(dst.parentPath());
 
       if (!parent || parent->type() != Node::FolderNode || parent->deviceType() != Node::VirtualDevice) {
@@ -145,6 +168,8 @@ public:
 
    FileHandle *openFile(Path path, File::OpenMode mode)
    {
+      std::unique_lock<std::mutex> lock { mMutex };
+
       auto node = findNode(path.parentPath());
 
       if (!node || node->type() != Node::FolderNode) {
@@ -157,6 +182,8 @@ public:
 
    FolderHandle *openFolder(Path path)
    {
+      std::unique_lock<std::mutex> lock { mMutex };
+
       auto node = findNode(path);
 
       if (!node || node->type() != Node::FolderNode) {
@@ -169,6 +196,8 @@ public:
 
    bool findEntry(Path path, FolderEntry &entry)
    {
+      std::unique_lock<std::mutex> lock { mMutex };
+
       auto node = findNode(path);
 
       if (!node) {
@@ -191,6 +220,8 @@ public:
 
    bool setPermissions(Path path, Permissions permissions, PermissionFlags flags)
    {
+      std::unique_lock<std::mutex> lock { mMutex };
+
       auto node = findNode(path);
 
       if (!node) {
@@ -258,6 +289,7 @@ protected:
    }
 
 private:
+   std::mutex mMutex;
    VirtualFolder mRoot;
 };
 
@@ -14,6 +14,10 @@ constexpr unsigned Log2(unsigned x)
    return x == 1 ? 0 : 1 + Log2(x >> 1);
 }
 
+// Set to false to use the per-pixel path for unscaled copies as well
+static const bool
+USE_MICRO_TILE_COPY = true;
+
 constexpr uint32_t NumPipes = 2;
 constexpr uint32_t NumBanks = 4;
 constexpr uint32_t PipeInterleaveBytes = 256;
@@ -707,11 +711,273 @@ AddrComputeSurfaceAddrFromCoord(const ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT *
 typedef void(*AddrFromCoordFunc)(const ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT *pIn,
                                  ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT *pOut);
 
+// Layout of the pixels within a thin micro tile, used to copy surfaces a
+//  micro tile at a time instead of computing the address of every pixel.
+template<bool IsDepth, uint32_t Bpp>
+struct MicroTileLayout
+{
+   MicroTileLayout()
+   {
+      for (auto y = 0u; y < MicroTileHeight; ++y) {
+         for (auto x = 0u; x < MicroTileWidth; ++x) {
+            pixelOffset[y * MicroTileWidth + x] =
+               (Bpp / 8) * ComputePixelIndexWithinMicroTile<Bpp, ADDR_TM_1D_TILED_THIN1, GetTileType<IsDepth>()>(x, y, 0);
+         }
+      }
+
+      // Find how many horizontally adjacent pixels are also adjacent in memory
+      runLength = MicroTileWidth;
+
+      for (auto x = 1u; x < MicroTileWidth; ++x) {
+         if (pixelOffset[x] != x * (Bpp / 8)) {
+            runLength = x;
+            break;
+         }
+      }
+   }
+
+   uint32_t pixelOffset[MicroTilePixels];
+   uint32_t runLength;
+};
+
+static inline bool
+canCopyByMicroTile(const ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &addrInput,
+                   uint32_t bpp,
+                   bool isDepth)
+{
+   if (TileModeThickness[addrInput.tileMode] != 1) {
+      return false;
+   }
+
+   // 96 bpp pixels can straddle a pipe interleave boundary, which makes
+   //  writes overlap and the result depend on the order pixels are copied in
+   if (bpp == 96) {
+      return false;
+   }
+
+   if (isDepth && addrInput.compBits && addrInput.compBits != bpp) {
+      return false;
+   }
+
+   return true;
+}
+
+// Returns the address of pixel (x, y) within a micro tile whose first pixel
+//  is at origin.  Every pixel of a thin micro tile shares the same pipe and
+//  bank, so for macro tiled surfaces only the offset within the pipe
+//  interleave group moves.
+template<TilingMode Tiling, bool IsDepth, uint32_t Bpp>
+static inline uint64_t
+getMicroTilePixelAddr(const MicroTileLayout<IsDepth, Bpp> &layout,
+                      uint64_t origin,
+                      uint32_t pitch,
+                      uint32_t x,
+                      uint32_t y)
+{
+   if (Tiling == TilingMode::Linear) {
+      return origin + (static_cast<uint64_t>(y) * pitch + x) * (Bpp / 8);
+   } else if (Tiling == TilingMode::Micro) {
+      return origin + layout.pixelOffset[y * MicroTileWidth + x];
+   } else {
+      constexpr uint64_t numGroupBits = Log2(PipeInterleaveBytes);
+      constexpr uint64_t numBankPipeBits = Log2(NumBanks) + Log2(NumPipes);
+      constexpr uint64_t groupMask = (1 << numGroupBits) - 1;
+      constexpr uint64_t bankPipeMask = ((1 << numBankPipeBits) - 1) << numGroupBits;
+
+      auto base = ((origin >> (numGroupBits + numBankPipeBits)) << numGroupBits) | (origin & groupMask);
+      auto offset = base + layout.pixelOffset[y * MicroTileWidth + x];
+      return ((offset & ~groupMask) << numBankPipeBits) | (origin & bankPipeMask) | (offset & groupMask);
+   }
+}
+
+template<uint32_t Bytes>
+static inline void
+copyRun(uint8_t *dst, const uint8_t *src)
+{
+   std::memcpy(dst, src, Bytes);
+}
+
+// Copies runLength pixels, which must be contiguous in both surfaces
+template<uint32_t Bpp>
+static inline void
+copyPixelRun(uint8_t *dst, const uint8_t *src, uint32_t runLength)
+{
+   switch (runLength) {
+   case 1:
+      copyRun<Bpp / 8>(dst, src);
+      break;
+   case 2:
+      copyRun<2 * Bpp / 8>(dst, src);
+      break;
+   case 4:
+      copyRun<4 * Bpp / 8>(dst, src);
+      break;
+   case 8:
+      copyRun<8 * Bpp / 8>(dst, src);
+      break;
+   default:
+      std::memcpy(dst, src, runLength * Bpp / 8);
+   }
+}
+
+template<TilingMode Tiling>
+static inline bool
+isRunContiguous(uint64_t addr, uint32_t runBytes)
+{
+   if (Tiling != TilingMode::Macro) {
+      return true;
+   }
+
+   return (addr & (PipeInterleaveBytes - 1)) + runBytes <= PipeInterleaveBytes;
+}
+
+// Copies between two surfaces of the same size a micro tile at a time, the
+//  full address is only computed for the first pixel of each micro tile.
+template<TilingMode DstTiling, TilingMode SrcTiling, bool IsDepth, uint32_t Bpp>
+static bool
+copySurfaceMicroTiles(uint8_t *dstBasePtr,
+                      ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &dstAddrInput,
+                      uint8_t *srcBasePtr,
+                      ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                      uint32_t width,
+                      uint32_t firstRow,
+                      uint32_t numRows,
+                      AddrFromCoordFunc dstCoordFunc,
+                      AddrFromCoordFunc srcCoordFunc)
+{
+   static const MicroTileLayout<IsDepth, Bpp> layout;
+
+   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT srcAddrOutput;
+   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT dstAddrOutput;
+
+   std::memset(&srcAddrOutput, 0, sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT));
+   std::memset(&dstAddrOutput, 0, sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT));
+
+   srcAddrOutput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT);
+   dstAddrOutput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT);
+
+   auto dstRunLength = (DstTiling == TilingMode::Linear) ? MicroTileWidth : layout.runLength;
+   auto srcRunLength = (SrcTiling == TilingMode::Linear) ? MicroTileWidth : layout.runLength;
+   auto runLength = std::min(dstRunLength, srcRunLength);
+   auto runBytes = runLength * Bpp / 8;
+
+   auto endRow = firstRow + numRows;
+
+   for (auto tileY = firstRow; tileY < endRow; tileY += MicroTileHeight) {
+      auto tileHeight = std::min(MicroTileHeight, endRow - tileY);
+
+      for (auto tileX = 0u; tileX < width; tileX += MicroTileWidth) {
+         auto tileWidth = std::min(MicroTileWidth, width - tileX);
+
+         srcAddrInput.x = tileX;
+         srcAddrInput.y = tileY;
+         srcCoordFunc(&srcAddrInput, &srcAddrOutput);
+
+         dstAddrInput.x = tileX;
+         dstAddrInput.y = tileY;
+         dstCoordFunc(&dstAddrInput, &dstAddrOutput);
+
+         auto srcOrigin = srcAddrOutput.addr;
+         auto dstOrigin = dstAddrOutput.addr;
+
+         if (tileWidth < MicroTileWidth) {
+            // Partial tile at the right edge of the surface
+            for (auto y = 0u; y < tileHeight; ++y) {
+               for (auto x = 0u; x < tileWidth; ++x) {
+                  auto src = getMicroTilePixelAddr<SrcTiling>(layout, srcOrigin, srcAddrInput.pitch, x, y);
+                  auto dst = getMicroTilePixelAddr<DstTiling>(layout, dstOrigin, dstAddrInput.pitch, x, y);
+                  copyRun<Bpp / 8>(&dstBasePtr[dst], &srcBasePtr[src]);
+               }
+            }
+
+            continue;
+         }
+
+         for (auto y = 0u; y < tileHeight; ++y) {
+            for (auto x = 0u; x < MicroTileWidth; x += runLength) {
+               auto src = getMicroTilePixelAddr<SrcTiling>(layout, srcOrigin, srcAddrInput.pitch, x, y);
+               auto dst = getMicroTilePixelAddr<DstTiling>(layout, dstOrigin, dstAddrInput.pitch, x, y);
+
+               if (isRunContiguous<SrcTiling>(src, runBytes) && isRunContiguous<DstTiling>(dst, runBytes)) {
+                  copyPixelRun<Bpp>(&dstBasePtr[dst], &srcBasePtr[src], runLength);
+               } else {
+                  for (auto i = 0u; i < runLength; ++i) {
+                     src = getMicroTilePixelAddr<SrcTiling>(layout, srcOrigin, srcAddrInput.pitch, x + i, y);
+                     dst = getMicroTilePixelAddr<DstTiling>(layout, dstOrigin, dstAddrInput.pitch, x + i, y);
+                     copyRun<Bpp / 8>(&dstBasePtr[dst], &srcBasePtr[src]);
+                  }
+               }
+            }
+         }
+      }
+   }
+
+   return true;
+}
+
+// Selects source tiling template
+template<TilingMode DstTiling, bool IsDepth, uint32_t Bpp>
+static bool
+copySurfaceMicroTiles2(uint8_t *dstBasePtr,
+                       ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &dstAddrInput,
+                       uint8_t *srcBasePtr,
+                       ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                       uint32_t width,
+                       uint32_t firstRow,
+                       uint32_t numRows,
+                       AddrFromCoordFunc dstCoordFunc,
+                       AddrFromCoordFunc srcCoordFunc)
+{
+   switch (TileModeTiling[srcAddrInput.tileMode]) {
+   case TilingMode::Linear:
+      return copySurfaceMicroTiles<DstTiling, TilingMode::Linear, IsDepth, Bpp>(
+         dstBasePtr, dstAddrInput, srcBasePtr, srcAddrInput, width, firstRow, numRows, dstCoordFunc, srcCoordFunc);
+   case TilingMode::Micro:
+      return copySurfaceMicroTiles<DstTiling, TilingMode::Micro, IsDepth, Bpp>(
+         dstBasePtr, dstAddrInput, srcBasePtr, srcAddrInput, width, firstRow, numRows, dstCoordFunc, srcCoordFunc);
+   case TilingMode::Macro:
+      return copySurfaceMicroTiles<DstTiling, TilingMode::Macro, IsDepth, Bpp>(
+         dstBasePtr, dstAddrInput, srcBasePtr, srcAddrInput, width, firstRow, numRows, dstCoordFunc, srcCoordFunc);
+   default:
+      decaf_abort("Unexpected source tiling type");
+   }
+}
+
+// Selects destination tiling template
+template<bool IsDepth, uint32_t Bpp>
+static bool
+copySurfaceMicroTiles1(uint8_t *dstBasePtr,
+                       ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &dstAddrInput,
+                       uint8_t *srcBasePtr,
+                       ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                       uint32_t width,
+                       uint32_t firstRow,
+                       uint32_t numRows,
+                       AddrFromCoordFunc dstCoordFunc,
+                       AddrFromCoordFunc srcCoordFunc)
+{
+   switch (TileModeTiling[dstAddrInput.tileMode]) {
+   case TilingMode::Linear:
+      return copySurfaceMicroTiles2<TilingMode::Linear, IsDepth, Bpp>(
+         dstBasePtr, dstAddrInput, srcBasePtr, srcAddrInput, width, firstRow, numRows, dstCoordFunc, srcCoordFunc);
+   case TilingMode::Micro:
+      return copySurfaceMicroTiles2<TilingMode::Micro, IsDepth, Bpp>(
+         dstBasePtr, dstAddrInput, srcBasePtr, srcAddrInput, width, firstRow, numRows, dstCoordFunc, srcCoordFunc);
+   case TilingMode::Macro:
+      return copySurfaceMicroTiles2<TilingMode::Macro, IsDepth, Bpp>(
+         dstBasePtr, dstAddrInput, srcBasePtr, srcAddrInput, width, firstRow, numRows, dstCoordFunc, srcCoordFunc);
+   default:
+      decaf_abort("Unexpected destination tiling type");
+   }
+}
+
 template<uint32_t NumSamples, bool IsDepth, uint32_t Bpp>
 static bool
 copySurfacePixels6(uint8_t *dstBasePtr,
                    uint32_t dstWidth,
                    uint32_t dstHeight,
+                   uint32_t dstFirstRow,
+                   uint32_t dstNumRows,
                    ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &dstAddrInput,
                    uint8_t *srcBasePtr,
                    uint32_t srcWidth,
@@ -729,7 +995,19 @@ copySurfacePixels6(uint8_t *dstBasePtr,
    srcAddrOutput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT);
    dstAddrOutput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT);
 
-   for (auto y = 0u; y < dstHeight; ++y) {
+   // Unscaled copies of thin surfaces can be done a micro tile at a time
+   if (USE_MICRO_TILE_COPY
+    && NumSamples == 1
+    && srcWidth == dstWidth
+    && srcHeight == dstHeight
+    && (dstFirstRow % MicroTileHeight) == 0
+    && canCopyByMicroTile(dstAddrInput, Bpp, IsDepth)
+    && canCopyByMicroTile(srcAddrInput, Bpp, IsDepth)) {
+      return copySurfaceMicroTiles1<IsDepth, Bpp>(
+         dstBasePtr, dstAddrInput, srcBasePtr, srcAddrInput, dstWidth, dstFirstRow, dstNumRows, dstCoordFunc, srcCoordFunc);
+   }
+
+   for (auto y = dstFirstRow; y < dstFirstRow + dstNumRows; ++y) {
       for (auto x = 0u; x < dstWidth; ++x) {
          srcAddrInput.x = srcWidth * x / dstWidth;
          srcAddrInput.y = srcHeight * y / dstHeight;
@@ -754,6 +1032,8 @@ static bool
 copySurfacePixels5(uint8_t *dstBasePtr,
                    uint32_t dstWidth,
                    uint32_t dstHeight,
+                   uint32_t dstFirstRow,
+                   uint32_t dstNumRows,
                    ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &dstAddrInput,
                    uint8_t *srcBasePtr,
                    uint32_t srcWidth,
@@ -817,7 +1097,7 @@ copySurfacePixels5(uint8_t *dstBasePtr,
    }
 
    return copySurfacePixels6<NumSamples, IsDepth, Bpp>(
-      dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, dstCoordFunc, srcCoordFunc);
+      dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, dstCoordFunc, srcCoordFunc);
 }
 
 // Selects destination tile mode template
@@ -826,6 +1106,8 @@ static bool
 copySurfacePixels4(uint8_t *dstBasePtr,
                    uint32_t dstWidth,
                    uint32_t dstHeight,
+                   uint32_t dstFirstRow,
+                   uint32_t dstNumRows,
                    ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &dstAddrInput,
                    uint8_t *srcBasePtr,
                    uint32_t srcWidth,
@@ -888,7 +1170,7 @@ copySurfacePixels4(uint8_t *dstBasePtr,
    }
 
    return copySurfacePixels5<NumSamples, IsDepth, Bpp>(
-      dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, dstCoordFunc);
+      dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, dstCoordFunc);
 }
 
 // Optimized for copying between linear buffers
@@ -897,6 +1179,8 @@ static bool
 copySurfacePixelsLinear(uint8_t *dstBasePtr,
                         uint32_t dstWidth,
                         uint32_t dstHeight,
+                        uint32_t dstFirstRow,
+                        uint32_t dstNumRows,
                         ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &dstAddrInput,
                         uint8_t *srcBasePtr,
                         uint32_t srcWidth,
@@ -928,8 +1212,10 @@ copySurfacePixelsLinear(uint8_t *dstBasePtr,
    auto srcXInc = (static_cast<uint64_t>(srcWidth) << 32) / dstWidth;
    auto srcYInc = (static_cast<uint64_t>(srcHeight) << 32) / dstHeight;
 
-   uint64_t srcYFrac = 0;
-   for (auto y = 0u; y < dstHeight; ++y, dst += dstPitch, srcYFrac += srcYInc) {
+   uint64_t srcYFrac = srcYInc * dstFirstRow;
+   dst += dstFirstRow * dstPitch;
+
+   for (auto y = 0u; y < dstNumRows; ++y, dst += dstPitch, srcYFrac += srcYInc) {
       auto srcY = static_cast<uint32_t>(srcYFrac >> 32);
       auto srcRow = &src[srcY * srcPitch];
       uint64_t srcXFrac = 0;
@@ -950,6 +1236,8 @@ static bool
 copySurfacePixels3(uint8_t *dstBasePtr,
                    uint32_t dstWidth,
                    uint32_t dstHeight,
+                   uint32_t dstFirstRow,
+                   uint32_t dstNumRows,
                    ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &dstAddrInput,
                    uint8_t *srcBasePtr,
                    uint32_t srcWidth,
@@ -962,55 +1250,55 @@ copySurfacePixels3(uint8_t *dstBasePtr,
       if (TileModeTiling[dstAddrInput.tileMode] == TilingMode::Linear
        && TileModeTiling[srcAddrInput.tileMode] == TilingMode::Linear) {
          return copySurfacePixelsLinear<8>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
       } else {
          return copySurfacePixels4<NumSamples, IsDepth, 8>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
       }
    case 16:
       if (TileModeTiling[dstAddrInput.tileMode] == TilingMode::Linear
        && TileModeTiling[srcAddrInput.tileMode] == TilingMode::Linear) {
          return copySurfacePixelsLinear<16>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
       } else {
          return copySurfacePixels4<NumSamples, IsDepth, 16>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
       }
    case 32:
       if (TileModeTiling[dstAddrInput.tileMode] == TilingMode::Linear
        && TileModeTiling[srcAddrInput.tileMode] == TilingMode::Linear) {
          return copySurfacePixelsLinear<32>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
       } else {
          return copySurfacePixels4<NumSamples, IsDepth, 32>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
       }
    case 64:
       if (TileModeTiling[dstAddrInput.tileMode] == TilingMode::Linear
        && TileModeTiling[srcAddrInput.tileMode] == TilingMode::Linear) {
          return copySurfacePixelsLinear<64>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
       } else {
          return copySurfacePixels4<NumSamples, IsDepth, 64>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
       }
    case 96:
       if (TileModeTiling[dstAddrInput.tileMode] == TilingMode::Linear
        && TileModeTiling[srcAddrInput.tileMode] == TilingMode::Linear) {
          return copySurfacePixelsLinear<96>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
       } else {
          return copySurfacePixels4<NumSamples, IsDepth, 96>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
       }
    case 128:
       if (TileModeTiling[dstAddrInput.tileMode] == TilingMode::Linear
        && TileModeTiling[srcAddrInput.tileMode] == TilingMode::Linear) {
          return copySurfacePixelsLinear<128>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
       } else {
          return copySurfacePixels4<NumSamples, IsDepth, 128>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
       }
    default:
       decaf_abort("Unexpected bits-per-pixel value");
@@ -1023,6 +1311,8 @@ static bool
 copySurfacePixels2(uint8_t *dstBasePtr,
                    uint32_t dstWidth,
                    uint32_t dstHeight,
+                   uint32_t dstFirstRow,
+                   uint32_t dstNumRows,
                    ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &dstAddrInput,
                    uint8_t *srcBasePtr,
                    uint32_t srcWidth,
@@ -1033,10 +1323,10 @@ copySurfacePixels2(uint8_t *dstBasePtr,
 {
    if (isDepth) {
       return copySurfacePixels3<NumSamples, true>(
-         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp);
+         dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp);
    } else {
       return copySurfacePixels3<NumSamples, false>(
-         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp);
+         dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp);
    }
 }
 
@@ -1052,26 +1342,47 @@ copySurfacePixels(uint8_t *dstBasePtr,
                   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
                   uint32_t bpp,
                   bool isDepth,
-                  uint32_t numSamples)
+                  uint32_t numSamples,
+                  uint32_t dstFirstRow,
+                  uint32_t dstNumRows)
 {
    switch (numSamples) {
    case 1:
       return copySurfacePixels2<1>(
-         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp, isDepth);
+         dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp, isDepth);
    case 2:
       return copySurfacePixels2<2>(
-         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp, isDepth);
+         dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp, isDepth);
    case 4:
       return copySurfacePixels2<4>(
-         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp, isDepth);
+         dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp, isDepth);
    case 8:
       return copySurfacePixels2<8>(
-         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp, isDepth);
+         dstBasePtr, dstWidth, dstHeight, dstFirstRow, dstNumRows, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp, isDepth);
    default:
       decaf_abort("Unexpected number of samples value");
    }
 }
 
+bool
+copySurfacePixels(uint8_t *dstBasePtr,
+                  uint32_t dstWidth,
+                  uint32_t dstHeight,
+                  ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &dstAddrInput,
+                  uint8_t *srcBasePtr,
+                  uint32_t srcWidth,
+                  uint32_t srcHeight,
+                  ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                  uint32_t bpp,
+                  bool isDepth,
+                  uint32_t numSamples)
+{
+   return copySurfacePixels(dstBasePtr, dstWidth, dstHeight, dstAddrInput,
+                            srcBasePtr, srcWidth, srcHeight, srcAddrInput,
+                            bpp, isDepth, numSamples,
+                            0, dstHeight);
+}
+
 } // namespace addrlibopt
 
 } // namespace gpu
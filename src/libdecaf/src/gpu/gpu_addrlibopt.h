@@ -21,6 +21,23 @@ copySurfacePixels(uint8_t *dstBasePtr,
                   bool isDepth,
                   uint32_t numSamples);
 
+// Only copies destination rows [dstFirstRow, dstFirstRow + dstNumRows), so
+//  that a copy can be split into bands which are run in parallel.
+bool
+copySurfacePixels(uint8_t *dstBasePtr,
+                  uint32_t dstWidth,
+                  uint32_t dstHeight,
+                  ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &dstAddrInput,
+                  uint8_t *srcBasePtr,
+                  uint32_t srcWidth,
+                  uint32_t srcHeight,
+                  ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                  uint32_t bpp,
+                  bool isDepth,
+                  uint32_t numSamples,
+                  uint32_t dstFirstRow,
+                  uint32_t dstNumRows);
+
 } // namespace addrlibopt
 
 } // namespace gpu
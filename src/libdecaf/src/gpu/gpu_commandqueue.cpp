@@ -4,55 +4,44 @@
 #include "modules/gx2/gx2_event.h"
 #include "modules/gx2/gx2_cbpool.h"
 #include "modules/coreinit/coreinit_time.h"
-#include <condition_variable>
-#include <queue>
-#include <mutex>
-
-// TODO: LOCK FREE SHIT
+#include <common/mpscqueue.h>
 
 namespace gpu
 {
 
+static const auto CommandQueueSize = 1024u;
+
 class CommandQueue
 {
 public:
+   // GX2 normally only submits from its main core, but display lists can be
+   //  queued from any core.
    void appendBuffer(pm4::Buffer *buf)
    {
-      std::unique_lock<std::mutex> lock { mQueueMutex };
       mQueue.push(buf);
-      mQueueCV.notify_all();
    }
 
    pm4::Buffer *dequeueBuffer()
    {
-      std::unique_lock<std::mutex> lock{ mQueueMutex };
-
-      if (!mQueue.size()) {
-         return nullptr;
-      }
-
-      auto next = mQueue.front();
-      mQueue.pop();
+      pm4::Buffer *next = nullptr;
+      mQueue.tryPop(next);
       return next;
    }
 
    pm4::Buffer *waitForBuffer()
    {
-      std::unique_lock<std::mutex> lock { mQueueMutex };
-
-      while (!mQueue.size()) {
-         mQueueCV.wait(lock);
-      }
-
-      auto next = mQueue.front();
-      mQueue.pop();
+      pm4::Buffer *next = nullptr;
+      mQueue.waitPop(next);
       return next;
    }
 
+   void wake()
+   {
+      mQueue.wake();
+   }
+
 private:
-   std::mutex mQueueMutex;
-   std::condition_variable mQueueCV;
-   std::queue<pm4::Buffer *> mQueue;
+   MpscQueue<pm4::Buffer *, CommandQueueSize> mQueue;
 };
 
 static CommandQueue
@@ -61,7 +50,7 @@ gQueue;
 void
 awaken()
 {
-   gQueue.appendBuffer(nullptr);
+   gQueue.wake();
 }
 
 void
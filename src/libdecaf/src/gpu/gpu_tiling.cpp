@@ -1,6 +1,8 @@
 #include <common/decaf_assert.h>
+#include <common/workerpool.h>
 #include "gpu_addrlibopt.h"
 #include "gpu_tiling.h"
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 
@@ -10,6 +12,20 @@ namespace gpu
 static const bool
 USE_ADDRLIBOPT = true;
 
+static const bool
+USE_PARALLEL_UNTILE = true;
+
+// Surfaces smaller than this are not worth waking the untile threads for
+static const uint64_t
+ParallelUntileMinBytes = 256 * 1024;
+
+// The tallest macro tile is 32 rows, so bands never split a macro tile
+static const uint32_t
+UntileBandRows = 32;
+
+static const unsigned
+MaxUntileThreads = 4;
+
 static ADDR_HANDLE
 gAddrLibHandle = nullptr;
 
@@ -143,22 +159,19 @@ copySurfacePixels(uint8_t *dstBasePtr,
    }
 }
 
-bool
-convertFromTiled(
-   uint8_t *output,
-   uint32_t outputPitch,
-   uint8_t *input,
-   latte::SQ_TILE_MODE tileMode,
-   uint32_t swizzle,
-   uint32_t pitch,
-   uint32_t width,
-   uint32_t height,
-   uint32_t depth,
-   uint32_t aa,
-   bool isDepth,
-   uint32_t bpp)
+static void
+setupUntileAddrInputs(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                      ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &dstAddrInput,
+                      uint32_t outputPitch,
+                      latte::SQ_TILE_MODE tileMode,
+                      uint32_t swizzle,
+                      uint32_t pitch,
+                      uint32_t height,
+                      uint32_t depth,
+                      uint32_t aa,
+                      bool isDepth,
+                      uint32_t bpp)
 {
-   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT srcAddrInput;
    std::memset(&srcAddrInput, 0, sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT));
    srcAddrInput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT);
    srcAddrInput.bpp = bpp;
@@ -176,7 +189,6 @@ convertFromTiled(
       &srcAddrInput.pipeSwizzle);
 
    // Setup dst
-   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT dstAddrInput;
    std::memset(&dstAddrInput, 0, sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT));
    dstAddrInput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT);
    dstAddrInput.bpp = bpp;
@@ -195,6 +207,27 @@ convertFromTiled(
    // Untiling always takes sample 0
    srcAddrInput.sample = 0;
    dstAddrInput.sample = 0;
+}
+
+bool
+convertFromTiled(
+   uint8_t *output,
+   uint32_t outputPitch,
+   uint8_t *input,
+   latte::SQ_TILE_MODE tileMode,
+   uint32_t swizzle,
+   uint32_t pitch,
+   uint32_t width,
+   uint32_t height,
+   uint32_t depth,
+   uint32_t aa,
+   bool isDepth,
+   uint32_t bpp)
+{
+   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT srcAddrInput;
+   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT dstAddrInput;
+   setupUntileAddrInputs(srcAddrInput, dstAddrInput,
+                         outputPitch, tileMode, swizzle, pitch, height, depth, aa, isDepth, bpp);
 
    // Untile all of the slices of this surface
    for (uint32_t slice = 0; slice < depth; ++slice) {
@@ -209,4 +242,68 @@ convertFromTiled(
    return true;
 }
 
+static WorkerPool &
+getUntilePool()
+{
+   static WorkerPool pool { "Untile", std::min(MaxUntileThreads, std::max(1u, std::thread::hardware_concurrency()) - 1) };
+   return pool;
+}
+
+bool
+convertFromTiledParallel(
+   uint8_t *output,
+   uint32_t outputPitch,
+   uint8_t *input,
+   latte::SQ_TILE_MODE tileMode,
+   uint32_t swizzle,
+   uint32_t pitch,
+   uint32_t width,
+   uint32_t height,
+   uint32_t depth,
+   uint32_t aa,
+   bool isDepth,
+   uint32_t bpp)
+{
+   auto surfaceBytes = static_cast<uint64_t>(width) * height * depth * (bpp / 8);
+
+   if (!USE_ADDRLIBOPT || !USE_PARALLEL_UNTILE || surfaceBytes < ParallelUntileMinBytes) {
+      return convertFromTiled(output, outputPitch, input, tileMode, swizzle,
+                              pitch, width, height, depth, aa, isDepth, bpp);
+   }
+
+   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT srcAddrInput;
+   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT dstAddrInput;
+   setupUntileAddrInputs(srcAddrInput, dstAddrInput,
+                         outputPitch, tileMode, swizzle, pitch, height, depth, aa, isDepth, bpp);
+
+   // The same checks as the serial copySurfacePixels makes
+   decaf_check(srcAddrInput.isDepth == dstAddrInput.isDepth);
+   decaf_check(srcAddrInput.numSamples == dstAddrInput.numSamples);
+   auto numSamples = dstAddrInput.numSamples;
+
+   // Split every slice into bands of whole macro tile rows, each band writes
+   //  to a distinct set of output rows so they can be untiled independently.
+   auto bandsPerSlice = (height + UntileBandRows - 1) / UntileBandRows;
+
+   getUntilePool().parallelFor(bandsPerSlice * depth, [&](unsigned index) {
+      auto slice = index / bandsPerSlice;
+      auto firstRow = (index % bandsPerSlice) * UntileBandRows;
+      auto numRows = std::min(UntileBandRows, height - firstRow);
+
+      // copySurfacePixels modifies the coordinates in the inputs
+      auto bandSrcAddrInput = srcAddrInput;
+      auto bandDstAddrInput = dstAddrInput;
+      bandSrcAddrInput.slice = slice;
+      bandDstAddrInput.slice = slice;
+
+      gpu::addrlibopt::copySurfacePixels(
+         output, width, height, bandDstAddrInput,
+         input, width, height, bandSrcAddrInput,
+         bpp, isDepth, numSamples,
+         firstRow, numRows);
+   });
+
+   return true;
+}
+
 } // namespace gpu
@@ -32,4 +32,21 @@ convertFromTiled(uint8_t *output,
                  bool isDepth,
                  uint32_t bpp);
 
+// Same as convertFromTiled, but large surfaces are split into bands of
+//  macro tile rows which are untiled on a pool of worker threads.  Returns
+//  once the whole surface has been untiled.
+bool
+convertFromTiledParallel(uint8_t *output,
+                         uint32_t outputPitch,
+                         uint8_t *input,
+                         latte::SQ_TILE_MODE tileMode,
+                         uint32_t swizzle,
+                         uint32_t pitch,
+                         uint32_t width,
+                         uint32_t height,
+                         uint32_t depth,
+                         uint32_t aa,
+                         bool isDepth,
+                         uint32_t bpp);
+
 } // namespace gpu
\ No newline at end of file
@@ -0,0 +1,322 @@
+#include <common/byte_swap.h>
+#include <common/decaf_assert.h>
+#include <common/log.h>
+#include "gpu/gpu_commandqueue.h"
+#include "gpu/latte_registers.h"
+#include "gpu/pm4_buffer.h"
+#include "gpu/pm4_capture.h"
+#include "modules/coreinit/coreinit_time.h"
+#include "modules/gx2/gx2_event.h"
+#include "null_driver.h"
+#include <libcpu/mem.h>
+
+namespace gpu
+{
+
+namespace null
+{
+
+Driver::Driver()
+{
+   mRegisters.fill(0);
+   mStreamOutOffsets.fill(0);
+}
+
+void
+Driver::run()
+{
+   mRunning = true;
+
+   while (mRunning) {
+      auto buffer = gpu::unqueueCommandBuffer();
+
+      if (!buffer) {
+         continue;
+      }
+
+      executeBuffer(buffer);
+   }
+}
+
+void
+Driver::stop()
+{
+   mRunning = false;
+
+   // Wake the GPU thread
+   gpu::awaken();
+}
+
+float
+Driver::getAverageFPS()
+{
+   static const auto second = std::chrono::duration_cast<duration_system_clock>(std::chrono::seconds{ 1 }).count();
+   auto frameTime = mAverageFrameTime.load(std::memory_order_relaxed);
+
+   if (frameTime <= 0.0) {
+      return 0.0f;
+   }
+
+   return static_cast<float>(second / frameTime);
+}
+
+void
+Driver::notifyCpuFlush(void *ptr,
+                       uint32_t size)
+{
+}
+
+void
+Driver::notifyGpuFlush(void *ptr,
+                       uint32_t size)
+{
+}
+
+void
+Driver::executeBuffer(pm4::Buffer *buffer)
+{
+   // Without a host GPU to wait on every packet has completed by the time
+   //  runCommandBuffer returns, so the buffer can be retired straight away.
+   runCommandBuffer(buffer->buffer, buffer->curSize);
+   gpu::retireCommandBuffer(buffer);
+}
+
+uint64_t
+Driver::getGpuClock()
+{
+   return coreinit::OSGetTime();
+}
+
+void
+Driver::writeValue(uint32_t addr,
+                   latte::CB_ENDIAN swap,
+                   uint64_t value,
+                   bool is32)
+{
+   switch (swap) {
+   case latte::CB_ENDIAN::NONE:
+      break;
+   case latte::CB_ENDIAN::SWAP_8IN64:
+      value = byte_swap(value);
+      break;
+   case latte::CB_ENDIAN::SWAP_8IN32:
+      value = byte_swap(static_cast<uint32_t>(value));
+      break;
+   case latte::CB_ENDIAN::SWAP_8IN16:
+      decaf_abort(fmt::format("Unexpected endian swap {}", swap));
+   }
+
+   if (is32) {
+      *mem::translate<uint32_t>(addr) = static_cast<uint32_t>(value);
+   } else {
+      *mem::translate<uint64_t>(addr) = value;
+   }
+}
+
+void
+Driver::decafSetBuffer(const pm4::DecafSetBuffer &data)
+{
+}
+
+void
+Driver::decafCopyColorToScan(const pm4::DecafCopyColorToScan &data)
+{
+}
+
+void
+Driver::decafSwapBuffers(const pm4::DecafSwapBuffers &data)
+{
+   static const auto weight = 0.9;
+
+   gx2::internal::onFlip();
+
+   auto now = std::chrono::system_clock::now();
+
+   if (mLastSwap.time_since_epoch().count()) {
+      auto frameTime = duration_system_clock { now - mLastSwap }.count();
+      auto average = mAverageFrameTime.load(std::memory_order_relaxed);
+
+      // Start from the first frame rather than decaying up from 0
+      if (average > 0.0) {
+         frameTime = weight * average + (1.0 - weight) * frameTime;
+      }
+
+      mAverageFrameTime.store(frameTime, std::memory_order_relaxed);
+   }
+
+   mLastSwap = now;
+}
+
+void
+Driver::decafCapSyncRegisters(const pm4::DecafCapSyncRegisters &data)
+{
+   pm4::captureSyncGpuRegisters(mRegisters.data(), static_cast<uint32_t>(mRegisters.size()));
+}
+
+void
+Driver::decafClearColor(const pm4::DecafClearColor &data)
+{
+}
+
+void
+Driver::decafClearDepthStencil(const pm4::DecafClearDepthStencil &data)
+{
+}
+
+void
+Driver::decafDebugMarker(const pm4::DecafDebugMarker &data)
+{
+   gLog->trace("GPU Debug Marker: {} {}", data.key.data(), data.id);
+}
+
+void
+Driver::decafOSScreenFlip(const pm4::DecafOSScreenFlip &data)
+{
+   decafSwapBuffers(pm4::DecafSwapBuffers {});
+}
+
+void
+Driver::decafCopySurface(const pm4::DecafCopySurface &data)
+{
+}
+
+void
+Driver::decafSetSwapInterval(const pm4::DecafSetSwapInterval &data)
+{
+   decaf_assert(data.interval <= 10, fmt::format("Bizarre swap interval {}", data.interval));
+}
+
+void
+Driver::drawIndexAuto(const pm4::DrawIndexAuto &data)
+{
+}
+
+void
+Driver::drawIndex2(const pm4::DrawIndex2 &data)
+{
+}
+
+void
+Driver::drawIndexImmd(const pm4::DrawIndexImmd &data)
+{
+}
+
+void
+Driver::memWrite(const pm4::MemWrite &data)
+{
+   auto value = uint64_t { 0 };
+
+   if (data.addrHi.CNTR_SEL() == pm4::MW_WRITE_CLOCK) {
+      value = getGpuClock();
+   } else {
+      value = static_cast<uint64_t>(data.dataLo) | static_cast<uint64_t>(data.dataHi) << 32;
+   }
+
+   writeValue(data.addrLo.ADDR_LO() << 2, data.addrLo.ENDIAN_SWAP(), value, data.addrHi.DATA32());
+}
+
+void
+Driver::eventWrite(const pm4::EventWrite &data)
+{
+   auto type = data.eventInitiator.EVENT_TYPE();
+   decaf_assert(data.addrHi.ADDR_HI() == 0, "Invalid event write address (high word not zero)");
+
+   switch (type) {
+   case latte::VGT_EVENT_TYPE::ZPASS_DONE:
+      // Nothing is rasterized, so no samples ever pass
+      writeValue(data.addrLo.ADDR_LO() << 2, data.addrLo.ENDIAN_SWAP(), 0, false);
+      break;
+   default:
+      decaf_abort(fmt::format("Unexpected event type {}", type));
+   }
+}
+
+void
+Driver::eventWriteEOP(const pm4::EventWriteEOP &data)
+{
+   auto value = uint64_t { 0 };
+
+   if (!data.eventInitiator.EVENT_TYPE()) {
+      return;
+   }
+
+   decaf_assert(data.addrHi.ADDR_HI() == 0, "Invalid event write address (high word not zero)");
+
+   switch (data.eventInitiator.EVENT_TYPE()) {
+   case latte::VGT_EVENT_TYPE::BOTTOM_OF_PIPE_TS:
+      value = getGpuClock();
+      break;
+   default:
+      decaf_abort(fmt::format("Unexpected EOP event type {}", data.eventInitiator.EVENT_TYPE()));
+   }
+
+   switch (data.addrHi.DATA_SEL()) {
+   case pm4::EWP_DATA_DISCARD:
+      break;
+   case pm4::EWP_DATA_32:
+      writeValue(data.addrLo.ADDR_LO() << 2, data.addrLo.ENDIAN_SWAP(), value, true);
+      break;
+   case pm4::EWP_DATA_64:
+   case pm4::EWP_DATA_CLOCK:
+      writeValue(data.addrLo.ADDR_LO() << 2, data.addrLo.ENDIAN_SWAP(), value, false);
+      break;
+   }
+}
+
+void
+Driver::pfpSyncMe(const pm4::PfpSyncMe &data)
+{
+}
+
+void
+Driver::streamOutBaseUpdate(const pm4::StreamOutBaseUpdate &data)
+{
+}
+
+void
+Driver::streamOutBufferUpdate(const pm4::StreamOutBufferUpdate &data)
+{
+   auto bufferIndex = data.control.SELECT_BUFFER();
+
+   if (data.control.STORE_BUFFER_FILLED_SIZE()) {
+      auto addr = data.dstLo;
+      decaf_assert(data.dstHi == 0, fmt::format("Store target out of 32-bit range for feedback buffer {}", bufferIndex));
+
+      if (addr != 0) {
+         *mem::translate<uint32_t>(addr) = byte_swap(mStreamOutOffsets[bufferIndex] >> 2);
+      }
+   }
+
+   switch (data.control.OFFSET_SOURCE()) {
+   case pm4::STRMOUT_OFFSET_FROM_PACKET:
+      decaf_assert(data.srcHi == 0, fmt::format("Offset out of 32-bit range for feedback buffer {}", bufferIndex));
+      mStreamOutOffsets[bufferIndex] = data.srcLo << 2;
+      break;
+   case pm4::STRMOUT_OFFSET_FROM_VGT_FILLED_SIZE:
+      break;
+   case pm4::STRMOUT_OFFSET_FROM_MEM:
+   {
+      decaf_assert(data.srcHi == 0, fmt::format("Load target out of 32-bit range for feedback buffer {}", bufferIndex));
+      auto offsetPtr = mem::translate<uint32_t>(data.srcLo);
+      decaf_assert(offsetPtr, fmt::format("Invalid load address for feedback buffer {}", bufferIndex));
+      mStreamOutOffsets[bufferIndex] = byte_swap(*offsetPtr) << 2;
+      break;
+   }
+   case pm4::STRMOUT_OFFSET_NONE:
+      break;
+   }
+}
+
+void
+Driver::surfaceSync(const pm4::SurfaceSync &data)
+{
+}
+
+void
+Driver::applyRegister(latte::Register reg)
+{
+}
+
+} // namespace null
+
+} // namespace gpu
@@ -0,0 +1,81 @@
+#pragma once
+#include "libdecaf/decaf_nullgraphicsdriver.h"
+#include "gpu/pm4_processor.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+namespace pm4
+{
+struct Buffer;
+}
+
+namespace gpu
+{
+
+namespace null
+{
+
+// Runs every packet of a command buffer so the guest sees the same memory
+//  writes, timestamps and flips as it would with a real backend, but never
+//  draws anything.
+class Driver : public decaf::NullGraphicsDriver, public Pm4Processor
+{
+public:
+   Driver();
+   virtual ~Driver() = default;
+
+   void run() override;
+   void stop() override;
+   float getAverageFPS() override;
+
+   void notifyCpuFlush(void *ptr, uint32_t size) override;
+   void notifyGpuFlush(void *ptr, uint32_t size) override;
+
+private:
+   void executeBuffer(pm4::Buffer *buffer);
+   uint64_t getGpuClock();
+   void writeValue(uint32_t addr, latte::CB_ENDIAN swap, uint64_t value, bool is32);
+
+   void decafSetBuffer(const pm4::DecafSetBuffer &data) override;
+   void decafCopyColorToScan(const pm4::DecafCopyColorToScan &data) override;
+   void decafSwapBuffers(const pm4::DecafSwapBuffers &data) override;
+   void decafCapSyncRegisters(const pm4::DecafCapSyncRegisters &data) override;
+   void decafClearColor(const pm4::DecafClearColor &data) override;
+   void decafClearDepthStencil(const pm4::DecafClearDepthStencil &data) override;
+   void decafDebugMarker(const pm4::DecafDebugMarker &data) override;
+   void decafOSScreenFlip(const pm4::DecafOSScreenFlip &data) override;
+   void decafCopySurface(const pm4::DecafCopySurface &data) override;
+   void decafSetSwapInterval(const pm4::DecafSetSwapInterval &data) override;
+   void drawIndexAuto(const pm4::DrawIndexAuto &data) override;
+   void drawIndex2(const pm4::DrawIndex2 &data) override;
+   void drawIndexImmd(const pm4::DrawIndexImmd &data) override;
+   void memWrite(const pm4::MemWrite &data) override;
+   void eventWrite(const pm4::EventWrite &data) override;
+   void eventWriteEOP(const pm4::EventWriteEOP &data) override;
+   void pfpSyncMe(const pm4::PfpSyncMe &data) override;
+   void streamOutBaseUpdate(const pm4::StreamOutBaseUpdate &data) override;
+   void streamOutBufferUpdate(const pm4::StreamOutBufferUpdate &data) override;
+   void surfaceSync(const pm4::SurfaceSync &data) override;
+   void applyRegister(latte::Register reg) override;
+
+private:
+   using duration_system_clock = std::chrono::duration<double, std::chrono::system_clock::period>;
+
+   std::atomic<bool> mRunning { false };
+
+   //! Offset of each stream out buffer, nothing is ever written to them so
+   //!  this only moves when the guest sets it
+   std::array<uint32_t, 4> mStreamOutOffsets;
+
+   std::chrono::time_point<std::chrono::system_clock> mLastSwap;
+
+   //! Average time between swaps in system_clock ticks, 0 until the second
+   //!  swap.  Written by the GPU thread and read by the debugger UI.
+   std::atomic<double> mAverageFrameTime { 0.0 };
+};
+
+} // namespace null
+
+} // namespace gpu
@@ -15,7 +15,10 @@ namespace opengl
 bool GLDriver::checkReadyDraw()
 {
    if (!checkActiveShader()) {
-      gLog->warn("Skipping draw with invalid shader.");
+      if (!mWaitingForShaders) {
+         gLog->warn("Skipping draw with invalid shader.");
+      }
+
       return false;
    }
 
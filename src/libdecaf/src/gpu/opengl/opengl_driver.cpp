@@ -2,6 +2,7 @@
 
 #include <common/decaf_assert.h>
 #include <common/log.h>
+#include "decaf.h"
 #include "decaf_config.h"
 #include "gpu/gpu_commandqueue.h"
 #include "gpu/latte_registers.h"
@@ -12,6 +13,7 @@
 #include "modules/gx2/gx2_enum.h"
 #include "opengl_constants.h"
 #include "opengl_driver.h"
+#include <algorithm>
 #include <fstream>
 #include <glbinding/gl/gl.h>
 #include <glbinding/Binding.h>
@@ -23,6 +25,9 @@ namespace gpu
 namespace opengl
 {
 
+static const unsigned
+MaxShaderTranslationThreads = 4;
+
 GLDriver::GLDriver()
 {
    mRegisters.fill(0);
@@ -76,6 +81,16 @@ GLDriver::initGL()
    gl::GLint value;
    gl::glGetIntegerv(gl::GL_MAX_UNIFORM_BLOCK_SIZE, &value);
    MaxUniformBlockSize = value;
+
+   if (decaf::config::gpu::shader_cache) {
+      mShaderCache.open(decaf::makeConfigPath("shader_cache.bin"));
+   }
+
+   if (static_cast<AsyncShaderMode>(decaf::config::gpu::async_shaders) != AsyncShaderMode::Disabled) {
+      auto numThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+      numThreads = std::min(numThreads, MaxShaderTranslationThreads);
+      mShaderTranslationPool = std::make_unique<WorkerPool>("Shader Translation", numThreads);
+   }
 }
 
 void
@@ -345,8 +360,6 @@ GLDriver::surfaceSync(const pm4::SurfaceSync &data)
       shaderExport = true;
    }
 
-   std::unique_lock<std::mutex> lock(mResourceMap.getMutex());
-
    auto iter = mResourceMap.getIterator(memStart, memEnd - memStart);
 
    Resource *resource;
@@ -356,27 +369,24 @@ GLDriver::surfaceSync(const pm4::SurfaceSync &data)
       case Resource::SURFACE:
          if (surfaces) {
             auto surface = reinterpret_cast<SurfaceBuffer *>(resource);
-            surface->needUpload |= surface->dirtyMemory;
-            surface->dirtyMemory = false;
+            surface->needUpload |= surface->dirtyMemory.exchange(false);
          }
          break;
 
       case Resource::SHADER:
          if (shaders) {
             auto shader = reinterpret_cast<Shader *>(resource);
-            shader->needRebuild |= shader->dirtyMemory;
-            shader->dirtyMemory = false;
+            shader->needRebuild |= shader->dirtyMemory.exchange(false);
          }
          break;
 
       case Resource::DATA_BUFFER:
          if (shaders || surfaces) {
             auto buffer = reinterpret_cast<DataBuffer *>(resource);
-            if (buffer->isInput && buffer->dirtyMemory) {
+            if (buffer->isInput && buffer->dirtyMemory.exchange(false)) {
                auto offset = std::max(memStart, buffer->cpuMemStart) - buffer->cpuMemStart;
                auto size = (std::min(memEnd, buffer->cpuMemEnd) - buffer->cpuMemStart) - offset;
                uploadDataBuffer(buffer, offset, size);
-               buffer->dirtyMemory = false;
             }
          }
       }
@@ -650,13 +660,20 @@ void
 GLDriver::notifyCpuFlush(void *ptr,
                          uint32_t size)
 {
-   std::unique_lock<std::mutex> lock(mResourceMap.getMutex());
-
-   auto iter = mResourceMap.getIterator(mem::untranslate(ptr), size);
+   // Neither iterating the resource map nor marking resources dirty takes a
+   //  lock, surfaceSync consumes the dirty flag with an exchange so a flush
+   //  landing while it runs is never lost.
+   auto memStart = mem::untranslate(ptr);
+   auto memEnd = memStart + size;
+   auto iter = mResourceMap.getIterator(memStart, size);
 
    Resource *resource;
    while ((resource = iter.next()) != nullptr) {
-      resource->dirtyMemory = true;
+      auto dirtyOffset = std::max(memStart, resource->cpuMemStart) - resource->cpuMemStart;
+      auto dirtySize = (std::min(memEnd, resource->cpuMemEnd) - resource->cpuMemStart) - dirtyOffset;
+
+      resource->cpuMemHash.markDirty(dirtyOffset, dirtySize);
+      resource->dirtyMemory.store(true);
    }
 }
 
@@ -664,34 +681,23 @@ void
 GLDriver::notifyGpuFlush(void *ptr,
                          uint32_t size)
 {
-   std::unique_lock<std::mutex> lock(mOutputBufferMap.getMutex());
-
    auto memStart = mem::untranslate(ptr);
    auto memEnd = memStart + size;
    auto iter = mOutputBufferMap.getIterator(memStart, size);
 
-   // This allows us to avoid downloading a buffer twice if we hit both its
-   //  endpoints in the scan (as will happen if memStart/memEnd coincide
-   //  with a buffer's range).
-   auto flushStamp = ++mGpuFlushCounter;
-
    Resource *resource;
    while ((resource = iter.next()) != nullptr) {
       decaf_check(resource->type == Resource::DATA_BUFFER);
       DataBuffer *buffer = reinterpret_cast<DataBuffer *>(resource);
 
-      if (buffer->lastGpuFlush != flushStamp) {
-         buffer->lastGpuFlush = flushStamp;
+      auto copyOffset = std::max(memStart, buffer->cpuMemStart) - buffer->cpuMemStart;
+      auto copySize = (std::min(memEnd, buffer->cpuMemEnd) - buffer->cpuMemStart) - copyOffset;
 
-         auto copyOffset = std::max(memStart, buffer->cpuMemStart) - buffer->cpuMemStart;
-         auto copySize = (std::min(memEnd, buffer->cpuMemEnd) - buffer->cpuMemStart) - copyOffset;
+      runOnGLThread([=](){
+         downloadDataBuffer(buffer, copyOffset, copySize);
+      });
 
-         runOnGLThread([=](){
-            downloadDataBuffer(buffer, copyOffset, copySize);
-         });
-
-         buffer->dirtyMemory = false;
-      }
+      buffer->dirtyMemory = false;
    }
 }
 
@@ -11,10 +11,12 @@
 #include "libdecaf/decaf_graphics.h"
 #include "libdecaf/decaf_opengl.h"
 #include "opengl_resource.h"
+#include "opengl_shadercache.h"
 
 #include <chrono>
 #include <common/log.h>
 #include <common/platform.h>
+#include <common/workerpool.h>
 #include <condition_variable>
 #include <exception>
 #include <glbinding/gl/gl.h>
@@ -22,6 +24,7 @@
 #include <libcpu/mem.h>
 #include <list>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
@@ -41,6 +44,16 @@ enum class SurfaceUseState : uint32_t
    GpuWritten
 };
 
+//! Values of decaf::config::gpu::async_shaders
+enum class AsyncShaderMode : int
+{
+   Disabled = 0,
+   SkipDraws = 1,
+   PreviousShaders = 2
+};
+
+struct ShaderTranslation;
+
 struct AttribBufferCache
 {
    gl::GLuint object = 0;
@@ -169,7 +182,6 @@ struct DataBuffer : public Resource
    bool isInput = false;  // Uniform or attribute buffers
    bool isOutput = false;  // Transform feedback buffers
    bool dirtyMap = false;  // True if we need to glFlushMappedBufferRange
-   uint32_t lastGpuFlush = 0;  // Last time we touched this buffer in notifyGpuFlush()
 
    DataBuffer() : Resource(Resource::DATA_BUFFER) { }
 };
@@ -432,27 +444,18 @@ private:
    void
    endTransformFeedback();
 
-   int
-   countModifiedUniforms(latte::Register firstReg,
-                         uint32_t lastUniformUpdate);
-
-   bool
-   parseFetchShader(FetchShader &shader,
-                    void *buffer,
-                    size_t size);
+   std::shared_ptr<ShaderTranslation>
+   getShaderTranslation(const ShaderPipelineKey &key,
+                        FetchShader &fetch,
+                        VertexShader *vertex,
+                        bool translatePixel);
 
    bool
-   compileVertexShader(VertexShader &vertex,
-                       FetchShader &fetch,
-                       uint8_t *buffer,
-                       size_t size,
-                       bool isScreenSpace);
+   usePreviousShaders();
 
-   bool
-   compilePixelShader(PixelShader &pixel,
-                      VertexShader &vertex,
-                      uint8_t *buffer,
-                      size_t size);
+   int
+   countModifiedUniforms(latte::Register firstReg,
+                         uint32_t lastUniformUpdate);
 
    void
    injectFence(std::function<void()> func);
@@ -496,12 +499,23 @@ private:
    std::unordered_map<uint64_t, VertexShader *> mVertexShaders;
    std::unordered_map<uint64_t, PixelShader *> mPixelShaders;
    std::map<ShaderPipelineKey, ShaderPipeline> mShaderPipelines;
+   ShaderCache mShaderCache;
+
+   //! Translations which have been started but not yet picked up by a draw
+   std::map<ShaderPipelineKey, std::shared_ptr<ShaderTranslation>> mShaderTranslations;
+
+   //! Only created when async_shaders is enabled, declared after everything
+   //!  its tasks use so that it is destroyed first
+   std::unique_ptr<WorkerPool> mShaderTranslationPool;
+
+   //! Set when the last draw was skipped while its shaders were translated
+   bool mWaitingForShaders = false;
+
    std::unordered_map<uint64_t, SurfaceBuffer> mSurfaces;
    std::unordered_map<uint32_t, DataBuffer> mDataBuffers;
 
    ResourceMemoryMap mResourceMap;
    ResourceMemoryMap mOutputBufferMap;
-   uint32_t mGpuFlushCounter = 0;
 
    std::array<Sampler, latte::MaxSamplers> mVertexSamplers;
    std::array<Sampler, latte::MaxSamplers> mPixelSamplers;
@@ -1,7 +1,10 @@
 #ifndef DECAF_NOGL
 
 #include <common/decaf_assert.h>
+#include <common/murmur3.h>
 #include "opengl_resource.h"
+#include <algorithm>
+#include <thread>
 
 namespace gpu
 {
@@ -9,9 +12,145 @@ namespace gpu
 namespace opengl
 {
 
+const uint32_t
+ChunkedMemoryHash::ChunkSize;
+
+void
+ChunkedMemoryHash::markDirty(uint32_t offset,
+                             uint32_t size)
+{
+   std::unique_lock<std::mutex> lock(mMutex);
+
+   // Chunks past the end of the table are always rehashed once the region
+   //  grows to include them.
+   auto firstChunk = offset / ChunkSize;
+   auto endChunk = std::min<size_t>((offset + size + ChunkSize - 1) / ChunkSize, mChunks.size());
+
+   for (auto i = firstChunk; i < endChunk; ++i) {
+      mChunks[i].dirty = true;
+      mAnyDirty = true;
+   }
+}
+
+bool
+ChunkedMemoryHash::update(const uint8_t *memory,
+                          uint32_t size,
+                          uint32_t *changedStart,
+                          uint32_t *changedEnd)
+{
+   std::unique_lock<std::mutex> lock(mMutex);
+
+   if (size != mSize) {
+      // The last chunk of the old size may have been partial, so it must be
+      //  rehashed along with any new chunks.
+      auto numChunks = (size + ChunkSize - 1) / ChunkSize;
+      auto keepChunks = std::min(mSize, size) / ChunkSize;
+
+      mChunks.resize(numChunks);
+
+      for (auto i = keepChunks; i < numChunks; ++i) {
+         mChunks[i].valid = false;
+         mChunks[i].dirty = true;
+      }
+
+      mAnyDirty = mAnyDirty || (keepChunks < numChunks);
+      mSize = size;
+   }
+
+   if (!mAnyDirty) {
+      return false;
+   }
+
+   auto firstChanged = mChunks.size();
+   auto lastChanged = size_t { 0 };
+
+   for (auto i = size_t { 0 }; i < mChunks.size(); ++i) {
+      auto &chunk = mChunks[i];
+
+      if (!chunk.dirty) {
+         continue;
+      }
+
+      auto offset = static_cast<uint32_t>(i * ChunkSize);
+      auto chunkSize = std::min<uint32_t>(ChunkSize, size - offset);
+
+      uint64_t newHash[2] = { 0, 0 };
+      MurmurHash3_x64_128(memory + offset, chunkSize, 0, newHash);
+      chunk.dirty = false;
+
+      if (chunk.valid && newHash[0] == chunk.hash[0] && newHash[1] == chunk.hash[1]) {
+         continue;
+      }
+
+      chunk.hash[0] = newHash[0];
+      chunk.hash[1] = newHash[1];
+      chunk.valid = true;
+
+      firstChanged = std::min(firstChanged, i);
+      lastChanged = i;
+   }
+
+   mAnyDirty = false;
+
+   if (firstChanged == mChunks.size()) {
+      return false;
+   }
+
+   if (changedStart) {
+      *changedStart = static_cast<uint32_t>(firstChanged * ChunkSize);
+   }
+
+   if (changedEnd) {
+      *changedEnd = std::min<uint32_t>(static_cast<uint32_t>((lastChanged + 1) * ChunkSize), size);
+   }
+
+   return true;
+}
+
 ResourceMemoryMap::ResourceMemoryMap()
-   : mCounter(0)
+   : mIndex(std::make_shared<Index>())
+{
+}
+
+uint32_t
+ResourceMemoryMap::buildMaxEnd(Index &index,
+                               size_t lo,
+                               size_t hi)
 {
+   if (lo >= hi) {
+      return 0;
+   }
+
+   // Must split ranges the same way as ResourceMemoryMap::Iterator::next
+   auto mid = lo + (hi - lo) / 2;
+   auto result = index.entries[mid].end;
+   result = std::max(result, buildMaxEnd(index, lo, mid));
+   result = std::max(result, buildMaxEnd(index, mid + 1, hi));
+   index.maxEnd[mid] = result;
+   return result;
+}
+
+void
+ResourceMemoryMap::publishIndex(std::shared_ptr<Index> index,
+                                bool waitForReaders)
+{
+   index->maxEnd.resize(index->entries.size());
+   buildMaxEnd(*index, 0, index->entries.size());
+
+   auto oldIndex = std::atomic_exchange(&mIndex, std::shared_ptr<const Index> { std::move(index) });
+
+   // No new iterator can see the old index now, so once every existing
+   //  iterator has released it nobody can see a removed resource.
+   //  use_count() is only a relaxed load, the fence pairs with the release
+   //  of the last iterator's reference so everything it did happens before
+   //  the caller frees the resource.
+   if (waitForReaders) {
+      while (oldIndex.use_count() > 1) {
+         std::this_thread::yield();
+      }
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+   }
 }
 
 void
@@ -23,21 +162,20 @@ ResourceMemoryMap::addResource(Resource *resource)
       return;
    }
 
-   // mCounter serves to differentiate multiple resources with the same
-   //  start or end address.
-   auto counter = mCounter++;
-   auto keyStart = static_cast<uint64_t>(resource->cpuMemStart) << 32 | counter;
-   auto keyEnd = static_cast<uint64_t>(resource->cpuMemEnd - 1) << 32 | counter;
-   mKnownResources[resource] = counter;
-
-   // We insert entries for both the start (first byte) and end (last byte)
-   //  of the resource.  Then in markDirty(), we can simply set the dirty
-   //  flag on every resource with at least one key (region endpoint) in
-   //  the dirty region.
-   decaf_check(mMemoryMap.find(keyStart) == mMemoryMap.end());
-   mMemoryMap[keyStart] = resource;
-   decaf_check(mMemoryMap.find(keyEnd) == mMemoryMap.end());
-   mMemoryMap[keyEnd] = resource;
+   mKnownResources[resource] = resource->cpuMemStart;
+
+   auto &oldEntries = mIndex->entries;
+   auto pos = std::upper_bound(oldEntries.begin(), oldEntries.end(), resource->cpuMemStart,
+                               [](uint32_t start, const Entry &entry) {
+                                  return start < entry.start;
+                               });
+
+   auto index = std::make_shared<Index>();
+   index->entries.reserve(oldEntries.size() + 1);
+   index->entries.insert(index->entries.end(), oldEntries.begin(), pos);
+   index->entries.push_back(Entry { resource->cpuMemStart, resource->cpuMemEnd, resource });
+   index->entries.insert(index->entries.end(), pos, oldEntries.end());
+   publishIndex(std::move(index), false);
 }
 
 void
@@ -47,15 +185,25 @@ ResourceMemoryMap::removeResource(Resource *resource)
 
    auto knownIter = mKnownResources.find(resource);
    decaf_check(knownIter != mKnownResources.end());
-   auto counter = knownIter->second;
+   auto start = knownIter->second;
    mKnownResources.erase(knownIter);
-   auto keyStart = static_cast<uint64_t>(resource->cpuMemStart) << 32 | counter;
-   auto keyEnd = static_cast<uint64_t>(resource->cpuMemEnd - 1) << 32 | counter;
 
-   decaf_check(mMemoryMap.find(keyStart) != mMemoryMap.end());
-   mMemoryMap.erase(keyStart);
-   decaf_check(mMemoryMap.find(keyEnd) != mMemoryMap.end());
-   mMemoryMap.erase(keyEnd);
+   auto &oldEntries = mIndex->entries;
+   auto range = std::equal_range(oldEntries.begin(), oldEntries.end(), Entry { start, 0, nullptr },
+                                 [](const Entry &lhs, const Entry &rhs) {
+                                    return lhs.start < rhs.start;
+                                 });
+   auto pos = std::find_if(range.first, range.second,
+                           [&](const Entry &entry) {
+                              return entry.resource == resource;
+                           });
+   decaf_check(pos != range.second);
+
+   auto index = std::make_shared<Index>();
+   index->entries.reserve(oldEntries.size() - 1);
+   index->entries.insert(index->entries.end(), oldEntries.begin(), pos);
+   index->entries.insert(index->entries.end(), pos + 1, oldEntries.end());
+   publishIndex(std::move(index), true);
 }
 
 } // namespace opengl
@@ -2,9 +2,14 @@
 
 #ifndef DECAF_NOGL
 
-#include <map>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace gpu
 {
@@ -12,6 +17,43 @@ namespace gpu
 namespace opengl
 {
 
+// Hashes a memory region in page sized chunks so that checking whether the
+//  region has changed only has to hash the chunks which were touched by a
+//  CPU flush since the last check, rather than the whole region.
+class ChunkedMemoryHash
+{
+public:
+   static const uint32_t ChunkSize = 4096;
+
+   // Marks the chunks overlapping [offset, offset + size) as needing to be
+   //  rehashed, offsets are relative to the start of the region.
+   void
+   markDirty(uint32_t offset,
+             uint32_t size);
+
+   // Rehashes the dirty chunks of the region [memory, memory + size) and
+   //  returns true if any of them changed.  If changedStart and changedEnd
+   //  are given, they are set to the byte range covering every changed chunk.
+   bool
+   update(const uint8_t *memory,
+          uint32_t size,
+          uint32_t *changedStart = nullptr,
+          uint32_t *changedEnd = nullptr);
+
+private:
+   struct Chunk
+   {
+      uint64_t hash[2];
+      bool valid;
+      bool dirty;
+   };
+
+   std::mutex mMutex;
+   std::vector<Chunk> mChunks;
+   uint32_t mSize = 0;
+   bool mAnyDirty = false;
+};
+
 struct Resource
 {
    //! The start of the CPU memory region this occupies
@@ -21,10 +63,11 @@ struct Resource
    uint32_t cpuMemEnd;
 
    //! Hash of the memory contents, for detecting changes
-   uint64_t cpuMemHash[2] = { 0, 0 };
+   ChunkedMemoryHash cpuMemHash;
 
-   //! True if a DCFlush has been received for the memory region
-   bool dirtyMemory = true;
+   //! True if a DCFlush has been received for the memory region, set by CPU
+   //!  flushes on any core and consumed by the GPU thread without a lock
+   std::atomic<bool> dirtyMemory { true };
 
    //! The type of resource (poor man's RTTI for surfaceSync())
    enum Type {
@@ -37,37 +80,91 @@ struct Resource
 };
 
 // Manages data ranges associated with resources for efficient querying by
-//  address.  addResource() and removeResource() lock the object for the
-//  duration of the call.
+//  address.
+//
+// The ranges are kept in an immutable array sorted by start address, with
+//  the maximum end address of each subtree of an implicit binary tree over
+//  the array, so finding every resource overlapping a range takes
+//  O(log n + k).  addResource() and removeResource() build a new array under
+//  the lock and publish it atomically, so iterating never takes the lock.
+//  removeResource() waits for any iterator which may still see the removed
+//  resource, so the caller may free it as soon as the call returns.
 class ResourceMemoryMap
 {
+   struct Entry
+   {
+      uint32_t start;
+      uint32_t end;
+      Resource *resource;
+   };
+
+   struct Index
+   {
+      std::vector<Entry> entries;
+
+      //! Largest end address in the subtree rooted at each entry
+      std::vector<uint32_t> maxEnd;
+   };
+
 public:
 
    class Iterator
    {
    public:
       Iterator(const ResourceMemoryMap &map, uint32_t start, uint32_t size)
-         : mMap(map),
-           mKeyStart(static_cast<uint64_t>(start) << 32),
-           mKeyEnd(static_cast<uint64_t>(start + size) << 32),
-           mMapIter(mMap.mMemoryMap.lower_bound(mKeyStart))
+         : mIndex(std::atomic_load(&map.mIndex)),
+           mStart(start),
+           mEnd(static_cast<uint64_t>(start) + size)
       {
+         pushRange(0, mIndex->entries.size());
       }
 
       Resource *next()
       {
-         if (mMapIter != mMap.mMemoryMap.end() && mMapIter->first < mKeyEnd) {
-            return (mMapIter++)->second;
-         } else {
-            return nullptr;
+         while (mStackSize) {
+            auto range = mStack[--mStackSize];
+            auto lo = range.first;
+            auto hi = range.second;
+            auto mid = lo + (hi - lo) / 2;
+
+            // Nothing in this subtree ends after the start of the query
+            if (mIndex->maxEnd[mid] <= mStart) {
+               continue;
+            }
+
+            pushRange(lo, mid);
+
+            auto &entry = mIndex->entries[mid];
+
+            // Entries to the right start no earlier than this one
+            if (entry.start < mEnd) {
+               pushRange(mid + 1, hi);
+
+               if (entry.end > mStart) {
+                  return entry.resource;
+               }
+            }
          }
+
+         return nullptr;
       }
 
    private:
-      const ResourceMemoryMap &mMap;
-      uint64_t mKeyStart;
-      uint64_t mKeyEnd;
-      std::map<uint64_t, Resource *>::const_iterator mMapIter;
+      void pushRange(size_t lo, size_t hi)
+      {
+         if (lo < hi) {
+            mStack[mStackSize++] = { lo, hi };
+         }
+      }
+
+   private:
+      std::shared_ptr<const Index> mIndex;
+      uint64_t mStart;
+      uint64_t mEnd;
+
+      // At most one pending range per level of the tree
+      std::array<std::pair<size_t, size_t>, 64> mStack;
+      size_t mStackSize = 0;
    };
 
    ResourceMemoryMap();
@@ -78,23 +175,26 @@ public:
    void
    removeResource(Resource *resource);
 
-   std::mutex &
-   getMutex()
-   {
-      return mMutex;
-   }
-
    Iterator
    getIterator(uint32_t start, uint32_t size)
    {
       return Iterator(*this, start, size);
    }
 
+private:
+   static uint32_t
+   buildMaxEnd(Index &index,
+               size_t lo,
+               size_t hi);
+
+   void
+   publishIndex(std::shared_ptr<Index> index,
+                bool waitForReaders);
+
 private:
    std::mutex mMutex;
    std::unordered_map<Resource *, uint32_t> mKnownResources;
-   std::map<uint64_t, Resource *> mMemoryMap;
-   uint32_t mCounter;
+   std::shared_ptr<const Index> mIndex;
 };
 
 } // namespace opengl
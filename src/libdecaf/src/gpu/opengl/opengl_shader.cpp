@@ -7,12 +7,15 @@
 #include "gpu/microcode/latte_disassembler.h"
 #include "opengl_constants.h"
 #include "opengl_driver.h"
+#include "opengl_shader.h"
 
+#include <algorithm>
 #include <common/decaf_assert.h>
 #include <common/log.h>
 #include <common/murmur3.h>
 #include <common/platform_dir.h>
 #include <common/strutils.h>
+#include <cstring>
 #include <fstream>
 #include <glbinding/gl/gl.h>
 #include <libcpu/mem.h>
@@ -38,6 +41,16 @@ static const auto BUFFER_PADDING = 16;
 //  have different strides than others.
 static const auto NVIDIA_GLSL_WORKAROUND = true;
 
+// The shader translation only reads registers through this, so that it can
+//  be run on register state which did not come from a GLDriver.
+template<typename Type>
+static Type
+getRegister(const Pm4Processor::Registers &registers,
+            uint32_t id)
+{
+   static_assert(sizeof(Type) == 4, "Register storage must be a uint32_t");
+   return *reinterpret_cast<const Type *>(&registers[id / 4]);
+}
 
 static void
 dumpRawShader(const std::string &type, ppcaddr_t data, uint32_t size, bool isSubroutine = false)
@@ -135,13 +148,10 @@ invalidateShaderIfChanged(ShaderPtrType &shader,
    }
 
    // Check whether the shader has actually changed; we want to avoid
-   //  recompiling shaders if possible, since that's very slow.
-   //  Note that we don't save this, which means we have to compute it
-   //  twice if we end up recreating the shader, but that cost is tiny
-   //  compared to the time it takes to actually create the shader.
-   uint64_t newHash[2] = { 0, 0 };
-   MurmurHash3_x64_128(mem::translate(shader->cpuMemStart), shader->cpuMemEnd - shader->cpuMemStart, 0, newHash);
-   if (newHash[0] == shader->cpuMemHash[0] && newHash[1] == shader->cpuMemHash[1]) {
+   //  recompiling shaders if possible, since that's very slow.  Only the
+   //  parts of the shader which were flushed since the last check are
+   //  rehashed.
+   if (!shader->cpuMemHash.update(mem::translate(shader->cpuMemStart), shader->cpuMemEnd - shader->cpuMemStart)) {
       shader->needRebuild = false;
       return false;
    }
@@ -167,6 +177,8 @@ invalidateShaderIfChanged(ShaderPtrType &shader,
 
 bool GLDriver::checkActiveShader()
 {
+   mWaitingForShaders = false;
+
    auto pgm_start_fs = getRegister<latte::SQ_PGM_START_FS>(latte::Register::SQ_PGM_START_FS);
    auto pgm_start_vs = getRegister<latte::SQ_PGM_START_VS>(latte::Register::SQ_PGM_START_VS);
    auto pgm_start_ps = getRegister<latte::SQ_PGM_START_PS>(latte::Register::SQ_PGM_START_PS);
@@ -292,9 +304,8 @@ bool GLDriver::checkActiveShader()
          fetchShader = new FetchShader {};
          fetchShader->cpuMemStart = fsPgmAddress;
          fetchShader->cpuMemEnd = fsPgmAddress + fsPgmSize;
-         MurmurHash3_x64_128(mem::translate(fetchShader->cpuMemStart),
-                             fetchShader->cpuMemEnd - fetchShader->cpuMemStart,
-                             0, fetchShader->cpuMemHash);
+         fetchShader->cpuMemHash.update(mem::translate(fetchShader->cpuMemStart),
+                                        fetchShader->cpuMemEnd - fetchShader->cpuMemStart);
          fetchShader->dirtyMemory = false;
          mResourceMap.addResource(fetchShader);
 
@@ -358,31 +369,58 @@ bool GLDriver::checkActiveShader()
          }
       }
 
+      auto &vertexShader = mVertexShaders[vsShaderKey];
+      invalidateShaderIfChanged(vertexShader, vsShaderKey, mVertexShaders, mResourceMap);
+
+      PixelShader **pixelShaderEntry = nullptr;
+
+      if (!pa_cl_clip_cntl.RASTERISER_DISABLE()) {
+         pixelShaderEntry = &mPixelShaders[psShaderKey];
+         invalidateShaderIfChanged(*pixelShaderEntry, psShaderKey, mPixelShaders, mResourceMap);
+      }
+
+      // Translate whichever shaders are missing, this may happen on the
+      //  shader translation pool in which case we might have to come back
+      //  on a later draw to pick up the result.
+      auto translation = std::shared_ptr<ShaderTranslation> { };
+      auto needPixelShader = pixelShaderEntry && !*pixelShaderEntry;
+
+      if (!vertexShader || needPixelShader) {
+         translation = getShaderTranslation(shaderKey, *fetchShader, vertexShader, needPixelShader);
+
+         if (!translation) {
+            return usePreviousShaders();
+         }
+
+         if (!translation->success) {
+            gLog->error("Failed to translate shaders");
+            return false;
+         }
+      }
+
       pipeline.fetch = fetchShader;
       pipeline.fetch->refCount++;
       pipeline.fetchKey = fsShaderKey;
 
       // Compile vertex shader if needed
-      auto &vertexShader = mVertexShaders[vsShaderKey];
-      invalidateShaderIfChanged(vertexShader, vsShaderKey, mVertexShaders, mResourceMap);
-
       if (!vertexShader) {
          vertexShader = new VertexShader;
 
          vertexShader->cpuMemStart = vsPgmAddress;
          vertexShader->cpuMemEnd = vsPgmAddress + vsPgmSize;
-         MurmurHash3_x64_128(mem::translate(vertexShader->cpuMemStart),
-                             vertexShader->cpuMemEnd - vertexShader->cpuMemStart,
-                             0, vertexShader->cpuMemHash);
+         vertexShader->cpuMemHash.update(mem::translate(vertexShader->cpuMemStart),
+                                         vertexShader->cpuMemEnd - vertexShader->cpuMemStart);
          vertexShader->dirtyMemory = false;
          mResourceMap.addResource(vertexShader);
 
          dumpRawShader("vertex", vsPgmAddress, vsPgmSize);
 
-         if (!compileVertexShader(*vertexShader, *fetchShader, mem::translate(vsPgmAddress), vsPgmSize, isScreenSpace)) {
-            gLog->error("Failed to recompile vertex shader");
-            return false;
-         }
+         vertexShader->isScreenSpace = translation->vertex.isScreenSpace;
+         vertexShader->outputMap = translation->vertex.outputMap;
+         vertexShader->usedUniformBlocks = translation->vertex.usedUniformBlocks;
+         vertexShader->usedFeedbackBuffers = translation->vertex.usedFeedbackBuffers;
+         vertexShader->code = std::move(translation->vertex.code);
+         vertexShader->disassembly = std::move(translation->vertex.disassembly);
 
          dumpTranslatedShader("vertex", vsPgmAddress, vertexShader->code);
 
@@ -400,6 +438,12 @@ bool GLDriver::checkActiveShader()
 
          if (!isLinked) {
             auto log = getProgramLog(vertexShader->object);
+
+            if (vertexShader->disassembly.empty()) {
+               // Translations loaded from the shader cache have no disassembly
+               vertexShader->disassembly = latte::disassemble(gsl::make_span(translation->vertexBinary));
+            }
+
             gLog->error("OpenGL failed to compile vertex shader:\n{}", log);
             gLog->error("Fetch Disassembly:\n{}\n", fetchShader->disassembly);
             gLog->error("Shader Disassembly:\n{}\n", vertexShader->disassembly);
@@ -432,26 +476,24 @@ bool GLDriver::checkActiveShader()
       } else {
 
          // Transform feedback disabled; compile pixel shader if needed
-         auto &pixelShader = mPixelShaders[psShaderKey];
-         invalidateShaderIfChanged(pixelShader, psShaderKey, mPixelShaders, mResourceMap);
+         auto &pixelShader = *pixelShaderEntry;
 
          if (!pixelShader) {
             pixelShader = new PixelShader;
 
             pixelShader->cpuMemStart = psPgmAddress;
             pixelShader->cpuMemEnd = psPgmAddress + psPgmSize;
-            MurmurHash3_x64_128(mem::translate(pixelShader->cpuMemStart),
-                                pixelShader->cpuMemEnd - pixelShader->cpuMemStart,
-                                0, pixelShader->cpuMemHash);
+            pixelShader->cpuMemHash.update(mem::translate(pixelShader->cpuMemStart),
+                                           pixelShader->cpuMemEnd - pixelShader->cpuMemStart);
             pixelShader->dirtyMemory = false;
             mResourceMap.addResource(pixelShader);
 
             dumpRawShader("pixel", psPgmAddress, psPgmSize);
 
-            if (!compilePixelShader(*pixelShader, *vertexShader, mem::translate(psPgmAddress), psPgmSize)) {
-               gLog->error("Failed to recompile pixel shader");
-               return false;
-            }
+            pixelShader->samplerUsage = translation->pixel.samplerUsage;
+            pixelShader->usedUniformBlocks = translation->pixel.usedUniformBlocks;
+            pixelShader->code = std::move(translation->pixel.code);
+            pixelShader->disassembly = std::move(translation->pixel.disassembly);
 
             dumpTranslatedShader("pixel", psPgmAddress, pixelShader->code);
 
@@ -470,6 +512,12 @@ bool GLDriver::checkActiveShader()
 
             if (!isLinked) {
                auto log = getProgramLog(pixelShader->object);
+
+               if (pixelShader->disassembly.empty()) {
+                  // Translations loaded from the shader cache have no disassembly
+                  pixelShader->disassembly = latte::disassemble(gsl::make_span(translation->pixelBinary));
+               }
+
                gLog->error("OpenGL failed to compile pixel shader:\n{}", log);
                gLog->error("Shader Disassembly:\n{}\n", pixelShader->disassembly);
                gLog->error("Shader Code:\n{}\n", pixelShader->code);
@@ -522,6 +570,100 @@ bool GLDriver::checkActiveShader()
    return true;
 }
 
+// Checks that a finished translation is still usable for a draw, the shader
+//  binaries may have been overwritten while it was running.
+static bool
+isShaderTranslationCurrent(const ShaderTranslation &translation,
+                           VertexShader *vertex,
+                           bool translatePixel)
+{
+   if (!vertex && !translation.translateVertex) {
+      return false;
+   }
+
+   if (translatePixel && !translation.translatePixel) {
+      return false;
+   }
+
+   if (translation.translateVertex) {
+      auto pgm_start_vs = getRegister<latte::SQ_PGM_START_VS>(*translation.registers, latte::Register::SQ_PGM_START_VS);
+      auto vsPgmData = mem::translate(pgm_start_vs.PGM_START() << 8);
+
+      if (std::memcmp(vsPgmData, translation.vertexBinary.data(), translation.vertexBinary.size()) != 0) {
+         return false;
+      }
+   }
+
+   if (translation.translatePixel) {
+      auto pgm_start_ps = getRegister<latte::SQ_PGM_START_PS>(*translation.registers, latte::Register::SQ_PGM_START_PS);
+      auto psPgmData = mem::translate(pgm_start_ps.PGM_START() << 8);
+
+      if (std::memcmp(psPgmData, translation.pixelBinary.data(), translation.pixelBinary.size()) != 0) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+// Returns the finished translation of the shaders for key, or nullptr if it
+//  is still running on the shader translation pool.
+std::shared_ptr<ShaderTranslation>
+GLDriver::getShaderTranslation(const ShaderPipelineKey &key,
+                               FetchShader &fetch,
+                               VertexShader *vertex,
+                               bool translatePixel)
+{
+   auto &translation = mShaderTranslations[key];
+
+   if (translation && translation->complete && !isShaderTranslationCurrent(*translation, vertex, translatePixel)) {
+      translation = nullptr;
+   }
+
+   if (!translation) {
+      translation = createShaderTranslation(mRegisters, fetch, vertex, translatePixel);
+
+      if (mShaderTranslationPool) {
+         auto job = translation;
+         mShaderTranslationPool->run([this, job]() {
+            runShaderTranslation(*job, mShaderCache);
+         });
+      } else {
+         runShaderTranslation(*translation, mShaderCache);
+      }
+   }
+
+   if (!translation->complete) {
+      return nullptr;
+   }
+
+   auto result = translation;
+
+   // Failed translations are kept so they are not retried on every draw
+   if (result->success) {
+      mShaderTranslations.erase(key);
+   }
+
+   return result;
+}
+
+// Called when a draw's shaders are still being translated, either skips the
+//  draw or binds the previous pipeline depending on async_shaders.
+bool
+GLDriver::usePreviousShaders()
+{
+   auto mode = static_cast<AsyncShaderMode>(decaf::config::gpu::async_shaders);
+
+   if (mode != AsyncShaderMode::PreviousShaders || !mActiveShader || !mActiveShader->object) {
+      mWaitingForShaders = true;
+      return false;
+   }
+
+   gl::glBindVertexArray(mActiveShader->fetch->object);
+   gl::glBindProgramPipeline(mActiveShader->object);
+   return true;
+}
+
 int
 GLDriver::countModifiedUniforms(latte::Register firstReg,
                                 uint32_t lastUniformUpdate)
@@ -784,27 +926,15 @@ GLDriver::uploadDataBuffer(DataBuffer *buffer,
                            uint32_t offset,
                            uint32_t size)
 {
-   // Avoid uploading the data if it hasn't changed.
-   uint64_t newHash[2] = { 0, 0 };
-   MurmurHash3_x64_128(mem::translate(buffer->cpuMemStart), buffer->allocatedSize, 0, newHash);
-
-   if (newHash[0] != buffer->cpuMemHash[0] || newHash[1] != buffer->cpuMemHash[1]) {
-      buffer->cpuMemHash[0] = newHash[0];
-      buffer->cpuMemHash[1] = newHash[1];
-
-      // We currently can't detect where the change occurred, so upload
-      //  the entire buffer.  If we don't do this, the following sequence
-      //  will result in incorrect GPU-side data:
-      //     1) Client modifies two disjoint regions A and B of the buffer.
-      //     2) Client calls GX2Invalidate() on region A.
-      //     3) We detect that the hash has changed and upload region A.
-      //     4) Client calls GX2Invalidate() on region B.
-      //     5) We detect that the hash is unchanged and don't upload
-      //         region B.
-      //  Now region B has incorrect data on the host GPU.
-      // TODO: Find a better way to allow partial updates.
-      offset = 0;
-      size = buffer->allocatedSize;
+   // Avoid uploading the data if it hasn't changed.  Every chunk of the
+   //  buffer flushed since the last upload is rehashed, not just the range
+   //  we were asked to upload, so that a change to region B is still picked
+   //  up if the client only invalidates region A before the next draw.
+   uint32_t changedStart, changedEnd;
+
+   if (buffer->cpuMemHash.update(mem::translate(buffer->cpuMemStart), buffer->allocatedSize, &changedStart, &changedEnd)) {
+      offset = changedStart;
+      size = changedEnd - changedStart;
 
       if (buffer->mappedBuffer) {
          memcpy(static_cast<char *>(buffer->mappedBuffer) + offset,
@@ -887,7 +1017,10 @@ GLDriver::checkAttribBuffersBound()
    return true;
 }
 
-bool GLDriver::parseFetchShader(FetchShader &shader, void *buffer, size_t size)
+bool
+parseFetchShader(FetchShader &shader,
+                 void *buffer,
+                 size_t size)
 {
    auto program = reinterpret_cast<latte::ControlFlowInst *>(buffer);
 
@@ -969,10 +1102,16 @@ getGLSLDataInFormat(latte::SQ_DATA_FORMAT format, latte::SQ_NUM_FORMAT num, latt
    }
 }
 
-bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uint8_t *buffer, size_t size, bool isScreenSpace)
+static bool
+compileVertexShader(const Pm4Processor::Registers &registers,
+                    VertexShader &vertex,
+                    FetchShader &fetch,
+                    uint8_t *buffer,
+                    size_t size,
+                    bool isScreenSpace)
 {
-   auto sq_config = getRegister<latte::SQ_CONFIG>(latte::Register::SQ_CONFIG);
-   auto spi_vs_out_config = getRegister<latte::SPI_VS_OUT_CONFIG>(latte::Register::SPI_VS_OUT_CONFIG);
+   auto sq_config = getRegister<latte::SQ_CONFIG>(registers, latte::Register::SQ_CONFIG);
+   auto spi_vs_out_config = getRegister<latte::SPI_VS_OUT_CONFIG>(registers, latte::Register::SPI_VS_OUT_CONFIG);
    std::array<FetchShader::Attrib *, 32> semanticAttribs;
    semanticAttribs.fill(nullptr);
 
@@ -981,7 +1120,7 @@ bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uin
 
    for (auto i = 0; i < latte::MaxSamplers; ++i) {
       auto resourceOffset = (latte::SQ_RES_OFFSET::VS_TEX_RESOURCE_0 + i) * 7;
-      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(latte::Register::SQ_TEX_RESOURCE_WORD0_0 + 4 * resourceOffset);
+      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(registers, latte::Register::SQ_TEX_RESOURCE_WORD0_0 + 4 * resourceOffset);
 
       shader.samplerDim[i] = sq_tex_resource_word0.DIM();
    }
@@ -1053,7 +1192,7 @@ bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uin
 
    for (auto i = 0u; i <= spi_vs_out_config.VS_EXPORT_COUNT(); i++) {
       auto regId = i / 4;
-      auto spi_vs_out_id = getRegister<latte::SPI_VS_OUT_ID_N>(latte::Register::SPI_VS_OUT_ID_0 + 4 * regId);
+      auto spi_vs_out_id = getRegister<latte::SPI_VS_OUT_ID_N>(registers, latte::Register::SPI_VS_OUT_ID_0 + 4 * regId);
 
       auto semanticNum = i % 4;
       uint8_t semanticId = 0xff;
@@ -1086,7 +1225,7 @@ bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uin
       vertex.usedFeedbackBuffers[i] = !shader.feedbacks[i].empty();
 
       if (vertex.usedFeedbackBuffers[i]) {
-         auto vgt_strmout_vtx_stride = getRegister<uint32_t>(latte::Register::VGT_STRMOUT_VTX_STRIDE_0 + 16 * i);
+         auto vgt_strmout_vtx_stride = getRegister<uint32_t>(registers, latte::Register::VGT_STRMOUT_VTX_STRIDE_0 + 16 * i);
          auto stride = vgt_strmout_vtx_stride * 4;
 
          if (NVIDIA_GLSL_WORKAROUND) {
@@ -1130,7 +1269,7 @@ bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uin
 
    // Assign fetch shader output to our GPR
    for (auto i = 0u; i < 32; ++i) {
-      auto sq_vtx_semantic = getRegister<latte::SQ_VTX_SEMANTIC_N>(latte::Register::SQ_VTX_SEMANTIC_0 + i * 4);
+      auto sq_vtx_semantic = getRegister<latte::SQ_VTX_SEMANTIC_N>(registers, latte::Register::SQ_VTX_SEMANTIC_0 + i * 4);
       auto id = sq_vtx_semantic.SEMANTIC_ID();
 
       if (id == 0xff) {
@@ -1356,7 +1495,7 @@ bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uin
          decaf_check(!spi_vs_out_config.VS_PER_COMPONENT());
 
          auto regId = exp.id / 4;
-         auto spi_vs_out_id = getRegister<latte::SPI_VS_OUT_ID_N>(latte::Register::SPI_VS_OUT_ID_0 + 4 * regId);
+         auto spi_vs_out_id = getRegister<latte::SPI_VS_OUT_ID_N>(registers, latte::Register::SPI_VS_OUT_ID_0 + 4 * regId);
 
          auto semanticNum = exp.id % 4;
          uint8_t semanticId = 0xff;
@@ -1390,14 +1529,19 @@ bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uin
    return true;
 }
 
-bool GLDriver::compilePixelShader(PixelShader &pixel, VertexShader &vertex, uint8_t *buffer, size_t size)
+static bool
+compilePixelShader(const Pm4Processor::Registers &registers,
+                   PixelShader &pixel,
+                   VertexShader &vertex,
+                   uint8_t *buffer,
+                   size_t size)
 {
-   auto sq_config = getRegister<latte::SQ_CONFIG>(latte::Register::SQ_CONFIG);
-   auto spi_ps_in_control_0 = getRegister<latte::SPI_PS_IN_CONTROL_0>(latte::Register::SPI_PS_IN_CONTROL_0);
-   auto spi_ps_in_control_1 = getRegister<latte::SPI_PS_IN_CONTROL_1>(latte::Register::SPI_PS_IN_CONTROL_1);
-   auto cb_shader_mask = getRegister<latte::CB_SHADER_MASK>(latte::Register::CB_SHADER_MASK);
-   auto db_shader_control = getRegister<latte::DB_SHADER_CONTROL>(latte::Register::DB_SHADER_CONTROL);
-   auto sx_alpha_test_control = getRegister<latte::SX_ALPHA_TEST_CONTROL>(latte::Register::SX_ALPHA_TEST_CONTROL);
+   auto sq_config = getRegister<latte::SQ_CONFIG>(registers, latte::Register::SQ_CONFIG);
+   auto spi_ps_in_control_0 = getRegister<latte::SPI_PS_IN_CONTROL_0>(registers, latte::Register::SPI_PS_IN_CONTROL_0);
+   auto spi_ps_in_control_1 = getRegister<latte::SPI_PS_IN_CONTROL_1>(registers, latte::Register::SPI_PS_IN_CONTROL_1);
+   auto cb_shader_mask = getRegister<latte::CB_SHADER_MASK>(registers, latte::Register::CB_SHADER_MASK);
+   auto db_shader_control = getRegister<latte::DB_SHADER_CONTROL>(registers, latte::Register::DB_SHADER_CONTROL);
+   auto sx_alpha_test_control = getRegister<latte::SX_ALPHA_TEST_CONTROL>(registers, latte::Register::SX_ALPHA_TEST_CONTROL);
 
    decaf_assert(!db_shader_control.STENCIL_REF_EXPORT_ENABLE(), "Stencil exports not implemented");
 
@@ -1407,7 +1551,7 @@ bool GLDriver::compilePixelShader(PixelShader &pixel, VertexShader &vertex, uint
    // Gather Samplers
    for (auto i = 0; i < latte::MaxSamplers; ++i) {
       auto resourceOffset = (latte::SQ_RES_OFFSET::PS_TEX_RESOURCE_0 + i) * 7;
-      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(latte::Register::SQ_TEX_RESOURCE_WORD0_0 + 4 * resourceOffset);
+      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(registers, latte::Register::SQ_TEX_RESOURCE_WORD0_0 + 4 * resourceOffset);
 
       shader.samplerDim[i] = sq_tex_resource_word0.DIM();
    }
@@ -1466,7 +1610,7 @@ bool GLDriver::compilePixelShader(PixelShader &pixel, VertexShader &vertex, uint
    // Pixel Shader Inputs
    std::array<bool, 256> semanticUsed = { false };
    for (auto i = 0u; i < spi_ps_in_control_0.NUM_INTERP(); ++i) {
-      auto spi_ps_input_cntl = getRegister<latte::SPI_PS_INPUT_CNTL_N>(latte::Register::SPI_PS_INPUT_CNTL_0 + i * 4);
+      auto spi_ps_input_cntl = getRegister<latte::SPI_PS_INPUT_CNTL_N>(registers, latte::Register::SPI_PS_INPUT_CNTL_0 + i * 4);
       auto semanticId = spi_ps_input_cntl.SEMANTIC();
       decaf_check(semanticId != 0xff);
 
@@ -1511,7 +1655,7 @@ bool GLDriver::compilePixelShader(PixelShader &pixel, VertexShader &vertex, uint
 
    // Assign vertex shader output to our GPR
    for (auto i = 0u; i < spi_ps_in_control_0.NUM_INTERP(); ++i) {
-      auto spi_ps_input_cntl = getRegister<latte::SPI_PS_INPUT_CNTL_N>(latte::Register::SPI_PS_INPUT_CNTL_0 + i * 4);
+      auto spi_ps_input_cntl = getRegister<latte::SPI_PS_INPUT_CNTL_N>(registers, latte::Register::SPI_PS_INPUT_CNTL_0 + i * 4);
       uint8_t semanticId = spi_ps_input_cntl.SEMANTIC();
       decaf_check(semanticId != 0xff);
 
@@ -1652,6 +1796,310 @@ bool GLDriver::compilePixelShader(PixelShader &pixel, VertexShader &vertex, uint
    return true;
 }
 
+// Bytes of VertexShader which are generated alongside its code
+static const size_t VertexShaderMetadataSize = 256 + 16 + 4;
+
+// Bytes of PixelShader which are generated alongside its code
+static const size_t PixelShaderMetadataSize = latte::MaxSamplers + 16;
+
+static ShaderCacheKey
+getShaderCacheKey(const uint8_t *buffer,
+                  size_t size,
+                  const std::vector<uint32_t> &state)
+{
+   std::vector<uint8_t> data;
+   data.reserve(size + state.size() * sizeof(uint32_t));
+   data.insert(data.end(), buffer, buffer + size);
+   data.insert(data.end(),
+               reinterpret_cast<const uint8_t *>(state.data()),
+               reinterpret_cast<const uint8_t *>(state.data() + state.size()));
+
+   ShaderCacheKey key;
+   MurmurHash3_x64_128(data.data(), static_cast<int>(data.size()), 0, key.value);
+   return key;
+}
+
+// Every register read by compileVertexShader, and the fetch shader whose
+//  attributes and disassembly end up in the code, affect the translation.
+static ShaderCacheKey
+getVertexShaderCacheKey(const Pm4Processor::Registers &registers,
+                        const FetchShader &fetch,
+                        const uint8_t *buffer,
+                        size_t size,
+                        bool isScreenSpace)
+{
+   std::vector<uint32_t> state;
+   state.push_back(isScreenSpace ? 1 : 0);
+   state.push_back(getRegister<latte::SQ_CONFIG>(registers, latte::Register::SQ_CONFIG).DX9_CONSTS());
+   state.push_back(getRegister<uint32_t>(registers, latte::Register::SPI_VS_OUT_CONFIG));
+
+   for (auto i = 0; i < latte::MaxSamplers; ++i) {
+      auto resourceOffset = (latte::SQ_RES_OFFSET::VS_TEX_RESOURCE_0 + i) * 7;
+      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(registers, latte::Register::SQ_TEX_RESOURCE_WORD0_0 + 4 * resourceOffset);
+      state.push_back(static_cast<uint32_t>(sq_tex_resource_word0.DIM()));
+   }
+
+   for (auto i = 0u; i < 10; ++i) {
+      state.push_back(getRegister<uint32_t>(registers, latte::Register::SPI_VS_OUT_ID_0 + 4 * i));
+   }
+
+   for (auto i = 0u; i < 32; ++i) {
+      state.push_back(getRegister<uint32_t>(registers, latte::Register::SQ_VTX_SEMANTIC_0 + 4 * i));
+   }
+
+   for (auto i = 0u; i < latte::MaxStreamOutBuffers; ++i) {
+      state.push_back(getRegister<uint32_t>(registers, latte::Register::VGT_STRMOUT_VTX_STRIDE_0 + 16 * i));
+   }
+
+   // Use what was parsed from the fetch shader rather than its binary, so
+   //  that this does not have to read memory which may have changed
+   for (auto &attrib : fetch.attribs) {
+      state.push_back(attrib.buffer);
+      state.push_back(attrib.offset);
+      state.push_back(attrib.location);
+      state.push_back(static_cast<uint32_t>(attrib.format));
+      state.push_back(static_cast<uint32_t>(attrib.numFormat));
+      state.push_back(static_cast<uint32_t>(attrib.endianSwap));
+      state.push_back(static_cast<uint32_t>(attrib.formatComp));
+   }
+
+   auto fetchKey = getShaderCacheKey(reinterpret_cast<const uint8_t *>(fetch.disassembly.data()), fetch.disassembly.size(), {});
+   state.push_back(static_cast<uint32_t>(fetchKey.value[0]));
+   state.push_back(static_cast<uint32_t>(fetchKey.value[0] >> 32));
+   state.push_back(static_cast<uint32_t>(fetchKey.value[1]));
+   state.push_back(static_cast<uint32_t>(fetchKey.value[1] >> 32));
+
+   return getShaderCacheKey(buffer, size, state);
+}
+
+// Every register read by compilePixelShader, and the vertex shader outputs
+//  it is linked against, affect the translation.
+static ShaderCacheKey
+getPixelShaderCacheKey(const Pm4Processor::Registers &registers,
+                       const VertexShader &vertex,
+                       const uint8_t *buffer,
+                       size_t size)
+{
+   std::vector<uint32_t> state;
+   state.push_back(getRegister<latte::SQ_CONFIG>(registers, latte::Register::SQ_CONFIG).DX9_CONSTS());
+   state.push_back(getRegister<uint32_t>(registers, latte::Register::SPI_PS_IN_CONTROL_0));
+   state.push_back(getRegister<uint32_t>(registers, latte::Register::SPI_PS_IN_CONTROL_1));
+   state.push_back(getRegister<uint32_t>(registers, latte::Register::CB_SHADER_MASK));
+   state.push_back(getRegister<uint32_t>(registers, latte::Register::DB_SHADER_CONTROL));
+   state.push_back(getRegister<uint32_t>(registers, latte::Register::SX_ALPHA_TEST_CONTROL));
+
+   for (auto i = 0; i < latte::MaxSamplers; ++i) {
+      auto resourceOffset = (latte::SQ_RES_OFFSET::PS_TEX_RESOURCE_0 + i) * 7;
+      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(registers, latte::Register::SQ_TEX_RESOURCE_WORD0_0 + 4 * resourceOffset);
+      state.push_back(static_cast<uint32_t>(sq_tex_resource_word0.DIM()));
+   }
+
+   for (auto i = 0u; i < 32; ++i) {
+      state.push_back(getRegister<uint32_t>(registers, latte::Register::SPI_PS_INPUT_CNTL_0 + 4 * i));
+   }
+
+   for (auto i = 0u; i < vertex.outputMap.size(); i += 4) {
+      state.push_back(static_cast<uint32_t>(vertex.outputMap[i])
+                   | (static_cast<uint32_t>(vertex.outputMap[i + 1]) << 8)
+                   | (static_cast<uint32_t>(vertex.outputMap[i + 2]) << 16)
+                   | (static_cast<uint32_t>(vertex.outputMap[i + 3]) << 24));
+   }
+
+   return getShaderCacheKey(buffer, size, state);
+}
+
+static std::vector<uint8_t>
+getVertexShaderMetadata(const VertexShader &vertex)
+{
+   std::vector<uint8_t> metadata;
+   metadata.reserve(VertexShaderMetadataSize);
+   metadata.insert(metadata.end(), vertex.outputMap.begin(), vertex.outputMap.end());
+
+   for (auto used : vertex.usedUniformBlocks) {
+      metadata.push_back(used ? 1 : 0);
+   }
+
+   for (auto used : vertex.usedFeedbackBuffers) {
+      metadata.push_back(used ? 1 : 0);
+   }
+
+   return metadata;
+}
+
+static bool
+setVertexShaderMetadata(VertexShader &vertex,
+                        const std::vector<uint8_t> &metadata)
+{
+   if (metadata.size() != VertexShaderMetadataSize) {
+      return false;
+   }
+
+   auto pos = metadata.begin();
+   std::copy(pos, pos + 256, vertex.outputMap.begin());
+   pos += 256;
+
+   for (auto &used : vertex.usedUniformBlocks) {
+      used = !!*pos++;
+   }
+
+   for (auto &used : vertex.usedFeedbackBuffers) {
+      used = !!*pos++;
+   }
+
+   return true;
+}
+
+static std::vector<uint8_t>
+getPixelShaderMetadata(const PixelShader &pixel)
+{
+   std::vector<uint8_t> metadata;
+   metadata.reserve(PixelShaderMetadataSize);
+
+   for (auto usage : pixel.samplerUsage) {
+      metadata.push_back(static_cast<uint8_t>(usage));
+   }
+
+   for (auto used : pixel.usedUniformBlocks) {
+      metadata.push_back(used ? 1 : 0);
+   }
+
+   return metadata;
+}
+
+static bool
+setPixelShaderMetadata(PixelShader &pixel,
+                       const std::vector<uint8_t> &metadata)
+{
+   if (metadata.size() != PixelShaderMetadataSize) {
+      return false;
+   }
+
+   auto pos = metadata.begin();
+
+   for (auto &usage : pixel.samplerUsage) {
+      usage = static_cast<glsl2::SamplerUsage>(*pos++);
+   }
+
+   for (auto &used : pixel.usedUniformBlocks) {
+      used = !!*pos++;
+   }
+
+   return true;
+}
+
+bool
+translateVertexShader(const Pm4Processor::Registers &registers,
+                      ShaderCache &cache,
+                      VertexShader &vertex,
+                      FetchShader &fetch,
+                      uint8_t *buffer,
+                      size_t size,
+                      bool isScreenSpace)
+{
+   auto key = getVertexShaderCacheKey(registers, fetch, buffer, size, isScreenSpace);
+   std::vector<uint8_t> metadata;
+
+   if (cache.lookup(key, ShaderCache::VERTEX_SHADER, metadata, vertex.code)
+    && setVertexShaderMetadata(vertex, metadata)) {
+      vertex.isScreenSpace = isScreenSpace;
+      return true;
+   }
+
+   if (!compileVertexShader(registers, vertex, fetch, buffer, size, isScreenSpace)) {
+      return false;
+   }
+
+   cache.store(key, ShaderCache::VERTEX_SHADER, getVertexShaderMetadata(vertex), vertex.code);
+   return true;
+}
+
+bool
+translatePixelShader(const Pm4Processor::Registers &registers,
+                     ShaderCache &cache,
+                     PixelShader &pixel,
+                     VertexShader &vertex,
+                     uint8_t *buffer,
+                     size_t size)
+{
+   auto key = getPixelShaderCacheKey(registers, vertex, buffer, size);
+   std::vector<uint8_t> metadata;
+
+   if (cache.lookup(key, ShaderCache::PIXEL_SHADER, metadata, pixel.code)
+    && setPixelShaderMetadata(pixel, metadata)) {
+      return true;
+   }
+
+   if (!compilePixelShader(registers, pixel, vertex, buffer, size)) {
+      return false;
+   }
+
+   cache.store(key, ShaderCache::PIXEL_SHADER, getPixelShaderMetadata(pixel), pixel.code);
+   return true;
+}
+
+std::shared_ptr<ShaderTranslation>
+createShaderTranslation(const Pm4Processor::Registers &registers,
+                        FetchShader &fetch,
+                        VertexShader *existingVertex,
+                        bool translatePixel)
+{
+   auto pgm_start_vs = getRegister<latte::SQ_PGM_START_VS>(registers, latte::Register::SQ_PGM_START_VS);
+   auto pgm_start_ps = getRegister<latte::SQ_PGM_START_PS>(registers, latte::Register::SQ_PGM_START_PS);
+   auto pgm_size_vs = getRegister<latte::SQ_PGM_SIZE_VS>(registers, latte::Register::SQ_PGM_SIZE_VS);
+   auto pgm_size_ps = getRegister<latte::SQ_PGM_SIZE_PS>(registers, latte::Register::SQ_PGM_SIZE_PS);
+   auto vgt_primitive_type = getRegister<latte::VGT_PRIMITIVE_TYPE>(registers, latte::Register::VGT_PRIMITIVE_TYPE);
+   auto translation = std::make_shared<ShaderTranslation>();
+
+   translation->registers = std::make_unique<Pm4Processor::Registers>(registers);
+   translation->isScreenSpace = (vgt_primitive_type.PRIM_TYPE() == latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST);
+   translation->fetch.attribs = fetch.attribs;
+   translation->fetch.disassembly = fetch.disassembly;
+
+   if (existingVertex) {
+      translation->vertex.outputMap = existingVertex->outputMap;
+   } else {
+      auto vsPgmAddress = pgm_start_vs.PGM_START() << 8;
+      auto vsPgmSize = pgm_size_vs.PGM_SIZE() << 3;
+      auto vsPgmData = mem::translate(vsPgmAddress);
+
+      translation->translateVertex = true;
+      translation->vertexBinary.assign(vsPgmData, vsPgmData + vsPgmSize);
+   }
+
+   if (translatePixel) {
+      auto psPgmAddress = pgm_start_ps.PGM_START() << 8;
+      auto psPgmSize = pgm_size_ps.PGM_SIZE() << 3;
+      auto psPgmData = mem::translate(psPgmAddress);
+
+      translation->translatePixel = true;
+      translation->pixelBinary.assign(psPgmData, psPgmData + psPgmSize);
+   }
+
+   return translation;
+}
+
+void
+runShaderTranslation(ShaderTranslation &translation,
+                     ShaderCache &cache)
+{
+   translation.success = true;
+
+   if (translation.translateVertex) {
+      translation.success = translateVertexShader(*translation.registers, cache,
+                                                  translation.vertex, translation.fetch,
+                                                  translation.vertexBinary.data(), translation.vertexBinary.size(),
+                                                  translation.isScreenSpace);
+   }
+
+   if (translation.success && translation.translatePixel) {
+      translation.success = translatePixelShader(*translation.registers, cache,
+                                                 translation.pixel, translation.vertex,
+                                                 translation.pixelBinary.data(), translation.pixelBinary.size());
+   }
+
+   translation.complete = true;
+}
+
 } // namespace opengl
 
 } // namespace gpu
@@ -0,0 +1,93 @@
+#pragma once
+
+#ifndef DECAF_NOGL
+
+#include "gpu/pm4_processor.h"
+#include "opengl_driver.h"
+#include "opengl_shadercache.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace gpu
+{
+
+namespace opengl
+{
+
+// These only generate GLSL from the shader binaries and the register state,
+//  they make no OpenGL calls so they can be used without a context.
+
+bool
+parseFetchShader(FetchShader &shader,
+                 void *buffer,
+                 size_t size);
+
+// Translates a vertex shader, or fetches it from the cache if it has been
+//  translated with the same register state before.
+bool
+translateVertexShader(const Pm4Processor::Registers &registers,
+                      ShaderCache &cache,
+                      VertexShader &vertex,
+                      FetchShader &fetch,
+                      uint8_t *buffer,
+                      size_t size,
+                      bool isScreenSpace);
+
+// Translates a pixel shader, or fetches it from the cache if it has been
+//  translated with the same register state before.
+bool
+translatePixelShader(const Pm4Processor::Registers &registers,
+                     ShaderCache &cache,
+                     PixelShader &pixel,
+                     VertexShader &vertex,
+                     uint8_t *buffer,
+                     size_t size);
+
+// Everything needed to translate the shaders of a pipeline, copied so that
+//  the translation can run on another thread while the registers and memory
+//  it was created from change.
+struct ShaderTranslation
+{
+   std::unique_ptr<Pm4Processor::Registers> registers;
+   bool isScreenSpace = false;
+
+   //! Copy of the attribs and disassembly of the fetch shader
+   FetchShader fetch;
+
+   //! Whether to translate the vertex shader, if not then vertex already
+   //!  holds the outputs of the existing vertex shader
+   bool translateVertex = false;
+   std::vector<uint8_t> vertexBinary;
+   VertexShader vertex;
+
+   bool translatePixel = false;
+   std::vector<uint8_t> pixelBinary;
+   PixelShader pixel;
+
+   //! Set once the translation has finished, whether or not it succeeded
+   std::atomic<bool> complete { false };
+   bool success = false;
+};
+
+// Creates a translation of the shaders set in registers.  If existingVertex
+//  is not null, only the pixel shader is translated and it is linked against
+//  the outputs of existingVertex.
+std::shared_ptr<ShaderTranslation>
+createShaderTranslation(const Pm4Processor::Registers &registers,
+                        FetchShader &fetch,
+                        VertexShader *existingVertex,
+                        bool translatePixel);
+
+void
+runShaderTranslation(ShaderTranslation &translation,
+                     ShaderCache &cache);
+
+} // namespace opengl
+
+} // namespace gpu
+
+#endif // DECAF_NOGL
@@ -0,0 +1,273 @@
+#ifndef DECAF_NOGL
+
+#include "opengl_shadercache.h"
+
+#include <array>
+#include <common/log.h>
+#include <common/murmur3.h>
+#include <common/platform_memory.h>
+#include <cstring>
+#include <fstream>
+
+namespace gpu
+{
+
+namespace opengl
+{
+
+static const std::array<char, 4> CacheMagic =
+{
+   'D', 'S', 'H', 'C'
+};
+
+// Bump this whenever a change to the shader translation changes its output,
+//  so that caches written by older versions are thrown away.
+static const uint32_t CacheVersion = 2;
+
+struct CacheFileHeader
+{
+   std::array<char, 4> magic;
+   uint32_t version;
+};
+
+struct CacheRecordHeader
+{
+   ShaderCacheKey key;
+   uint32_t type;
+   uint32_t metadataSize;
+   uint32_t codeSize;
+
+   //! Hash of the metadata and code, to detect records torn by a crash
+   uint32_t checksum;
+};
+
+static uint32_t
+getRecordChecksum(const uint8_t *payload,
+                  size_t size)
+{
+   uint32_t checksum;
+   MurmurHash3_x86_32(payload, static_cast<int>(size), 0, &checksum);
+   return checksum;
+}
+
+ShaderCache::~ShaderCache()
+{
+   close();
+}
+
+void
+ShaderCache::open(const std::string &path)
+{
+   close();
+
+   std::unique_lock<std::mutex> lock { mMutex };
+   mPath = path;
+   mAppendOffset = 0;
+   mMappedView = platform::mapFileReadOnly(path, mMappedSize);
+
+   if (mMappedView) {
+      mAppendOffset = loadRecords(reinterpret_cast<const uint8_t *>(mMappedView), mMappedSize);
+
+      if (mAppendOffset == 0) {
+         // The file is from another version, it is about to be overwritten
+         platform::unmapFile(mMappedView, mMappedSize);
+         mMappedView = nullptr;
+         mMappedSize = 0;
+      }
+   }
+
+   gLog->info("Loaded {} shaders from shader cache {}", mIndex.size(), path);
+
+   mWriterStop = false;
+   mWriterThread = std::thread { &ShaderCache::writerEntry, this };
+}
+
+void
+ShaderCache::close()
+{
+   if (mWriterThread.joinable()) {
+      {
+         std::unique_lock<std::mutex> lock { mMutex };
+         mWriterStop = true;
+      }
+
+      mWriterCV.notify_all();
+      mWriterThread.join();
+   }
+
+   std::unique_lock<std::mutex> lock { mMutex };
+   mIndex.clear();
+   mOwnedRecords.clear();
+   mPendingWrites.clear();
+
+   if (mMappedView) {
+      platform::unmapFile(mMappedView, mMappedSize);
+      mMappedView = nullptr;
+      mMappedSize = 0;
+   }
+}
+
+size_t
+ShaderCache::loadRecords(const uint8_t *data,
+                         size_t size)
+{
+   CacheFileHeader fileHeader;
+
+   if (size < sizeof(CacheFileHeader)) {
+      return 0;
+   }
+
+   std::memcpy(&fileHeader, data, sizeof(CacheFileHeader));
+
+   if (fileHeader.magic != CacheMagic || fileHeader.version != CacheVersion) {
+      gLog->info("Discarding shader cache {} from a different version", mPath);
+      return 0;
+   }
+
+   auto offset = sizeof(CacheFileHeader);
+
+   while (offset + sizeof(CacheRecordHeader) <= size) {
+      CacheRecordHeader header;
+      std::memcpy(&header, data + offset, sizeof(CacheRecordHeader));
+
+      auto payloadSize = static_cast<size_t>(header.metadataSize) + header.codeSize;
+      auto payload = data + offset + sizeof(CacheRecordHeader);
+
+      if (payloadSize > size - offset - sizeof(CacheRecordHeader)
+       || getRecordChecksum(payload, payloadSize) != header.checksum) {
+         // A record torn by a crash, new records will be written over it
+         gLog->warn("Ignoring corrupt shader cache record at offset {}", offset);
+         break;
+      }
+
+      mIndex[header.key] = data + offset;
+      offset += sizeof(CacheRecordHeader) + payloadSize;
+   }
+
+   return offset;
+}
+
+bool
+ShaderCache::lookup(const ShaderCacheKey &key,
+                    Type type,
+                    std::vector<uint8_t> &metadata,
+                    std::string &code)
+{
+   std::unique_lock<std::mutex> lock { mMutex };
+   auto itr = mIndex.find(key);
+
+   if (itr == mIndex.end()) {
+      return false;
+   }
+
+   CacheRecordHeader header;
+   std::memcpy(&header, itr->second, sizeof(CacheRecordHeader));
+
+   if (header.type != type) {
+      return false;
+   }
+
+   auto payload = itr->second + sizeof(CacheRecordHeader);
+   metadata.assign(payload, payload + header.metadataSize);
+   code.assign(reinterpret_cast<const char *>(payload + header.metadataSize), header.codeSize);
+   return true;
+}
+
+void
+ShaderCache::store(const ShaderCacheKey &key,
+                   Type type,
+                   const std::vector<uint8_t> &metadata,
+                   const std::string &code)
+{
+   auto record = std::make_unique<std::vector<uint8_t>>(sizeof(CacheRecordHeader) + metadata.size() + code.size());
+   auto payload = record->data() + sizeof(CacheRecordHeader);
+
+   if (!metadata.empty()) {
+      std::memcpy(payload, metadata.data(), metadata.size());
+   }
+
+   std::memcpy(payload + metadata.size(), code.data(), code.size());
+
+   CacheRecordHeader header;
+   header.key = key;
+   header.type = type;
+   header.metadataSize = static_cast<uint32_t>(metadata.size());
+   header.codeSize = static_cast<uint32_t>(code.size());
+   header.checksum = getRecordChecksum(payload, metadata.size() + code.size());
+   std::memcpy(record->data(), &header, sizeof(CacheRecordHeader));
+
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+
+      if (!mWriterThread.joinable()) {
+         return;
+      }
+
+      mIndex[key] = record->data();
+      mPendingWrites.push_back(record.get());
+      mOwnedRecords.emplace_back(std::move(record));
+   }
+
+   mWriterCV.notify_one();
+}
+
+size_t
+ShaderCache::size()
+{
+   std::unique_lock<std::mutex> lock { mMutex };
+   return mIndex.size();
+}
+
+void
+ShaderCache::writerEntry()
+{
+   std::unique_lock<std::mutex> lock { mMutex };
+   std::fstream file;
+   auto openFailed = false;
+
+   while (true) {
+      mWriterCV.wait(lock, [&]() {
+         return mWriterStop || !mPendingWrites.empty();
+      });
+
+      if (mPendingWrites.empty()) {
+         break;
+      }
+
+      auto record = mPendingWrites.front();
+      mPendingWrites.pop_front();
+
+      // Records are never freed while the writer is running, so we can
+      //  write this one without holding the lock.
+      lock.unlock();
+
+      if (!file.is_open() && !openFailed) {
+         if (mAppendOffset == 0) {
+            auto header = CacheFileHeader { CacheMagic, CacheVersion };
+            file.open(mPath, std::fstream::out | std::fstream::binary | std::fstream::trunc);
+            file.write(reinterpret_cast<const char *>(&header), sizeof(CacheFileHeader));
+         } else {
+            file.open(mPath, std::fstream::in | std::fstream::out | std::fstream::binary);
+            file.seekp(mAppendOffset);
+         }
+
+         if (!file) {
+            gLog->error("Could not open shader cache {} for writing", mPath);
+            openFailed = true;
+         }
+      }
+
+      if (file.is_open() && file) {
+         file.write(reinterpret_cast<const char *>(record->data()), record->size());
+         file.flush();
+      }
+
+      lock.lock();
+   }
+}
+
+} // namespace opengl
+
+} // namespace gpu
+
+#endif // DECAF_NOGL
@@ -0,0 +1,116 @@
+#pragma once
+
+#ifndef DECAF_NOGL
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace gpu
+{
+
+namespace opengl
+{
+
+struct ShaderCacheKey
+{
+   uint64_t value[2];
+
+   bool
+   operator ==(const ShaderCacheKey &other) const
+   {
+      return value[0] == other.value[0] && value[1] == other.value[1];
+   }
+};
+
+struct ShaderCacheKeyHash
+{
+   size_t
+   operator()(const ShaderCacheKey &key) const
+   {
+      return static_cast<size_t>(key.value[0] ^ key.value[1]);
+   }
+};
+
+// A persistent cache of translated shaders, keyed by a hash of the shader
+//  binary and of every register which affects its translation.
+//
+// The cache file is memory-mapped when it is opened, so lookups of shaders
+//  seen in previous runs only copy the code out of the mapping.  New entries
+//  are kept in memory and appended to the file by a background thread.
+class ShaderCache
+{
+public:
+   enum Type : uint32_t
+   {
+      VERTEX_SHADER = 1,
+      PIXEL_SHADER = 2,
+   };
+
+   ShaderCache() = default;
+   ~ShaderCache();
+
+   ShaderCache(const ShaderCache &) = delete;
+   ShaderCache &operator=(const ShaderCache &) = delete;
+
+   void
+   open(const std::string &path);
+
+   void
+   close();
+
+   bool
+   lookup(const ShaderCacheKey &key,
+          Type type,
+          std::vector<uint8_t> &metadata,
+          std::string &code);
+
+   void
+   store(const ShaderCacheKey &key,
+         Type type,
+         const std::vector<uint8_t> &metadata,
+         const std::string &code);
+
+   size_t
+   size();
+
+private:
+   size_t
+   loadRecords(const uint8_t *data,
+               size_t size);
+
+   void
+   writerEntry();
+
+private:
+   std::mutex mMutex;
+   std::condition_variable mWriterCV;
+   std::thread mWriterThread;
+   bool mWriterStop = false;
+
+   std::string mPath;
+   const void *mMappedView = nullptr;
+   size_t mMappedSize = 0;
+
+   //! Offset in the file to append new records at, 0 if it must be recreated
+   size_t mAppendOffset = 0;
+
+   //! Every known record, pointing either into the mapping or mOwnedRecords
+   std::unordered_map<ShaderCacheKey, const uint8_t *, ShaderCacheKeyHash> mIndex;
+   std::vector<std::unique_ptr<std::vector<uint8_t>>> mOwnedRecords;
+
+   //! Records waiting to be written by the writer thread
+   std::deque<const std::vector<uint8_t> *> mPendingWrites;
+};
+
+} // namespace opengl
+
+} // namespace gpu
+
+#endif // DECAF_NOGL
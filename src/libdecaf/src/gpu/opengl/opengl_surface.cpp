@@ -10,7 +10,6 @@
 #include "opengl_driver.h"
 
 #include <common/decaf_assert.h>
-#include <common/murmur3.h>
 #include <libcpu/mem.h>
 #include <glbinding/gl/gl.h>
 #include <glbinding/Meta.h>
@@ -560,23 +559,17 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
    auto srcImageSize = srcPitch * srcHeight * uploadDepth * bpp / 8;
    auto dstImageSize = srcWidth * srcHeight * uploadDepth * bpp / 8;
 
-   // Calculate a new memory CRC
-   uint64_t newHash[2] = { 0 };
-   MurmurHash3_x64_128(imagePtr, srcImageSize, 0, newHash);
-
    // If the CPU memory has changed, we should re-upload this.  This hashing is
    //  also means that if the application temporarily uses one of its buffers as
    //  a color buffer, we are able to accurately handle this.  Providing they are
-   //  not updating the memory at the same time.
-   if (newHash[0] != buffer->cpuMemHash[0] || newHash[1] != buffer->cpuMemHash[1]) {
-      buffer->cpuMemHash[0] = newHash[0];
-      buffer->cpuMemHash[1] = newHash[1];
-
+   //  not updating the memory at the same time.  Only the parts of the image
+   //  which have been flushed since the last upload are rehashed.
+   if (buffer->cpuMemHash.update(imagePtr, srcImageSize)) {
       std::vector<uint8_t> untiledImage, untiledMipmap;
       untiledImage.resize(dstImageSize);
 
       // Untile
-      gpu::convertFromTiled(
+      gpu::convertFromTiledParallel(
          untiledImage.data(),
          uploadPitch,
          imagePtr,
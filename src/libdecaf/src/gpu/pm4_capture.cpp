@@ -263,18 +263,12 @@ private:
    void
    scanCommandBuffer(uint32_t *words, uint32_t numWords)
    {
-      std::vector<uint32_t> swapped;
-      swapped.resize(numWords);
-
-      for (auto i = 0u; i < swapped.size(); ++i) {
-         swapped[i] = byte_swap(words[i]);
-      }
-
-      auto buffer = swapped.data();
-      auto bufferSize = swapped.size();
+      // The buffer is left big endian, packets are swapped as they are read
+      auto buffer = words;
+      auto bufferSize = size_t { numWords };
 
       for (auto pos = size_t { 0u }; pos < bufferSize; ) {
-         auto header = pm4::Header::get(buffer[pos]);
+         auto header = pm4::Header::get(byte_swap(buffer[pos]));
          auto size = size_t { 0u };
 
          switch (header.type()) {
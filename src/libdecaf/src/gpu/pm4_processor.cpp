@@ -15,20 +15,12 @@ Pm4Processor::indirectBufferCall(const pm4::IndirectBufferCall &data)
 void
 Pm4Processor::runCommandBuffer(uint32_t *buffer, uint32_t buffer_size)
 {
-   std::vector<uint32_t> swapped;
-   swapped.resize(buffer_size);
-
-   for (auto i = 0u; i < buffer_size; ++i) {
-      swapped[i] = byte_swap(buffer[i]);
-   }
-
-   buffer = swapped.data();
-
+   // The buffer is left big endian, packets are swapped as they are read
    for (auto pos = 0u; pos < buffer_size; ) {
-      auto header = *reinterpret_cast<pm4::Header *>(&buffer[pos]);
+      auto header = pm4::Header::get(byte_swap(buffer[pos]));
       auto size = 0u;
 
-      if (buffer[pos] == 0) {
+      if (header.value == 0) {
          break;
       }
 
@@ -75,7 +67,7 @@ Pm4Processor::handlePacketType0(pm4::type0::Header header, const gsl::span<uint3
    for (auto i = 0; i < data.size(); ++i) {
       auto index = base + i;
       // Set mRegisters[base + i];
-      gLog->info("Type0 set register 0x{:08X} = 0x{:08X}", index, data[i]);
+      gLog->info("Type0 set register 0x{:08X} = 0x{:08X}", index, byte_swap(data[i]));
    }
 }
 
@@ -2,12 +2,16 @@
 
 #include "gpu/pm4_packets.h"
 
+#include <array>
+#include <cstdint>
+
 namespace gpu
 {
 
 class Pm4Processor
 {
 public:
+   using Registers = std::array<uint32_t, 0x10000>;
 
 protected:
    virtual void decafSetBuffer(const pm4::DecafSetBuffer &data) = 0;
@@ -78,7 +82,7 @@ protected:
 
 
    latte::ShadowState mShadowState;
-   std::array<uint32_t, 0x10000> mRegisters;
+   Registers mRegisters;
 
 };
 
@@ -0,0 +1,39 @@
+#include "pm4_reader.h"
+#include <algorithm>
+
+namespace pm4
+{
+
+ScratchArena &
+ScratchArena::get()
+{
+   static thread_local ScratchArena arena;
+   return arena;
+}
+
+uint32_t *
+ScratchArena::allocate(size_t words)
+{
+   // Blocks are never freed or resized, so previously returned memory
+   //  stays valid until it is released
+   while (mBlock < mBlocks.size()) {
+      auto &block = mBlocks[mBlock];
+
+      if (mOffset + words <= block.size) {
+         auto result = block.data.get() + mOffset;
+         mOffset += words;
+         return result;
+      }
+
+      ++mBlock;
+      mOffset = 0;
+   }
+
+   auto size = std::max(BlockWords, words);
+   mBlocks.push_back({ std::unique_ptr<uint32_t[]> { new uint32_t[size] }, size });
+   mBlock = mBlocks.size() - 1;
+   mOffset = words;
+   return mBlocks.back().data.get();
+}
+
+} // namespace pm4
@@ -2,32 +2,90 @@
 #include "pm4_buffer.h"
 #include "pm4_format.h"
 
+#include <common/byte_swap.h>
+#include <common/byte_swap_array.h>
 #include <common/decaf_assert.h>
 #include <libcpu/mem.h>
 #include <gsl.h>
+#include <memory>
+#include <utility>
+#include <vector>
 
 namespace pm4
 {
 
 /**
- * Note: packet reader assumes the buffer has already been byte swapped to
- * little endian before reading. This is because it returns pointers to the
- * buffer, and we have to be able to return swapped memory. We cannot do an
- * in place swap because that could modify the game's memory.
+ * Per-thread memory used to hold the byte swapped copies of variable length
+ * packet payloads.  Memory is handed out in a stack-like fashion so that a
+ * PacketReader can release everything it allocated when it is destroyed,
+ * and is never moved so spans stay valid while nested buffers are parsed.
+ */
+class ScratchArena
+{
+   static const size_t BlockWords = 64 * 1024;
+
+public:
+   using Mark = std::pair<size_t, size_t>;
+
+   static ScratchArena &
+   get();
+
+   uint32_t *
+   allocate(size_t words);
+
+   Mark
+   mark() const
+   {
+      return { mBlock, mOffset };
+   }
+
+   void
+   release(const Mark &mark)
+   {
+      mBlock = mark.first;
+      mOffset = mark.second;
+   }
+
+private:
+   struct Block
+   {
+      std::unique_ptr<uint32_t[]> data;
+      size_t size;
+   };
+
+   std::vector<Block> mBlocks;
+   size_t mBlock = 0;
+   size_t mOffset = 0;
+};
+
+/**
+ * Reads big endian packet data in place.  Single words are swapped as they
+ * are read, the variable length payload at the end of a packet is swapped
+ * in bulk into the ScratchArena because we cannot do an in place swap
+ * without modifying the game's memory.
  */
 class PacketReader
 {
 public:
    PacketReader(gsl::span<uint32_t> data) :
-      mBuffer(data)
+      mBuffer(data),
+      mScratchMark(ScratchArena::get().mark())
    {
    }
 
+   PacketReader(const PacketReader &) = delete;
+   PacketReader &operator=(const PacketReader &) = delete;
+
+   ~PacketReader()
+   {
+      ScratchArena::get().release(mScratchMark);
+   }
+
    // Read one word
    PacketReader &operator()(uint32_t &value)
    {
       checkSize(1);
-      value = mBuffer[mPosition++];
+      value = readWord();
       return *this;
    }
 
@@ -35,7 +93,7 @@ public:
    PacketReader &operator()(float &value)
    {
       checkSize(1);
-      value = bit_cast<float>(mBuffer[mPosition++]);
+      value = bit_cast<float>(readWord());
       return *this;
    }
 
@@ -45,7 +103,7 @@ public:
    {
       static_assert(sizeof(Type) == sizeof(uint32_t), "Invalid type size");
       checkSize(1);
-      value = bit_cast<Type>(mBuffer[mPosition++]);
+      value = bit_cast<Type>(readWord());
       return *this;
    }
 
@@ -54,7 +112,7 @@ public:
    PacketReader &operator()(Type *&value)
    {
       checkSize(1);
-      value = mem::translate<Type>(mBuffer[mPosition++]);
+      value = mem::translate<Type>(readWord());
       return *this;
    }
 
@@ -62,8 +120,12 @@ public:
    template<typename Type>
    PacketReader &operator()(gsl::span<Type> &values)
    {
-      values = gsl::make_span(reinterpret_cast<Type*>(&mBuffer[mPosition]),
-                            ((mBuffer.size() - mPosition) * sizeof(uint32_t)) / sizeof(Type));
+      auto words = mBuffer.size() - mPosition;
+      auto swapped = ScratchArena::get().allocate(words);
+      byte_swap_array(swapped, &mBuffer[mPosition], words);
+
+      values = gsl::make_span(reinterpret_cast<Type*>(swapped),
+                            (words * sizeof(uint32_t)) / sizeof(Type));
 
       mPosition = mBuffer.size();
       return *this;
@@ -73,7 +135,7 @@ public:
    PacketReader &REG_OFFSET(latte::Register &value, latte::Register base)
    {
       checkSize(1);
-      value = static_cast<latte::Register>(((mBuffer[mPosition++] & 0xFFFF) * 4) + (uint32_t)base);
+      value = static_cast<latte::Register>(((readWord() & 0xFFFF) * 4) + (uint32_t)base);
       return *this;
    }
 
@@ -81,7 +143,7 @@ public:
    PacketReader &CONST_OFFSET(uint32_t &value)
    {
       checkSize(1);
-      value = mBuffer[mPosition++] & 0xFFFF;
+      value = readWord() & 0xFFFF;
       return *this;
    }
 
@@ -90,7 +152,7 @@ public:
    PacketReader &size(Type &value)
    {
       checkSize(1);
-      value = static_cast<Type>(mBuffer[mPosition++] + 1);
+      value = static_cast<Type>(readWord() + 1);
       return *this;
    }
 
@@ -102,9 +164,15 @@ private:
       }
    }
 
+   uint32_t readWord()
+   {
+      return byte_swap(mBuffer[mPosition++]);
+   }
+
 private:
    size_t mPosition = 0;
    gsl::span<uint32_t> mBuffer;
+   ScratchArena::Mark mScratchMark;
 };
 
 template<typename Type>
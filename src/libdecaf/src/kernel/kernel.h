@@ -20,6 +20,22 @@ struct LoadedModule;
 
 struct Fiber;
 
+struct FiberPoolStats
+{
+   //! Threads started on a recycled fiber
+   uint64_t hits;
+
+   //! Threads which needed a new fiber to be created
+   uint64_t misses;
+
+   //! Fibers currently owned by a thread
+   uint32_t live;
+   uint32_t peakLive;
+
+   //! Fibers waiting on the per-core freelists
+   uint32_t pooled;
+};
+
 void
 initialise();
 
@@ -53,4 +69,7 @@ getExitCode();
 const decaf::GameInfo &
 getGameInfo();
 
+FiberPoolStats
+getFiberPoolStats();
+
 } // namespace kernel
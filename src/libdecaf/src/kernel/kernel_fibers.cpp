@@ -1,5 +1,7 @@
+#include "decaf_config.h"
 #include "kernel.h"
 #include <algorithm>
+#include <atomic>
 #include <cfenv>
 #include "libcpu/cpu.h"
 #include "libcpu/mem.h"
@@ -13,6 +15,7 @@
 #include "modules/coreinit/coreinit_scheduler.h"
 #include "modules/coreinit/coreinit_systeminfo.h"
 #include "ppcutils/wfunc_call.h"
+#include <vector>
 
 namespace kernel
 {
@@ -34,8 +37,39 @@ struct Fiber
    platform::Fiber *handle = nullptr;
    coreinit::OSContext *context = nullptr;
    cpu::Tracer *tracer = nullptr;
+
+   //! Timebase of the core the thread last ran on when it was switched out
+   uint64_t timebase = 0;
+
+   //! False once handle has been replaced by reallocateContextFiber, as it
+   //!  no longer starts at fiberEntryPoint
+   bool recyclable = true;
 };
 
+// Fibers of exited threads are kept on a per-core freelist and reused for
+//  new threads, rather than allocating and faulting in a new stack for each
+//  of the short lived threads some games spawn.  Each list is only touched
+//  from its own core.
+static const auto MaxPooledFibersPerCore = 16u;
+
+static std::vector<Fiber *>
+sFiberPool[3];
+
+static std::atomic<uint64_t>
+sFiberPoolHits { 0 };
+
+static std::atomic<uint64_t>
+sFiberPoolMisses { 0 };
+
+static std::atomic<uint32_t>
+sPooledFibers { 0 };
+
+static std::atomic<uint32_t>
+sLiveFibers { 0 };
+
+static std::atomic<uint32_t>
+sPeakLiveFibers { 0 };
+
 static void
 checkDeadContext();
 
@@ -105,6 +139,7 @@ sleepCurrentContext()
       saveContext(context);
       context->nia = core->nia;
       context->cia = core->cia;
+      context->fiber->timebase = core->tb();
    } else {
       // We save the idle context's register information as well
       //  mainly so that it doesn't complain about core state loss.
@@ -135,6 +170,10 @@ wakeCurrentContext()
       core->nia = context->nia;
       core->cia = context->cia;
 
+      // Time must not go backwards for a thread which moved to a core
+      //  which has run less than the one it was on.
+      cpu::this_core::syncTimebase(context->fiber->timebase);
+
       // Some things to help us when debugging...
       cpu::this_core::setTracer(context->fiber->tracer);
    } else {
@@ -188,10 +227,30 @@ fiberEntryPoint(void*)
 static Fiber *
 allocateFiber(coreinit::OSContext *context)
 {
-   auto fiber = new Fiber();
-   fiber->tracer = cpu::allocTracer(1024 * 10 * 10);
-   fiber->handle = platform::createFiber(fiberEntryPoint, nullptr);
+   auto &pool = sFiberPool[cpu::this_core::id()];
+   auto fiber = static_cast<Fiber *>(nullptr);
+
+   if (!pool.empty()) {
+      fiber = pool.back();
+      pool.pop_back();
+      sPooledFibers--;
+      sFiberPoolHits++;
+   } else {
+      fiber = new Fiber();
+      fiber->tracer = cpu::allocTracer(1024 * 10 * 10);
+      fiber->handle = platform::createFiber(fiberEntryPoint, nullptr, decaf::config::system::fiber_stack_size);
+      sFiberPoolMisses++;
+   }
+
    fiber->context = context;
+   fiber->timebase = 0;
+
+   auto live = ++sLiveFibers;
+   auto peak = sPeakLiveFibers.load();
+
+   while (live > peak && !sPeakLiveFibers.compare_exchange_weak(peak, live)) {
+   }
+
    return fiber;
 }
 
@@ -200,16 +259,41 @@ reallocateContextFiber(coreinit::OSContext *context,
                        platform::FiberEntryPoint entry)
 {
    auto oldFiber = context->fiber->handle;
-   auto newFiber = platform::createFiber(entry, nullptr);
+   auto newFiber = platform::createFiber(entry, nullptr, decaf::config::system::fiber_stack_size);
    context->fiber->handle = newFiber;
+   context->fiber->recyclable = false;
    platform::swapToFiber(oldFiber, newFiber);
 }
 
 static void
 freeFiber(Fiber *fiber)
 {
+   auto &pool = sFiberPool[cpu::this_core::id()];
+   sLiveFibers--;
+
+   if (fiber->recyclable && pool.size() < MaxPooledFibersPerCore) {
+      platform::resetFiber(fiber->handle);
+      fiber->context = nullptr;
+      pool.push_back(fiber);
+      sPooledFibers++;
+      return;
+   }
+
    cpu::freeTracer(fiber->tracer);
    platform::destroyFiber(fiber->handle);
+   delete fiber;
+}
+
+FiberPoolStats
+getFiberPoolStats()
+{
+   FiberPoolStats stats;
+   stats.hits = sFiberPoolHits.load();
+   stats.misses = sFiberPoolMisses.load();
+   stats.live = sLiveFibers.load();
+   stats.peakLive = sPeakLiveFibers.load();
+   stats.pooled = sPooledFibers.load();
+   return stats;
 }
 
 // This must be called under the same scheduler lock
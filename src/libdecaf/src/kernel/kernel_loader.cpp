@@ -20,6 +20,7 @@
 #include <common/teenyheap.h>
 #include <common/strutils.h>
 #include <gsl.h>
+#include <libcpu/cpu.h>
 #include <libcpu/mem.h>
 #include <map>
 #include <unordered_map>
@@ -1130,6 +1131,13 @@ loadRPL(const std::string &moduleName,
       loadedMod->sections.emplace_back(LoadedSection { "loader_thunks", LoadedSectionType::Code, trampSeg.first, trampSeg.second });
    }
 
+   // Relocations have rewritten the code, make sure nothing stale is cached
+   for (auto &section : loadedMod->sections) {
+      if (section.type == LoadedSectionType::Code) {
+         cpu::invalidateInstructionCache(section.start, section.end - section.start);
+      }
+   }
+
    // Add the modules entry point as an symbol called 'start'
    loadedMod->symbols.emplace("__start", Symbol{ entryPoint, SymbolType::Function });
 
@@ -10,9 +10,13 @@
 #include "coreinit_internal_idlock.h"
 #include "ppcutils/wfunc_call.h"
 
+#include <algorithm>
 #include <array>
+#include <common/bitutils.h>
 #include <common/decaf_assert.h>
 #include <libcpu/cpu.h>
+#include <limits>
+#include <vector>
 
 namespace coreinit
 {
@@ -34,11 +38,54 @@ OSAlarm::Tag;
 const uint32_t
 OSAlarmQueue::Tag;
 
+static const uint32_t
+AlarmWheelLevels = 5;
+
+static const uint32_t
+AlarmWheelSlotBits = 6;
+
+static const uint32_t
+AlarmWheelSlots = 1 << AlarmWheelSlotBits;
+
+//! Each level 0 slot covers 2^8 ticks, so the five levels together cover
+//!  2^38 ticks (a bit over an hour) before alarms go to the overflow list.
+static const uint32_t
+AlarmWheelGranularityBits = 8;
+
+/**
+ * The alarms set on a core are kept in a hierarchical timer wheel indexed by
+ * nextFire.  A slot at level n holds alarms which fire within the same level
+ * n + 1 slot as the current time, so the further away an alarm is the higher
+ * the level it sits in.  As time moves forward the slots it passes are
+ * emptied and their alarms placed again, either expiring them or moving them
+ * down a level.
+ *
+ * Every slot is an OSAlarmQueue, so alarm->alarmQueue still points at the
+ * list to erase the alarm from when it is cancelled.
+ */
+struct AlarmWheel
+{
+   OSAlarmQueue slots[AlarmWheelLevels][AlarmWheelSlots];
+   OSAlarmQueue overflow;
+};
+
+struct AlarmWheelState
+{
+   //! Time the wheel was last advanced to
+   OSTime now = 0;
+
+   //! Bit n of level l is set when slots[l][n] is not empty
+   std::array<uint64_t, AlarmWheelLevels> occupied;
+};
+
 static internal::IdLock
 sAlarmLock;
 
-static std::array<OSAlarmQueue *, CoreCount>
-sAlarmQueue;
+static std::array<AlarmWheel *, CoreCount>
+sAlarmWheel;
+
+static std::array<AlarmWheelState, CoreCount>
+sAlarmWheelState;
 
 static std::array<OSAlarmQueue *, CoreCount>
 sAlarmCallbackQueue;
@@ -49,6 +96,203 @@ sAlarmCallbackThread;
 static std::array<OSThreadQueue *, CoreCount>
 sAlarmCallbackThreadQueue;
 
+static uint32_t
+getWheelShift(uint32_t level)
+{
+   return AlarmWheelGranularityBits + level * AlarmWheelSlotBits;
+}
+
+/**
+ * Add an alarm to the timer wheel of a core.
+ */
+static void
+insertAlarm(uint32_t coreId,
+            OSAlarm *alarm)
+{
+   auto wheel = sAlarmWheel[coreId];
+   auto &state = sAlarmWheelState[coreId];
+   auto queue = &wheel->overflow;
+
+   // Alarms which are already due go in the current slot so the next advance
+   //  expires them.
+   auto now = static_cast<uint64_t>(state.now);
+   auto fire = std::max(static_cast<uint64_t>(alarm->nextFire), now);
+
+   for (auto level = 0u; level < AlarmWheelLevels; ++level) {
+      auto pageShift = getWheelShift(level + 1);
+
+      if ((fire >> pageShift) == (now >> pageShift)) {
+         auto slot = (fire >> getWheelShift(level)) & (AlarmWheelSlots - 1);
+         queue = &wheel->slots[level][slot];
+         state.occupied[level] |= 1ull << slot;
+         break;
+      }
+   }
+
+   internal::AlarmQueue::append(queue, alarm);
+   alarm->alarmQueue = queue;
+}
+
+/**
+ * Remove an alarm from whichever queue it is in.
+ */
+static void
+eraseAlarm(OSAlarm *alarm)
+{
+   OSAlarmQueue *queue = alarm->alarmQueue;
+
+   if (!queue) {
+      return;
+   }
+
+   internal::AlarmQueue::erase(queue, alarm);
+   alarm->alarmQueue = nullptr;
+
+   if (queue->head) {
+      return;
+   }
+
+   // If that emptied a wheel slot it must no longer be marked occupied
+   for (auto i = 0u; i < CoreCount; ++i) {
+      auto first = &sAlarmWheel[i]->slots[0][0];
+      auto index = queue - first;
+
+      if (index >= 0 && index < AlarmWheelLevels * AlarmWheelSlots) {
+         auto level = index / AlarmWheelSlots;
+         auto slot = index % AlarmWheelSlots;
+         sAlarmWheelState[i].occupied[level] &= ~(1ull << slot);
+         break;
+      }
+   }
+}
+
+/**
+ * Place all the alarms of a queue again after time has moved on, the ones
+ * which are now due are added to expired instead.
+ */
+static void
+replaceAlarms(uint32_t coreId,
+              OSAlarmQueue *queue,
+              std::vector<OSAlarm *> &expired)
+{
+   OSAlarm *alarm = queue->head;
+   internal::AlarmQueue::init(queue);
+
+   while (alarm) {
+      OSAlarm *next = alarm->link.next;
+      internal::AlarmQueue::initLink(alarm);
+      alarm->alarmQueue = nullptr;
+
+      if (alarm->nextFire <= sAlarmWheelState[coreId].now) {
+         expired.push_back(alarm);
+      } else {
+         insertAlarm(coreId, alarm);
+      }
+
+      alarm = next;
+   }
+}
+
+/**
+ * Move the timer wheel of a core forward to now, calling expire for every
+ * alarm which is due in the order they were due.
+ */
+template<typename ExpireFunc>
+static void
+advanceAlarmWheel(uint32_t coreId,
+                  OSTime now,
+                  ExpireFunc expire)
+{
+   auto wheel = sAlarmWheel[coreId];
+   auto &state = sAlarmWheelState[coreId];
+   auto last = static_cast<uint64_t>(state.now);
+   auto current = static_cast<uint64_t>(std::max<OSTime>(now, state.now));
+   auto expired = std::vector<OSAlarm *> { };
+   state.now = static_cast<OSTime>(current);
+
+   if ((last >> getWheelShift(AlarmWheelLevels)) != (current >> getWheelShift(AlarmWheelLevels))) {
+      replaceAlarms(coreId, &wheel->overflow, expired);
+   }
+
+   // Working down from the top level means an alarm is only ever moved down,
+   //  so each alarm is placed again at most once per level.
+   for (auto level = AlarmWheelLevels; level-- > 0; ) {
+      auto shift = getWheelShift(level);
+      auto pageShift = getWheelShift(level + 1);
+      auto mask = ~0ull;
+
+      // Within the same page only the slots from the last time up to the
+      //  current time have been reached, otherwise the whole old page has.
+      if ((last >> pageShift) == (current >> pageShift)) {
+         auto from = (last >> shift) & (AlarmWheelSlots - 1);
+         auto to = (current >> shift) & (AlarmWheelSlots - 1);
+         mask = (~0ull >> (63 - to)) & (~0ull << from);
+      }
+
+      auto reached = state.occupied[level] & mask;
+      state.occupied[level] &= ~reached;
+
+      while (reached) {
+         auto slot = 63 - clz64(reached & (~reached + 1));
+         reached &= reached - 1;
+         replaceAlarms(coreId, &wheel->slots[level][slot], expired);
+      }
+   }
+
+   std::stable_sort(expired.begin(), expired.end(), [](OSAlarm *lhs, OSAlarm *rhs) {
+      return lhs->nextFire < rhs->nextFire;
+   });
+
+   for (auto alarm : expired) {
+      // An earlier callback may have cancelled or set the alarm again
+      if (alarm->alarmQueue || alarm->state != OSAlarmState::Set) {
+         continue;
+      }
+
+      expire(alarm);
+   }
+}
+
+/**
+ * Find the time of the next alarm to fire on a core.
+ */
+static bool
+getNextAlarmFire(uint32_t coreId,
+                 OSTime &next)
+{
+   auto wheel = sAlarmWheel[coreId];
+   auto &state = sAlarmWheelState[coreId];
+   OSAlarmQueue *queue = nullptr;
+
+   // Every alarm in a level fires before any alarm in the levels above it,
+   //  and the slots behind the current time are always empty, so the next
+   //  alarm is in the lowest occupied slot of the lowest occupied level.
+   for (auto level = 0u; level < AlarmWheelLevels && !queue; ++level) {
+      auto occupied = state.occupied[level];
+
+      if (occupied) {
+         auto slot = 63 - clz64(occupied & (~occupied + 1));
+         queue = &wheel->slots[level][slot];
+      }
+   }
+
+   if (!queue) {
+      queue = &wheel->overflow;
+   }
+
+   if (!queue->head) {
+      return false;
+   }
+
+   next = queue->head->nextFire;
+
+   for (OSAlarm *alarm = queue->head; alarm; alarm = alarm->link.next) {
+      next = std::min<OSTime>(next, alarm->nextFire);
+   }
+
+   return true;
+}
+
 /**
  * Internal alarm cancel.
  *
@@ -68,12 +312,7 @@ cancelAlarmNoAlarmLock(OSAlarm *alarm)
    alarm->state = OSAlarmState::None;
    alarm->nextFire = 0;
    alarm->period = 0;
-
-   if (alarm->alarmQueue) {
-      internal::AlarmQueue::erase(alarm->alarmQueue, alarm);
-      alarm->alarmQueue = nullptr;
-   }
-
+   eraseAlarm(alarm);
    return TRUE;
 }
 
@@ -116,9 +355,7 @@ OSCancelAlarms(uint32_t group)
    internal::lockScheduler();
    internal::acquireIdLock(sAlarmLock);
 
-   for (auto i = 0u; i < 3; ++i) {
-      auto queue = sAlarmQueue[i];
-
+   auto cancelGroup = [group](OSAlarmQueue *queue) {
       for (OSAlarm *alarm = queue->head; alarm; ) {
          auto next = alarm->link.next;
 
@@ -134,6 +371,18 @@ OSCancelAlarms(uint32_t group)
 
          alarm = next;
       }
+   };
+
+   for (auto i = 0u; i < CoreCount; ++i) {
+      auto wheel = sAlarmWheel[i];
+
+      for (auto level = 0u; level < AlarmWheelLevels; ++level) {
+         for (auto slot = 0u; slot < AlarmWheelSlots; ++slot) {
+            cancelGroup(&wheel->slots[level][slot]);
+         }
+      }
+
+      cancelGroup(&wheel->overflow);
    }
 
    internal::releaseIdLock(sAlarmLock);
@@ -237,20 +486,12 @@ OSSetPeriodicAlarm(OSAlarm *alarm,
    alarm->state = OSAlarmState::Set;
 
    // Erase from old alarm queue
-   if (alarm->alarmQueue) {
-      internal::AlarmQueue::erase(alarm->alarmQueue, alarm);
-      alarm->alarmQueue = nullptr;
-   }
+   eraseAlarm(alarm);
 
-   // Add to this core's alarm queue
-   auto core = OSGetCoreId();
-   auto queue = sAlarmQueue[core];
-   alarm->alarmQueue = queue;
-   internal::AlarmQueue::append(queue, alarm);
+   // Add to this core's alarm wheel
+   insertAlarm(OSGetCoreId(), alarm);
 
    // Set the interrupt timer in processor
-   // TODO: Store the last set CPU alarm time, and simply check this
-   // alarm against that time to make finding the soonest alarm cheaper.
    internal::updateCpuAlarmNoALock();
 
    internal::releaseIdLock(sAlarmLock, alarm);
@@ -324,7 +565,6 @@ uint32_t
 AlarmCallbackThreadEntry(uint32_t core_id,
                          void *arg2)
 {
-   auto queue = sAlarmQueue[core_id];
    auto cbQueue = sAlarmCallbackQueue[core_id];
    auto threadQueue = sAlarmCallbackThreadQueue[core_id];
 
@@ -346,8 +586,7 @@ AlarmCallbackThreadEntry(uint32_t core_id,
       if (alarm->period) {
          alarm->nextFire = alarm->nextFire + alarm->period;
          alarm->state = OSAlarmState::Set;
-         internal::AlarmQueue::append(queue, alarm);
-         alarm->alarmQueue = queue;
+         insertAlarm(core_id, alarm);
          internal::updateCpuAlarmNoALock();
       }
 
@@ -378,7 +617,7 @@ Module::registerAlarmFunctions()
    RegisterKernelFunction(OSWaitAlarm);
 
    RegisterInternalFunction(AlarmCallbackThreadEntry, sAlarmCallbackThreadEntryPoint);
-   RegisterInternalData(sAlarmQueue);
+   RegisterInternalData(sAlarmWheel);
    RegisterInternalData(sAlarmCallbackQueue);
    RegisterInternalData(sAlarmCallbackThreadQueue);
    RegisterInternalData(sAlarmCallbackThread);
@@ -388,7 +627,16 @@ void
 Module::initialiseAlarm()
 {
    for (auto i = 0u; i < CoreCount; ++i) {
-      OSInitAlarmQueue(sAlarmQueue[i]);
+      for (auto level = 0u; level < AlarmWheelLevels; ++level) {
+         for (auto slot = 0u; slot < AlarmWheelSlots; ++slot) {
+            OSInitAlarmQueue(&sAlarmWheel[i]->slots[level][slot]);
+         }
+      }
+
+      OSInitAlarmQueue(&sAlarmWheel[i]->overflow);
+      sAlarmWheelState[i].now = 0;
+      sAlarmWheelState[i].occupied.fill(0);
+
       OSInitAlarmQueue(sAlarmCallbackQueue[i]);
       OSInitThreadQueue(sAlarmCallbackThreadQueue[i]);
    }
@@ -434,77 +682,49 @@ cancelAlarm(OSAlarm *alarm)
 void
 updateCpuAlarmNoALock()
 {
-   auto queue = sAlarmQueue[cpu::this_core::id()];
-   auto next = std::chrono::steady_clock::time_point::max();
-
-   for (OSAlarm *alarm = queue->head; alarm; ) {
-      auto nextAlarm = alarm->link.next;
+   auto next = OSTime { 0 };
 
-      // Update next if its not past yet
-      if (alarm->state == OSAlarmState::Set && alarm->nextFire) {
-         auto nextFire = cpu::tbToTimePoint(alarm->nextFire - internal::getBaseTime());
-
-         if (nextFire < next) {
-            next = nextFire;
-         }
-      }
-
-      alarm = nextAlarm;
+   if (getNextAlarmFire(cpu::this_core::id(), next)) {
+      cpu::this_core::setNextAlarm(static_cast<uint64_t>(next - internal::getBaseTime()));
+   } else {
+      cpu::this_core::setNextAlarm(std::numeric_limits<uint64_t>::max());
    }
-
-   cpu::this_core::setNextAlarm(next);
 }
 
 void
 handleAlarmInterrupt(OSContext *context)
 {
    auto core_id = cpu::this_core::id();
-   auto queue = sAlarmQueue[core_id];
    auto cbQueue = sAlarmCallbackQueue[core_id];
    auto cbThreadQueue = sAlarmCallbackThreadQueue[core_id];
-
    auto now = OSGetTime();
-   auto next = std::chrono::time_point<std::chrono::system_clock>::max();
-   bool callbacksNeeded = false;
 
    internal::lockScheduler();
    acquireIdLock(sAlarmLock);
 
-   for (OSAlarm *alarm = queue->head; alarm; ) {
-      auto nextAlarm = alarm->link.next;
-
-      // Expire it if its past its nextFire time
-      if (alarm->nextFire <= now) {
-         decaf_check(alarm->state == OSAlarmState::Set);
+   advanceAlarmWheel(core_id, now, [&](OSAlarm *alarm) {
+      alarm->state = OSAlarmState::Expired;
+      alarm->context = context;
 
-         internal::AlarmQueue::erase(queue, alarm);
-         alarm->alarmQueue = nullptr;
-
-         alarm->state = OSAlarmState::Expired;
-         alarm->context = context;
+      if (alarm->threadQueue.head) {
+         wakeupThreadNoLock(&alarm->threadQueue);
+         rescheduleOtherCoreNoLock();
+      }
 
-         if (alarm->threadQueue.head) {
-            wakeupThreadNoLock(&alarm->threadQueue);
-            rescheduleOtherCoreNoLock();
+      if (alarm->group == 0xFFFFFFFF) {
+         // System-internal alarm
+         if (alarm->callback) {
+            auto originalMask = cpu::this_core::setInterruptMask(0);
+            alarm->callback(alarm, context);
+            cpu::this_core::setInterruptMask(originalMask);
          }
+      } else {
+         internal::AlarmQueue::append(cbQueue, alarm);
+         alarm->alarmQueue = cbQueue;
 
-         if (alarm->group == 0xFFFFFFFF) {
-            // System-internal alarm
-            if (alarm->callback) {
-               auto originalMask = cpu::this_core::setInterruptMask(0);
-               alarm->callback(alarm, context);
-               cpu::this_core::setInterruptMask(originalMask);
-            }
-         } else {
-            internal::AlarmQueue::append(cbQueue, alarm);
-            alarm->alarmQueue = cbQueue;
-
-            wakeupThreadNoLock(cbThreadQueue);
-         }
+         wakeupThreadNoLock(cbThreadQueue);
       }
-
-      alarm = nextAlarm;
-   }
+   });
 
    internal::updateCpuAlarmNoALock();
 
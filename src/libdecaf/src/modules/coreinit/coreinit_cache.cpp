@@ -3,6 +3,8 @@
 #include "gpu/gpu_flush.h"
 
 #include <common/align.h>
+#include <libcpu/cpu.h>
+#include <libcpu/mem.h>
 
 namespace coreinit
 {
@@ -31,6 +33,10 @@ DCFlushRange(void *addr, uint32_t size)
 
    // Also signal the memory store to the GPU.
    gpu::notifyCpuFlush(addr, size);
+
+   // Catch code modification which is not followed by an ICInvalidateRange,
+   //  this is cheap for ranges which have never held translated code.
+   cpu::invalidateInstructionCache(mem::untranslate(addr), size);
 }
 
 
@@ -92,6 +98,15 @@ DCTouchRange(void *addr, uint32_t size)
    // TODO: DCTouchRange
 }
 
+/**
+ * Equivalent to icbi instruction.
+ */
+void
+ICInvalidateRange(void *addr, uint32_t size)
+{
+   cpu::invalidateInstructionCache(mem::untranslate(addr), size);
+}
+
 BOOL
 OSIsAddressRangeDCValid(void *addr,
                         uint32_t size)
@@ -116,6 +131,7 @@ Module::registerCacheFunctions()
    RegisterKernelFunction(DCStoreRangeNoSync);
    RegisterKernelFunction(DCZeroRange);
    RegisterKernelFunction(DCTouchRange);
+   RegisterKernelFunction(ICInvalidateRange);
    RegisterKernelFunction(OSIsAddressRangeDCValid);
    RegisterKernelFunction(OSCoherencyBarrier);
 }
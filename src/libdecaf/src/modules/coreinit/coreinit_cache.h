@@ -39,6 +39,10 @@ void
 DCTouchRange(void *addr,
              uint32_t size);
 
+void
+ICInvalidateRange(void *addr,
+                  uint32_t size);
+
 BOOL
 OSIsAddressRangeDCValid(void *addr,
                         uint32_t size);
@@ -9,9 +9,11 @@
 #include "coreinit_memheap.h"
 #include "filesystem/filesystem.h"
 #include <condition_variable>
-#include <thread>
+#include <map>
 #include <mutex>
-#include <queue>
+#include <set>
+#include <thread>
+#include <vector>
 
 namespace coreinit
 {
@@ -65,16 +67,46 @@ FSGetCmdPriority(FSCmdBlock *block)
 namespace internal
 {
 
-struct FSCmdBlockSortFn
+// Commands are run on a pool of worker threads.  Each client only has one
+//  command running at a time, so commands from a client (and therefore on any
+//  of its file handles) still run in the order they were queued, while other
+//  clients are not held up behind a long read.
+static const auto
+NumFsThreads = 4u;
+
+struct FsQueuedCommand
+{
+   FSCmdBlock *block;
+
+   //! Priority of the block when it was queued, FSSetCmdPriority may change
+   //!  the block while it is in the set and the ordering must not change.
+   FSPriority priority;
+   uint64_t sequence;
+};
+
+// Lower priority values run first, commands of equal priority run in the
+//  order they were queued.
+struct FsQueuedCommandSortFn
 {
-   bool operator()(const FSCmdBlock *lhs, const FSCmdBlock *rhs) const
+   bool operator()(const FsQueuedCommand &lhs, const FsQueuedCommand &rhs) const
    {
-      return lhs->priority < rhs->priority;
+      if (lhs.priority != rhs.priority) {
+         return lhs.priority < rhs.priority;
+      }
+
+      return lhs.sequence < rhs.sequence;
    }
 };
 
-static std::thread
-sFsThread;
+struct FsClientQueue
+{
+   //! True while a worker is running one of this client's commands
+   bool busy = false;
+   std::set<FsQueuedCommand, FsQueuedCommandSortFn> pending;
+};
+
+static std::vector<std::thread>
+sFsThreads;
 
 static std::atomic_bool
 sFsThreadRunning;
@@ -85,22 +117,30 @@ sFsQueueMutex;
 static std::condition_variable
 sFsQueueCond;
 
-static std::priority_queue<FSCmdBlock *, std::vector<FSCmdBlock *>, FSCmdBlockSortFn>
-sFsQueue;
+static std::map<FSClient *, FsClientQueue>
+sFsClientQueues;
 
-static std::queue<FSCmdBlock *>
+static uint64_t
+sFsQueueSequence = 0;
+
+static std::vector<FSCmdBlock *>
 sFsDoneQueue;
 
 void
 handleFsDoneInterrupt()
 {
-   std::unique_lock<std::mutex> lock(sFsQueueMutex);
+   // Take every command which completed since the last interrupt at once,
+   //  the workers only raise a new interrupt once this queue is empty.
+   std::vector<FSCmdBlock *> done;
+
+   {
+      std::unique_lock<std::mutex> lock(sFsQueueMutex);
+      done.swap(sFsDoneQueue);
+   }
 
-   while (!sFsDoneQueue.empty()) {
-      auto item = sFsDoneQueue.front();
+   for (auto item : done) {
       auto queue = item->result.userParams.queue;
       auto &msg = item->result.ioMsg;
-      sFsDoneQueue.pop();
 
       msg.message = &item->result;
       msg.args[2] = AppIoEventType::FsAsyncCallback;
@@ -113,36 +153,74 @@ handleFsDoneInterrupt()
    }
 }
 
-void
-fsThreadEntry()
+static FSCmdBlock *
+popFsCommandNoLock(FSClient *&client)
 {
-   std::unique_lock<std::mutex> lock(sFsQueueMutex);
-
-   while (true)
-   {
-      if (!sFsQueue.empty()) {
-         auto item = sFsQueue.top();
-         sFsQueue.pop();
-         lock.unlock();
+   auto best = sFsClientQueues.end();
 
-         item->result.status = item->func();
+   for (auto itr = sFsClientQueues.begin(); itr != sFsClientQueues.end(); ++itr) {
+      auto &queue = itr->second;
 
-         lock.lock();
-         sFsDoneQueue.push(item);
-         cpu::interrupt(sFsCoreId, cpu::FS_DONE_INTERRUPT);
+      if (queue.busy || queue.pending.empty()) {
+         continue;
       }
 
-      // This check needs to be here due to us unlocking the thread
-      //  to run the fs function.  This gives a window for the shutdown
-      //  notification to be missed.
-      if (!sFsThreadRunning.load()) {
-         break;
+      if (best == sFsClientQueues.end()
+       || FsQueuedCommandSortFn { }(*queue.pending.begin(), *best->second.pending.begin())) {
+         best = itr;
       }
+   }
+
+   if (best == sFsClientQueues.end()) {
+      return nullptr;
+   }
+
+   auto &queue = best->second;
+   auto block = queue.pending.begin()->block;
+   queue.pending.erase(queue.pending.begin());
+   queue.busy = true;
+   client = best->first;
+   return block;
+}
+
+static void
+completeFsCommandNoLock(FSClient *client,
+                        FSCmdBlock *block)
+{
+   auto itr = sFsClientQueues.find(client);
+   itr->second.busy = false;
+
+   if (itr->second.pending.empty()) {
+      sFsClientQueues.erase(itr);
+   }
+
+   // If the done queue was not empty an interrupt is already on its way
+   sFsDoneQueue.push_back(block);
+
+   if (sFsDoneQueue.size() == 1) {
+      cpu::interrupt(sFsCoreId, cpu::FS_DONE_INTERRUPT);
+   }
+}
+
+void
+fsThreadEntry()
+{
+   std::unique_lock<std::mutex> lock(sFsQueueMutex);
+
+   while (sFsThreadRunning.load()) {
+      auto client = static_cast<FSClient *>(nullptr);
+      auto item = popFsCommandNoLock(client);
 
-      // Wait if we don't have any items to process
-      if (sFsQueue.empty()) {
+      if (!item) {
          sFsQueueCond.wait(lock);
+         continue;
       }
+
+      lock.unlock();
+      item->result.status = item->func();
+      lock.lock();
+
+      completeFsCommandNoLock(client, item);
    }
 }
 
@@ -151,7 +229,10 @@ startFsThread()
 {
    std::unique_lock<std::mutex> lock(sFsQueueMutex);
    sFsThreadRunning.store(true);
-   sFsThread = std::thread(fsThreadEntry);
+
+   for (auto i = 0u; i < NumFsThreads; ++i) {
+      sFsThreads.emplace_back(fsThreadEntry);
+   }
 }
 
 void
@@ -162,7 +243,11 @@ shutdownFsThread()
       sFsQueueCond.notify_all();
       lock.unlock();
 
-      sFsThread.join();
+      for (auto &thread : sFsThreads) {
+         thread.join();
+      }
+
+      sFsThreads.clear();
    }
 }
 
@@ -209,8 +294,8 @@ queueFsWork(FSClient *client,
 
    block->func = func;
    std::unique_lock<std::mutex> lock(sFsQueueMutex);
-   sFsQueue.push(block);
-   sFsQueueCond.notify_all();
+   sFsClientQueues[client].pending.insert(FsQueuedCommand { block, block->priority, sFsQueueSequence++ });
+   sFsQueueCond.notify_one();
 }
 
 // We do not implement the following as I do not know the expected
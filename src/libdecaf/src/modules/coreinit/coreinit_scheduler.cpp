@@ -19,6 +19,7 @@
 #include "ppcutils/wfunc_call.h"
 #include "ppcutils/stackobject.h"
 #include <common/decaf_assert.h>
+#include <common/ticketlock.h>
 
 namespace coreinit
 {
@@ -29,8 +30,12 @@ SchedulerLockNonCpuCoreId = 1u << 31;
 static bool
 sSchedulerEnabled[3];
 
+static TicketLock
+sSchedulerLock;
+
+//! Which core holds sSchedulerLock, as 1 << core id or SchedulerLockNonCpuCoreId
 static std::atomic<uint32_t>
-sSchedulerLock { 0 };
+sSchedulerLockOwner { 0 };
 
 static OSThreadQueue *
 sActiveThreads;
@@ -97,47 +102,44 @@ getCurrentThread()
    return sCurrentThread[cpu::this_core::id()];
 }
 
-void
-lockScheduler()
+static uint32_t
+getSchedulerLockCore()
 {
-   uint32_t expected = 0;
    auto id = cpu::this_core::id();
-   auto core = 1 << id;
 
    if (id == cpu::InvalidCoreId) {
-      core = SchedulerLockNonCpuCoreId;
+      return SchedulerLockNonCpuCoreId;
    }
 
-   while (!sSchedulerLock.compare_exchange_weak(expected, core, std::memory_order_acquire)) {
-      expected = 0;
-   }
+   return 1 << id;
+}
+
+void
+lockScheduler()
+{
+   auto core = getSchedulerLockCore();
+   sSchedulerLock.lock();
+   sSchedulerLockOwner.store(core, std::memory_order_relaxed);
 }
 
 bool
 isSchedulerLocked()
 {
-   auto id = cpu::this_core::id();
-   auto core = 1 << id;
-
-   if (id == cpu::InvalidCoreId) {
-      core = SchedulerLockNonCpuCoreId;
-   }
-
-   return sSchedulerLock.load(std::memory_order_acquire) == core;
+   return sSchedulerLockOwner.load(std::memory_order_relaxed) == getSchedulerLockCore();
 }
 
 void
 unlockScheduler()
 {
-   auto id = cpu::this_core::id();
-   auto core = 1 << id;
-
-   if (id == cpu::InvalidCoreId) {
-      core = SchedulerLockNonCpuCoreId;
-   }
+   auto oldCore = sSchedulerLockOwner.exchange(0, std::memory_order_relaxed);
+   decaf_check(oldCore == getSchedulerLockCore());
+   sSchedulerLock.unlock();
+}
 
-   auto oldCore = sSchedulerLock.exchange(0, std::memory_order_release);
-   decaf_check(oldCore == core);
+TicketLock::Stats
+getSchedulerLockStats()
+{
+   return sSchedulerLock.stats();
 }
 
 bool
@@ -1,5 +1,6 @@
 #pragma once
 #include "coreinit_thread.h"
+#include <common/ticketlock.h>
 #include <cstdint>
 
 namespace coreinit
@@ -38,6 +39,9 @@ isSchedulerLocked();
 void
 unlockScheduler();
 
+TicketLock::Stats
+getSchedulerLockStats();
+
 bool
 isSchedulerEnabled();
 
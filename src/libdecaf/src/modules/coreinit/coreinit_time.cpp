@@ -135,10 +135,16 @@ Module::initialiseClock()
    tm.tm_isdst = -1;
    sEpochTime = std::chrono::system_clock::from_time_t(platform::make_gm_time(tm));
 
-   sBaseClock = std::chrono::system_clock::now();
-   auto ticksSinceEpoch = std::chrono::duration_cast<cpu::TimerDuration>(sBaseClock - sEpochTime);
-   auto ticksSinceStart = cpu::TimerDuration(cpu::this_core::state()->tb());
-   sBaseTicks = ticksSinceEpoch - ticksSinceStart;
+   if (decaf::config::system::instruction_timebase) {
+      // Boot at the epoch so every run sees the same calendar time
+      sBaseClock = sEpochTime;
+      sBaseTicks = cpu::TimerDuration { 0 };
+   } else {
+      sBaseClock = std::chrono::system_clock::now();
+      auto ticksSinceEpoch = std::chrono::duration_cast<cpu::TimerDuration>(sBaseClock - sEpochTime);
+      auto ticksSinceStart = cpu::TimerDuration(cpu::this_core::state()->tb());
+      sBaseTicks = ticksSinceEpoch - ticksSinceStart;
+   }
 }
 
 void
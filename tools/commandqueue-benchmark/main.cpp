@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <chrono>
+#include <common/mpscqueue.h>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gpu/pm4_buffer.h"
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+static const auto DefaultBufferCount = 4000000u;
+
+// Must be larger than the queue capacity so a buffer is never reused while
+//  it is still in flight.
+static const auto BufferPoolSize = 8192u;
+
+using Clock = std::chrono::steady_clock;
+
+// The mutex and condition variable queue gpu::CommandQueue used to be
+class MutexQueue
+{
+public:
+   void push(pm4::Buffer *buf)
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      mQueue.push(buf);
+      mCV.notify_all();
+   }
+
+   bool waitPop(pm4::Buffer *&buf)
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+
+      while (!mQueue.size()) {
+         mCV.wait(lock);
+      }
+
+      buf = mQueue.front();
+      mQueue.pop();
+      return true;
+   }
+
+private:
+   std::mutex mMutex;
+   std::condition_variable mCV;
+   std::queue<pm4::Buffer *> mQueue;
+};
+
+using RingQueue = MpscQueue<pm4::Buffer *, 1024>;
+
+static uint64_t
+nanoseconds(Clock::time_point time)
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+static void
+printPercentiles(const std::string &name, std::vector<uint64_t> &samples)
+{
+   std::sort(samples.begin(), samples.end());
+
+   auto percentile = [&](double p) {
+      auto index = static_cast<size_t>(p * (samples.size() - 1));
+      return samples[index];
+   };
+
+   gLog->info("  {:<10} p50 {:>7} ns  p90 {:>7} ns  p99 {:>7} ns  p99.9 {:>8} ns  max {:>9} ns",
+              name,
+              percentile(0.5),
+              percentile(0.9),
+              percentile(0.99),
+              percentile(0.999),
+              samples.back());
+}
+
+template<typename QueueType>
+static void
+benchmark(const std::string &name, uint32_t count)
+{
+   auto queue = std::make_unique<QueueType>();
+   auto buffers = std::vector<pm4::Buffer>(BufferPoolSize);
+   auto submitTimes = std::vector<uint64_t>(count);
+   auto submitLatency = std::vector<uint64_t>(count);
+   auto queueLatency = std::vector<uint64_t>(count);
+
+   auto consumer = std::thread {
+      [&]() {
+         for (auto i = 0u; i < count; ++i) {
+            pm4::Buffer *buf = nullptr;
+
+            while (!queue->waitPop(buf)) {
+            }
+
+            // curSize carries the submission index
+            auto index = buf->curSize;
+            queueLatency[index] = nanoseconds(Clock::now()) - submitTimes[index];
+         }
+      }
+   };
+
+   auto start = Clock::now();
+
+   for (auto i = 0u; i < count; ++i) {
+      auto buf = &buffers[i % BufferPoolSize];
+      buf->curSize = i;
+
+      auto submitStart = Clock::now();
+      submitTimes[i] = nanoseconds(submitStart);
+      queue->push(buf);
+      submitLatency[i] = nanoseconds(Clock::now()) - submitTimes[i];
+   }
+
+   consumer.join();
+
+   auto total = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+   gLog->info("{}: {} buffers in {:.2f} ms, {:.1f} ns/buffer",
+              name,
+              count,
+              total / 1000000.0,
+              static_cast<double>(total) / count);
+   printPercentiles("submit", submitLatency);
+   printPercentiles("queue", queueLatency);
+}
+
+int main(int argc, char **argv)
+{
+   std::vector<spdlog::sink_ptr> sinks;
+   sinks.push_back(spdlog::sinks::stdout_sink_st::instance());
+   gLog = std::make_shared<spdlog::logger>("decaf", begin(sinks), end(sinks));
+
+   auto count = DefaultBufferCount;
+
+   if (argc > 1) {
+      count = static_cast<uint32_t>(std::stoul(argv[1]));
+   }
+
+   if (count == 0) {
+      gLog->error("Usage: {} [buffer count]", argv[0]);
+      return 1;
+   }
+
+   benchmark<MutexQueue>("mutex queue", count);
+   benchmark<RingQueue>("mpsc ring", count);
+   return 0;
+}
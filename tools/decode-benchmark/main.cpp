@@ -0,0 +1,113 @@
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+#include "libcpu/espresso/espresso_instructionset.h"
+#include "hardware-test/hardwaretests.h"
+
+using namespace espresso;
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+static const auto BENCHMARK_ITERATIONS = 200;
+
+using DecodeFunction = InstructionInfo *(*)(Instruction);
+
+// Load the instruction words from every test file in the corpus
+static std::vector<Instruction>
+loadCorpus(const std::string &path)
+{
+   std::vector<Instruction> corpus;
+
+   for (auto i = 0u; i < static_cast<uint32_t>(InstructionID::Invalid); ++i) {
+      auto info = findInstructionInfo(static_cast<InstructionID>(i));
+      std::ifstream file { path + "/" + info->name, std::ifstream::in | std::ifstream::binary };
+
+      if (!file.is_open()) {
+         continue;
+      }
+
+      cereal::BinaryInputArchive archive(file);
+      hwtest::TestFile testFile;
+      archive(testFile);
+
+      for (auto &test : testFile.tests) {
+         corpus.push_back(test.instr);
+      }
+   }
+
+   return corpus;
+}
+
+static double
+benchmark(const std::vector<Instruction> &corpus, DecodeFunction decode)
+{
+   auto checksum = uintptr_t { 0 };
+   auto start = std::chrono::high_resolution_clock::now();
+
+   for (auto i = 0; i < BENCHMARK_ITERATIONS; ++i) {
+      for (auto instr : corpus) {
+         checksum += reinterpret_cast<uintptr_t>(decode(instr));
+      }
+   }
+
+   auto end = std::chrono::high_resolution_clock::now();
+   auto total = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+   // Stop the compiler from throwing away the decode calls
+   if (checksum == 1) {
+      gLog->debug("Unlikely checksum");
+   }
+
+   return static_cast<double>(total) / (corpus.size() * BENCHMARK_ITERATIONS);
+}
+
+int main(int argc, char **argv)
+{
+   std::vector<spdlog::sink_ptr> sinks;
+   sinks.push_back(spdlog::sinks::stdout_sink_st::instance());
+   gLog = std::make_shared<spdlog::logger>("decaf", begin(sinks), end(sinks));
+
+   auto path = std::string { "tests/cpu/input" };
+
+   if (argc > 1) {
+      path = argv[1];
+   }
+
+   initialiseInstructionSet();
+
+   auto corpus = loadCorpus(path);
+
+   if (corpus.empty()) {
+      gLog->error("No test files found in {}", path);
+      return 1;
+   }
+
+   // Both decoders must agree before their speed is worth comparing
+   auto mismatches = 0u;
+
+   for (auto instr : corpus) {
+      auto tree = decodeInstruction(instr);
+      auto flat = decodeInstructionFlat(instr);
+
+      if (tree != flat) {
+         gLog->error("Decode mismatch for {:08X}, tree {} flat {}", instr.value,
+                     tree ? tree->name : "null",
+                     flat ? flat->name : "null");
+         ++mismatches;
+      }
+   }
+
+   auto treeTime = benchmark(corpus, &decodeInstruction);
+   auto flatTime = benchmark(corpus, &decodeInstructionFlat);
+
+   gLog->info("Decoded {} instructions {} times", corpus.size(), BENCHMARK_ITERATIONS);
+   gLog->info("decodeInstruction:     {:.2f} ns/instr", treeTime);
+   gLog->info("decodeInstructionFlat: {:.2f} ns/instr", flatTime);
+   gLog->info("Speedup: {:.2f}x", treeTime / flatTime);
+
+   return mismatches ? 1 : 0;
+}
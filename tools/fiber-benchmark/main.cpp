@@ -0,0 +1,153 @@
+#include <chrono>
+#include <common/platform.h>
+#include <common/platform_fiber.h>
+#include <cstdint>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+
+#ifdef PLATFORM_POSIX
+#include <ucontext.h>
+#endif
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+static const auto DefaultSwitchCount = 10000000u;
+
+using Clock = std::chrono::steady_clock;
+
+static void
+report(const std::string &name,
+       uint32_t count,
+       Clock::duration duration)
+{
+   auto seconds = std::chrono::duration<double>(duration).count();
+
+   gLog->info("{}: {} switches in {:.2f} ms, {:.1f} ns/switch, {:.2f}M switches/s",
+              name,
+              count,
+              seconds * 1000.0,
+              seconds * 1000000000.0 / count,
+              count / seconds / 1000000.0);
+}
+
+// Two fibers switching back and forth, the way guest threads are switched
+//  by kernel::setContext.
+static struct
+{
+   platform::Fiber *main;
+   platform::Fiber *ping;
+   platform::Fiber *pong;
+   uint32_t remaining;
+} sFibers;
+
+static void
+benchmarkFibers(uint32_t count)
+{
+   sFibers.remaining = count / 2;
+   sFibers.main = platform::getThreadFiber();
+
+   sFibers.ping = platform::createFiber([](void *) {
+      while (true) {
+         platform::swapToFiber(sFibers.ping, sFibers.pong);
+      }
+   }, nullptr);
+
+   sFibers.pong = platform::createFiber([](void *) {
+      while (--sFibers.remaining) {
+         platform::swapToFiber(sFibers.pong, sFibers.ping);
+      }
+
+      platform::swapToFiber(sFibers.pong, sFibers.main);
+   }, nullptr);
+
+   auto start = Clock::now();
+   platform::swapToFiber(sFibers.main, sFibers.ping);
+   report("platform fibers", count, Clock::now() - start);
+
+   platform::destroyFiber(sFibers.ping);
+   platform::destroyFiber(sFibers.pong);
+   platform::destroyFiber(sFibers.main);
+}
+
+#ifdef PLATFORM_POSIX
+
+// The swapcontext based switch platform::Fiber used before, for comparison
+static struct
+{
+   ucontext_t main;
+   ucontext_t ping;
+   ucontext_t pong;
+   uint32_t remaining;
+} sContexts;
+
+static void
+pingEntry()
+{
+   while (true) {
+      swapcontext(&sContexts.ping, &sContexts.pong);
+   }
+}
+
+static void
+pongEntry()
+{
+   while (--sContexts.remaining) {
+      swapcontext(&sContexts.pong, &sContexts.ping);
+   }
+
+   swapcontext(&sContexts.pong, &sContexts.main);
+}
+
+static void
+benchmarkUcontext(uint32_t count)
+{
+   auto pingStack = std::vector<char>(platform::DefaultFiberStackSize);
+   auto pongStack = std::vector<char>(platform::DefaultFiberStackSize);
+   sContexts.remaining = count / 2;
+
+   getcontext(&sContexts.ping);
+   sContexts.ping.uc_stack.ss_sp = pingStack.data();
+   sContexts.ping.uc_stack.ss_size = pingStack.size();
+   sContexts.ping.uc_link = nullptr;
+   makecontext(&sContexts.ping, &pingEntry, 0);
+
+   getcontext(&sContexts.pong);
+   sContexts.pong.uc_stack.ss_sp = pongStack.data();
+   sContexts.pong.uc_stack.ss_size = pongStack.size();
+   sContexts.pong.uc_link = nullptr;
+   makecontext(&sContexts.pong, &pongEntry, 0);
+
+   auto start = Clock::now();
+   swapcontext(&sContexts.main, &sContexts.ping);
+   report("ucontext", count, Clock::now() - start);
+}
+
+#endif
+
+int main(int argc, char **argv)
+{
+   std::vector<spdlog::sink_ptr> sinks;
+   sinks.push_back(spdlog::sinks::stdout_sink_st::instance());
+   gLog = std::make_shared<spdlog::logger>("decaf", begin(sinks), end(sinks));
+
+   auto count = DefaultSwitchCount;
+
+   if (argc > 1) {
+      count = static_cast<uint32_t>(std::stoul(argv[1]));
+   }
+
+   if (count < 2) {
+      gLog->error("Usage: {} [switch count]", argv[0]);
+      return 1;
+   }
+
+#ifdef PLATFORM_POSIX
+   benchmarkUcontext(count);
+#endif
+
+   benchmarkFibers(count);
+   return 0;
+}
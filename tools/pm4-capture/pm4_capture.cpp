@@ -0,0 +1,78 @@
+#include "pm4_capture.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <libcpu/mem.h>
+#include <libdecaf/decaf_pm4replay.h>
+#include <vector>
+
+Pm4CaptureProcessor::Pm4CaptureProcessor()
+{
+   mRegisters.fill(0);
+}
+
+void
+Pm4CaptureProcessor::loadRegisterSnapshot(const uint32_t *values,
+                                          uint32_t count)
+{
+   count = std::min<uint32_t>(count, static_cast<uint32_t>(mRegisters.size()));
+   std::memcpy(mRegisters.data(), values, count * sizeof(uint32_t));
+}
+
+bool
+Pm4CaptureProcessor::readCapture(const std::string &path)
+{
+   std::ifstream file { path, std::ifstream::binary };
+
+   if (!file.is_open()) {
+      return false;
+   }
+
+   std::array<char, 4> magic;
+   file.read(magic.data(), 4);
+
+   if (!file || magic != decaf::pm4::CaptureMagic) {
+      return false;
+   }
+
+   std::vector<uint8_t> buffer;
+
+   while (true) {
+      decaf::pm4::CapturePacket packet;
+      file.read(reinterpret_cast<char *>(&packet), sizeof(decaf::pm4::CapturePacket));
+
+      if (!file) {
+         break;
+      }
+
+      buffer.resize(packet.size);
+      file.read(reinterpret_cast<char *>(buffer.data()), packet.size);
+
+      if (!file) {
+         return false;
+      }
+
+      switch (packet.type) {
+      case decaf::pm4::CapturePacket::CommandBuffer:
+         runCommandBuffer(reinterpret_cast<uint32_t *>(buffer.data()), packet.size / 4);
+         break;
+      case decaf::pm4::CapturePacket::RegisterSnapshot:
+         loadRegisterSnapshot(reinterpret_cast<uint32_t *>(buffer.data()), packet.size / 4);
+         break;
+      case decaf::pm4::CapturePacket::MemoryLoad:
+      {
+         decaf::pm4::CaptureMemoryLoad load;
+         std::memcpy(&load, buffer.data(), sizeof(decaf::pm4::CaptureMemoryLoad));
+         std::memcpy(mem::translate(load.address),
+                     buffer.data() + sizeof(decaf::pm4::CaptureMemoryLoad),
+                     packet.size - sizeof(decaf::pm4::CaptureMemoryLoad));
+         break;
+      }
+      default:
+         break;
+      }
+   }
+
+   return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "gpu/pm4_processor.h"
+
+// Walks the command buffers of a pm4 capture to track the register state
+//  without drawing anything, so no GPU is needed.  Subclasses look at the
+//  registers at every draw.
+class Pm4CaptureProcessor : public gpu::Pm4Processor
+{
+public:
+   Pm4CaptureProcessor();
+   virtual ~Pm4CaptureProcessor() = default;
+
+   //! Loads the memory of the capture at path and runs its command buffers,
+   //! returns false if it could not be read.
+   bool
+   readCapture(const std::string &path);
+
+protected:
+   //! Called with the registers as they are at every draw
+   virtual void
+   draw() = 0;
+
+   void decafSetBuffer(const pm4::DecafSetBuffer &data) override { }
+   void decafCopyColorToScan(const pm4::DecafCopyColorToScan &data) override { }
+   void decafSwapBuffers(const pm4::DecafSwapBuffers &data) override { }
+   void decafCapSyncRegisters(const pm4::DecafCapSyncRegisters &data) override { }
+   void decafClearColor(const pm4::DecafClearColor &data) override { }
+   void decafClearDepthStencil(const pm4::DecafClearDepthStencil &data) override { }
+   void decafDebugMarker(const pm4::DecafDebugMarker &data) override { }
+   void decafOSScreenFlip(const pm4::DecafOSScreenFlip &data) override { }
+   void decafCopySurface(const pm4::DecafCopySurface &data) override { }
+   void decafSetSwapInterval(const pm4::DecafSetSwapInterval &data) override { }
+   void memWrite(const pm4::MemWrite &data) override { }
+   void eventWrite(const pm4::EventWrite &data) override { }
+   void eventWriteEOP(const pm4::EventWriteEOP &data) override { }
+   void pfpSyncMe(const pm4::PfpSyncMe &data) override { }
+   void streamOutBaseUpdate(const pm4::StreamOutBaseUpdate &data) override { }
+   void streamOutBufferUpdate(const pm4::StreamOutBufferUpdate &data) override { }
+   void surfaceSync(const pm4::SurfaceSync &data) override { }
+   void applyRegister(latte::Register reg) override { }
+
+   void drawIndexAuto(const pm4::DrawIndexAuto &data) override
+   {
+      draw();
+   }
+
+   void drawIndex2(const pm4::DrawIndex2 &data) override
+   {
+      draw();
+   }
+
+   void drawIndexImmd(const pm4::DrawIndexImmd &data) override
+   {
+      draw();
+   }
+
+private:
+   void
+   loadRegisterSnapshot(const uint32_t *values,
+                        uint32_t count);
+};
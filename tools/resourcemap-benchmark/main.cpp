@@ -0,0 +1,238 @@
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <libdecaf/decaf_pm4replay.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+#include "gpu/opengl/opengl_resource.h"
+
+using gpu::opengl::Resource;
+using gpu::opengl::ResourceMemoryMap;
+
+static std::shared_ptr<spdlog::logger>
+gCliLog;
+
+// Replay the trace until at least this many queries have been timed
+static const auto MinimumQueries = 1000000u;
+
+using Clock = std::chrono::steady_clock;
+
+struct MemoryRange
+{
+   uint32_t start;
+   uint32_t size;
+};
+
+struct Trace
+{
+   std::vector<MemoryRange> resources;
+   std::vector<MemoryRange> flushes;
+};
+
+// The map ResourceMemoryMap used to be, which indexes only the first and
+//  last byte of each resource so misses flushes strictly inside a resource.
+class EndpointResourceMap
+{
+public:
+   void
+   addResource(Resource *resource)
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      auto counter = mCounter++;
+      mMemoryMap[static_cast<uint64_t>(resource->cpuMemStart) << 32 | counter] = resource;
+      mMemoryMap[static_cast<uint64_t>(resource->cpuMemEnd - 1) << 32 | counter] = resource;
+   }
+
+   template<typename Func>
+   void
+   forEach(uint32_t start, uint32_t size, Func func)
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      auto keyEnd = static_cast<uint64_t>(start + size) << 32;
+
+      for (auto itr = mMemoryMap.lower_bound(static_cast<uint64_t>(start) << 32);
+           itr != mMemoryMap.end() && itr->first < keyEnd; ++itr) {
+         func(itr->second);
+      }
+   }
+
+private:
+   std::mutex mMutex;
+   std::map<uint64_t, Resource *> mMemoryMap;
+   uint32_t mCounter = 0;
+};
+
+static bool
+isResourceLoad(decaf::pm4::CaptureMemoryLoad::MemoryType type)
+{
+   switch (type) {
+   case decaf::pm4::CaptureMemoryLoad::AttributeBuffer:
+   case decaf::pm4::CaptureMemoryLoad::UniformBuffer:
+   case decaf::pm4::CaptureMemoryLoad::IndexBuffer:
+   case decaf::pm4::CaptureMemoryLoad::Surface:
+   case decaf::pm4::CaptureMemoryLoad::FetchShader:
+   case decaf::pm4::CaptureMemoryLoad::VertexShader:
+   case decaf::pm4::CaptureMemoryLoad::PixelShader:
+   case decaf::pm4::CaptureMemoryLoad::GeometryShader:
+      return true;
+   default:
+      return false;
+   }
+}
+
+// Collects the resources and flushed ranges recorded in a PM4 capture
+static bool
+readTrace(const std::string &path, Trace &trace)
+{
+   std::ifstream file { path, std::ifstream::binary };
+
+   if (!file.is_open()) {
+      return false;
+   }
+
+   std::array<char, 4> magic;
+   file.read(magic.data(), 4);
+
+   if (!file || magic != decaf::pm4::CaptureMagic) {
+      return false;
+   }
+
+   std::map<uint64_t, MemoryRange> resources;
+
+   while (true) {
+      decaf::pm4::CapturePacket packet;
+      file.read(reinterpret_cast<char *>(&packet), sizeof(decaf::pm4::CapturePacket));
+
+      if (!file) {
+         break;
+      }
+
+      if (packet.type != decaf::pm4::CapturePacket::MemoryLoad) {
+         file.seekg(packet.size, std::ifstream::cur);
+         continue;
+      }
+
+      decaf::pm4::CaptureMemoryLoad load;
+      file.read(reinterpret_cast<char *>(&load), sizeof(decaf::pm4::CaptureMemoryLoad));
+      file.seekg(packet.size - sizeof(decaf::pm4::CaptureMemoryLoad), std::ifstream::cur);
+
+      if (!file) {
+         break;
+      }
+
+      auto range = MemoryRange { load.address, static_cast<uint32_t>(packet.size - sizeof(decaf::pm4::CaptureMemoryLoad)) };
+
+      if (!range.size) {
+         continue;
+      }
+
+      if (load.type == decaf::pm4::CaptureMemoryLoad::CpuFlush
+       || load.type == decaf::pm4::CaptureMemoryLoad::SurfaceSync) {
+         trace.flushes.push_back(range);
+      } else if (isResourceLoad(load.type)) {
+         resources[static_cast<uint64_t>(range.start) << 32 | range.size] = range;
+      }
+   }
+
+   for (auto &resource : resources) {
+      trace.resources.push_back(resource.second);
+   }
+
+   return true;
+}
+
+template<typename Func>
+static double
+timeQueries(const Trace &trace, uint64_t &hits, Func func)
+{
+   auto repeats = (MinimumQueries + trace.flushes.size() - 1) / trace.flushes.size();
+   auto start = Clock::now();
+   hits = 0;
+
+   for (auto i = 0u; i < repeats; ++i) {
+      for (auto &flush : trace.flushes) {
+         hits += func(flush);
+      }
+   }
+
+   auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+   hits /= repeats;
+   return elapsed / (repeats * trace.flushes.size());
+}
+
+static void
+benchmark(const std::string &name, const Trace &trace)
+{
+   std::vector<std::unique_ptr<Resource>> resources;
+   EndpointResourceMap endpointMap;
+   ResourceMemoryMap intervalMap;
+
+   for (auto &range : trace.resources) {
+      auto resource = std::make_unique<Resource>(Resource::SURFACE);
+      resource->cpuMemStart = range.start;
+      resource->cpuMemEnd = range.start + range.size;
+      endpointMap.addResource(resource.get());
+      intervalMap.addResource(resource.get());
+      resources.emplace_back(std::move(resource));
+   }
+
+   uint64_t endpointHits, intervalHits;
+
+   auto endpointTime = timeQueries(trace, endpointHits, [&](const MemoryRange &flush) {
+      auto count = uint64_t { 0 };
+      endpointMap.forEach(flush.start, flush.size, [&](Resource *) { ++count; });
+      return count;
+   });
+
+   auto intervalTime = timeQueries(trace, intervalHits, [&](const MemoryRange &flush) {
+      auto count = uint64_t { 0 };
+      auto iter = intervalMap.getIterator(flush.start, flush.size);
+
+      while (iter.next()) {
+         ++count;
+      }
+
+      return count;
+   });
+
+   gCliLog->info("{}: {} resources, {} flushes", name, trace.resources.size(), trace.flushes.size());
+   gCliLog->info("  endpoint map  {:>8.1f} ns/query  {:>8} hits per replay (endpoints, may count a resource twice)",
+                 endpointTime, endpointHits);
+   gCliLog->info("  interval map  {:>8.1f} ns/query  {:>8} hits per replay",
+                 intervalTime, intervalHits);
+}
+
+int main(int argc, char **argv)
+{
+   std::vector<spdlog::sink_ptr> sinks;
+   sinks.push_back(spdlog::sinks::stdout_sink_st::instance());
+   gCliLog = std::make_shared<spdlog::logger>("resourcemap-benchmark", begin(sinks), end(sinks));
+   gCliLog->set_pattern("%v");
+
+   if (argc < 2) {
+      gCliLog->error("Usage: {} <pm4 capture>...", argv[0]);
+      return 1;
+   }
+
+   for (auto i = 1; i < argc; ++i) {
+      Trace trace;
+
+      if (!readTrace(argv[i], trace)) {
+         gCliLog->error("Could not read pm4 capture {}", argv[i]);
+         return 1;
+      }
+
+      if (trace.flushes.empty()) {
+         gCliLog->warn("{}: no flushes recorded, skipping", argv[i]);
+         continue;
+      }
+
+      benchmark(argv[i], trace);
+   }
+
+   return 0;
+}
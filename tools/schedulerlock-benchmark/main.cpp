@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <common/ticketlock.h>
+#include <cstdint>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+static const auto DefaultThreadCount = 3u;
+static const auto DefaultDurationMs = 1000u;
+
+using Clock = std::chrono::steady_clock;
+
+// The compare and swap spin lock coreinit::internal::lockScheduler used to be
+class SpinLock
+{
+public:
+   void
+   lock()
+   {
+      auto expected = 0u;
+
+      while (!mValue.compare_exchange_weak(expected, 1, std::memory_order_acquire)) {
+         expected = 0;
+      }
+   }
+
+   void
+   unlock()
+   {
+      mValue.store(0, std::memory_order_release);
+   }
+
+private:
+   std::atomic<uint32_t> mValue { 0 };
+};
+
+// Mirrors OSLockMutex / OSUnlockMutex, which take the scheduler lock to check
+//  and update the owner of the mutex.  A guest thread which finds the mutex
+//  owned goes to sleep and is woken under the scheduler lock again, here it
+//  just retries.
+template<typename LockType>
+struct GuestMutex
+{
+   LockType schedulerLock;
+   int owner = -1;
+   uint64_t protectedValue = 0;
+
+   void
+   lock(int thread)
+   {
+      while (true) {
+         schedulerLock.lock();
+
+         if (owner == -1) {
+            owner = thread;
+            schedulerLock.unlock();
+            return;
+         }
+
+         schedulerLock.unlock();
+      }
+   }
+
+   void
+   unlock()
+   {
+      schedulerLock.lock();
+      owner = -1;
+      schedulerLock.unlock();
+   }
+};
+
+static void
+printLockStats(const SpinLock &lock)
+{
+}
+
+static void
+printLockStats(const TicketLock &lock)
+{
+   auto stats = lock.stats();
+
+   gLog->info("  {} acquisitions, {} contended ({:.1f}%), {} spins",
+              stats.acquisitions,
+              stats.contended,
+              stats.acquisitions ? 100.0 * stats.contended / stats.acquisitions : 0.0,
+              stats.spins);
+}
+
+template<typename LockType>
+static void
+benchmark(const std::string &name,
+          unsigned numThreads,
+          unsigned durationMs)
+{
+   auto mutex = std::make_unique<GuestMutex<LockType>>();
+   auto counts = std::vector<uint64_t>(numThreads, 0);
+   auto threads = std::vector<std::thread> { };
+   std::atomic<bool> start { false };
+   std::atomic<bool> stop { false };
+
+   for (auto i = 0u; i < numThreads; ++i) {
+      threads.emplace_back([&, i]() {
+         auto count = uint64_t { 0 };
+
+         while (!start.load()) {
+         }
+
+         while (!stop.load(std::memory_order_relaxed)) {
+            mutex->lock(static_cast<int>(i));
+            mutex->protectedValue++;
+            mutex->unlock();
+            count++;
+         }
+
+         counts[i] = count;
+      });
+   }
+
+   start.store(true);
+   std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
+   stop.store(true);
+
+   for (auto &thread : threads) {
+      thread.join();
+   }
+
+   auto total = uint64_t { 0 };
+
+   for (auto count : counts) {
+      total += count;
+   }
+
+   auto minmax = std::minmax_element(counts.begin(), counts.end());
+   auto seconds = durationMs / 1000.0;
+
+   gLog->info("{}: {:.2f}M lock/unlock per second, per thread min {} max {} ({:.2f}x)",
+              name,
+              total / seconds / 1000000.0,
+              *minmax.first,
+              *minmax.second,
+              *minmax.first ? static_cast<double>(*minmax.second) / *minmax.first : 0.0);
+
+   printLockStats(mutex->schedulerLock);
+}
+
+int main(int argc, char **argv)
+{
+   std::vector<spdlog::sink_ptr> sinks;
+   sinks.push_back(spdlog::sinks::stdout_sink_st::instance());
+   gLog = std::make_shared<spdlog::logger>("decaf", begin(sinks), end(sinks));
+
+   auto numThreads = DefaultThreadCount;
+   auto durationMs = DefaultDurationMs;
+
+   if (argc > 1) {
+      numThreads = static_cast<unsigned>(std::stoul(argv[1]));
+   }
+
+   if (argc > 2) {
+      durationMs = static_cast<unsigned>(std::stoul(argv[2]));
+   }
+
+   if (numThreads == 0 || durationMs == 0) {
+      gLog->error("Usage: {} [threads] [duration ms]", argv[0]);
+      return 1;
+   }
+
+   gLog->info("{} threads hammering a guest mutex for {} ms", numThreads, durationMs);
+   benchmark<SpinLock>("cas spin lock", numThreads, durationMs);
+   benchmark<TicketLock>("ticket lock", numThreads, durationMs);
+   return 0;
+}
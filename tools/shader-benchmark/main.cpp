@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <common/murmur3.h>
+#include <common/workerpool.h>
+#include <cstdlib>
+#include <libcpu/mem.h>
+#include <libdecaf/decaf.h>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "gpu/latte_registers.h"
+#include "gpu/microcode/latte_disassembler.h"
+#include "gpu/opengl/opengl_shader.h"
+#include "pm4-capture/pm4_capture.h"
+
+using gpu::opengl::FetchShader;
+using gpu::opengl::ShaderCache;
+using gpu::opengl::ShaderTranslation;
+
+static std::shared_ptr<spdlog::logger>
+gCliLog;
+
+static const auto BenchmarkIterations = 3u;
+
+using Clock = std::chrono::steady_clock;
+
+// Collects a translation for every distinct set of shaders bound at a draw
+//  in a capture.
+class ShaderCollector : public Pm4CaptureProcessor
+{
+public:
+   const std::vector<std::shared_ptr<ShaderTranslation>> &
+   translations() const
+   {
+      return mTranslations;
+   }
+
+protected:
+   void
+   draw() override
+   {
+      auto pgm_start_fs = getRegister<latte::SQ_PGM_START_FS>(latte::Register::SQ_PGM_START_FS);
+      auto pgm_start_vs = getRegister<latte::SQ_PGM_START_VS>(latte::Register::SQ_PGM_START_VS);
+      auto pgm_start_ps = getRegister<latte::SQ_PGM_START_PS>(latte::Register::SQ_PGM_START_PS);
+      auto pgm_size_fs = getRegister<latte::SQ_PGM_SIZE_FS>(latte::Register::SQ_PGM_SIZE_FS);
+      auto pa_cl_clip_cntl = getRegister<latte::PA_CL_CLIP_CNTL>(latte::Register::PA_CL_CLIP_CNTL);
+
+      if (!pgm_start_fs.PGM_START() || !pgm_start_vs.PGM_START()) {
+         return;
+      }
+
+      auto fsPgmAddress = pgm_start_fs.PGM_START() << 8;
+      auto fsPgmSize = pgm_size_fs.PGM_SIZE() << 3;
+
+      FetchShader fetch;
+      fetch.disassembly = latte::disassemble(gsl::make_span(mem::translate(fsPgmAddress), fsPgmSize), true);
+
+      if (!gpu::opengl::parseFetchShader(fetch, mem::translate(fsPgmAddress), fsPgmSize)) {
+         return;
+      }
+
+      auto translatePixel = !pa_cl_clip_cntl.RASTERISER_DISABLE() && pgm_start_ps.PGM_START();
+      auto translation = gpu::opengl::createShaderTranslation(mRegisters, fetch, nullptr, translatePixel);
+
+      // The same shaders are drawn with over and over, only keep one of each
+      auto key = std::array<uint64_t, 2> { };
+      auto binaries = fetch.disassembly;
+      binaries.append(translation->vertexBinary.begin(), translation->vertexBinary.end());
+      binaries.append(translation->pixelBinary.begin(), translation->pixelBinary.end());
+      MurmurHash3_x64_128(binaries.data(), static_cast<int>(binaries.size()), 0, key.data());
+
+      if (mSeen.insert(key[0] ^ key[1]).second) {
+         mTranslations.emplace_back(std::move(translation));
+      }
+   }
+
+private:
+   std::unordered_set<uint64_t> mSeen;
+   std::vector<std::shared_ptr<ShaderTranslation>> mTranslations;
+};
+
+// Translations hold their results, so every run starts from fresh copies
+static std::vector<std::shared_ptr<ShaderTranslation>>
+copyTranslations(const std::vector<std::shared_ptr<ShaderTranslation>> &translations)
+{
+   std::vector<std::shared_ptr<ShaderTranslation>> result;
+
+   for (auto &translation : translations) {
+      auto copy = std::make_shared<ShaderTranslation>();
+      copy->registers = std::make_unique<gpu::Pm4Processor::Registers>(*translation->registers);
+      copy->isScreenSpace = translation->isScreenSpace;
+      copy->fetch.attribs = translation->fetch.attribs;
+      copy->fetch.disassembly = translation->fetch.disassembly;
+      copy->translateVertex = translation->translateVertex;
+      copy->vertexBinary = translation->vertexBinary;
+      copy->translatePixel = translation->translatePixel;
+      copy->pixelBinary = translation->pixelBinary;
+      result.emplace_back(std::move(copy));
+   }
+
+   return result;
+}
+
+int main(int argc, char **argv)
+{
+   std::vector<spdlog::sink_ptr> sinks;
+   sinks.push_back(spdlog::sinks::stdout_sink_st::instance());
+   gCliLog = std::make_shared<spdlog::logger>("shader-benchmark", begin(sinks), end(sinks));
+   gCliLog->set_pattern("%v");
+   decaf::initialiseLogging(sinks, spdlog::level::warn);
+
+   if (argc < 2) {
+      gCliLog->error("Usage: {} <pm4 capture> [max threads]", argv[0]);
+      return 1;
+   }
+
+   auto maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+   if (argc > 2) {
+      maxThreads = std::max(1, std::atoi(argv[2]));
+   }
+
+   mem::initialise();
+
+   ShaderCollector collector;
+
+   if (!collector.readCapture(argv[1])) {
+      gCliLog->error("Could not read pm4 capture {}", argv[1]);
+      return 1;
+   }
+
+   auto &translations = collector.translations();
+   gCliLog->info("Translating {} distinct shader pipelines, best of {} runs", translations.size(), BenchmarkIterations);
+
+   // The cache is never opened so every shader is translated from scratch
+   ShaderCache cache;
+   auto baseline = 0.0;
+
+   for (auto threads = 1u; threads <= maxThreads; ++threads) {
+      // The thread calling parallelFor does its share of the work
+      WorkerPool pool { "Shader Benchmark", threads - 1 };
+      auto best = Clock::duration::max();
+      auto numFailed = 0u;
+
+      for (auto i = 0u; i < BenchmarkIterations; ++i) {
+         auto jobs = copyTranslations(translations);
+         auto start = Clock::now();
+
+         pool.parallelFor(static_cast<unsigned>(jobs.size()), [&](unsigned index) {
+            gpu::opengl::runShaderTranslation(*jobs[index], cache);
+         });
+
+         best = std::min(best, Clock::now() - start);
+         numFailed = static_cast<unsigned>(std::count_if(jobs.begin(), jobs.end(),
+                                                         [](auto &job) { return !job->success; }));
+      }
+
+      auto ms = std::chrono::duration<double, std::milli>(best).count();
+
+      if (threads == 1) {
+         baseline = ms;
+      }
+
+      gCliLog->info("{:>2} threads: {:>9.2f} ms, {:.2f}x, {} failed",
+                    threads, ms, baseline / ms, numFailed);
+   }
+
+   return 0;
+}
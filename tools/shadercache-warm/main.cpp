@@ -0,0 +1,157 @@
+#include <libcpu/mem.h>
+#include <libdecaf/decaf.h>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+#include "gpu/latte_registers.h"
+#include "gpu/microcode/latte_disassembler.h"
+#include "gpu/opengl/opengl_shader.h"
+#include "pm4-capture/pm4_capture.h"
+
+using gpu::opengl::FetchShader;
+using gpu::opengl::PixelShader;
+using gpu::opengl::ShaderCache;
+using gpu::opengl::VertexShader;
+
+static std::shared_ptr<spdlog::logger>
+gCliLog;
+
+// Translates the shaders bound at every draw of a capture into the shader
+//  cache.
+class ShaderCacheWarmer : public Pm4CaptureProcessor
+{
+public:
+   ShaderCacheWarmer(ShaderCache &cache) :
+      mCache(cache)
+   {
+   }
+
+   unsigned
+   numDraws() const
+   {
+      return mNumDraws;
+   }
+
+   unsigned
+   numFailed() const
+   {
+      return mNumFailed;
+   }
+
+protected:
+   // Mirrors the shader selection of GLDriver::checkActiveShader
+   void
+   draw() override
+   {
+      auto pgm_start_fs = getRegister<latte::SQ_PGM_START_FS>(latte::Register::SQ_PGM_START_FS);
+      auto pgm_start_vs = getRegister<latte::SQ_PGM_START_VS>(latte::Register::SQ_PGM_START_VS);
+      auto pgm_start_ps = getRegister<latte::SQ_PGM_START_PS>(latte::Register::SQ_PGM_START_PS);
+      auto pgm_size_fs = getRegister<latte::SQ_PGM_SIZE_FS>(latte::Register::SQ_PGM_SIZE_FS);
+      auto pgm_size_vs = getRegister<latte::SQ_PGM_SIZE_VS>(latte::Register::SQ_PGM_SIZE_VS);
+      auto pgm_size_ps = getRegister<latte::SQ_PGM_SIZE_PS>(latte::Register::SQ_PGM_SIZE_PS);
+      auto pa_cl_clip_cntl = getRegister<latte::PA_CL_CLIP_CNTL>(latte::Register::PA_CL_CLIP_CNTL);
+      auto vgt_primitive_type = getRegister<latte::VGT_PRIMITIVE_TYPE>(latte::Register::VGT_PRIMITIVE_TYPE);
+      auto isScreenSpace = (vgt_primitive_type.PRIM_TYPE() == latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST);
+
+      mNumDraws++;
+
+      if (!pgm_start_fs.PGM_START() || !pgm_start_vs.PGM_START()) {
+         mNumFailed++;
+         return;
+      }
+
+      auto fsPgmAddress = pgm_start_fs.PGM_START() << 8;
+      auto vsPgmAddress = pgm_start_vs.PGM_START() << 8;
+      auto psPgmAddress = pgm_start_ps.PGM_START() << 8;
+      auto fsPgmSize = pgm_size_fs.PGM_SIZE() << 3;
+      auto vsPgmSize = pgm_size_vs.PGM_SIZE() << 3;
+      auto psPgmSize = pgm_size_ps.PGM_SIZE() << 3;
+
+      FetchShader fetch;
+      fetch.cpuMemStart = fsPgmAddress;
+      fetch.cpuMemEnd = fsPgmAddress + fsPgmSize;
+      fetch.disassembly = latte::disassemble(gsl::make_span(mem::translate(fsPgmAddress), fsPgmSize), true);
+
+      if (!gpu::opengl::parseFetchShader(fetch, mem::translate(fsPgmAddress), fsPgmSize)) {
+         mNumFailed++;
+         return;
+      }
+
+      VertexShader vertex;
+
+      if (!gpu::opengl::translateVertexShader(mRegisters, mCache, vertex, fetch, mem::translate(vsPgmAddress), vsPgmSize, isScreenSpace)) {
+         mNumFailed++;
+         return;
+      }
+
+      if (pa_cl_clip_cntl.RASTERISER_DISABLE() || !psPgmAddress) {
+         return;
+      }
+
+      PixelShader pixel;
+
+      if (!gpu::opengl::translatePixelShader(mRegisters, mCache, pixel, vertex, mem::translate(psPgmAddress), psPgmSize)) {
+         mNumFailed++;
+      }
+   }
+
+private:
+   ShaderCache &mCache;
+   unsigned mNumDraws = 0;
+   unsigned mNumFailed = 0;
+};
+
+int main(int argc, char **argv)
+{
+   std::vector<spdlog::sink_ptr> sinks;
+   sinks.push_back(spdlog::sinks::stdout_sink_st::instance());
+   gCliLog = std::make_shared<spdlog::logger>("shadercache-warm", begin(sinks), end(sinks));
+   gCliLog->set_pattern("%v");
+   decaf::initialiseLogging(sinks, spdlog::level::warn);
+
+   std::vector<std::string> captures;
+   std::string cachePath;
+
+   for (auto i = 1; i < argc; ++i) {
+      auto arg = std::string { argv[i] };
+
+      if (arg == "--cache" && i + 1 < argc) {
+         cachePath = argv[++i];
+      } else {
+         captures.push_back(arg);
+      }
+   }
+
+   if (captures.empty()) {
+      gCliLog->error("Usage: {} [--cache <shader cache>] <pm4 capture>...", argv[0]);
+      return 1;
+   }
+
+   if (cachePath.empty()) {
+      decaf::createConfigDirectory();
+      cachePath = decaf::makeConfigPath("shader_cache.bin");
+   }
+
+   mem::initialise();
+
+   ShaderCache cache;
+   cache.open(cachePath);
+
+   auto cachedShaders = cache.size();
+   ShaderCacheWarmer warmer { cache };
+
+   for (auto &capture : captures) {
+      if (!warmer.readCapture(capture)) {
+         gCliLog->error("Could not read pm4 capture {}", capture);
+         return 1;
+      }
+   }
+
+   gCliLog->info("{} draws, {} shaders already cached, {} shaders added, {} failed",
+                 warmer.numDraws(), cachedShaders, cache.size() - cachedShaders, warmer.numFailed());
+
+   // Waits for the new shaders to be written
+   cache.close();
+   return 0;
+}
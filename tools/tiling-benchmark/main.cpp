@@ -0,0 +1,307 @@
+#include <addrlib/addrinterface.h>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+#include "gpu/gpu_tiling.h"
+
+static std::shared_ptr<spdlog::logger>
+gCliLog;
+
+static const auto DefaultWidth = 1280u;
+static const auto DefaultHeight = 720u;
+static const auto BenchmarkIterations = 10u;
+
+using Clock = std::chrono::steady_clock;
+
+struct TileModeInfo
+{
+   AddrTileMode mode;
+   const char *name;
+};
+
+static const TileModeInfo
+sTileModes[] = {
+   { ADDR_TM_LINEAR_ALIGNED, "LINEAR_ALIGNED" },
+   { ADDR_TM_1D_TILED_THIN1, "1D_TILED_THIN1" },
+   { ADDR_TM_1D_TILED_THICK, "1D_TILED_THICK" },
+   { ADDR_TM_2D_TILED_THIN1, "2D_TILED_THIN1" },
+   { ADDR_TM_2D_TILED_THIN2, "2D_TILED_THIN2" },
+   { ADDR_TM_2D_TILED_THIN4, "2D_TILED_THIN4" },
+   { ADDR_TM_2D_TILED_THICK, "2D_TILED_THICK" },
+   { ADDR_TM_2B_TILED_THIN1, "2B_TILED_THIN1" },
+   { ADDR_TM_2B_TILED_THIN2, "2B_TILED_THIN2" },
+   { ADDR_TM_2B_TILED_THIN4, "2B_TILED_THIN4" },
+   { ADDR_TM_2B_TILED_THICK, "2B_TILED_THICK" },
+   { ADDR_TM_3D_TILED_THIN1, "3D_TILED_THIN1" },
+   { ADDR_TM_3D_TILED_THICK, "3D_TILED_THICK" },
+   { ADDR_TM_3B_TILED_THIN1, "3B_TILED_THIN1" },
+   { ADDR_TM_3B_TILED_THICK, "3B_TILED_THICK" },
+};
+
+// Surfaces typical of what GLDriver::uploadSurface untiles
+struct SurfaceShape
+{
+   const char *name;
+   uint32_t width;
+   uint32_t height;
+   uint32_t depth;
+   uint32_t bpp;
+};
+
+static const SurfaceShape
+sSurfaceShapes[] = {
+   { "1080p target", 1920, 1080, 1, 32 },
+   { "cubemap", 512, 512, 6, 32 },
+   { "array", 256, 256, 16, 64 },
+};
+
+static const uint32_t
+sBitsPerPixel[] = { 8, 16, 32, 64, 96, 128 };
+
+static ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT
+makeAddrInput(AddrTileMode tileMode,
+              uint32_t bpp,
+              uint32_t pitch,
+              uint32_t height,
+              uint32_t numSlices)
+{
+   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT input;
+   std::memset(&input, 0, sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT));
+   input.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT);
+   input.bpp = bpp;
+   input.pitch = pitch;
+   input.height = height;
+   input.numSlices = numSlices;
+   input.numSamples = 1;
+   input.tileMode = tileMode;
+   return input;
+}
+
+static bool
+computeSurfaceInfo(AddrTileMode tileMode,
+                   uint32_t bpp,
+                   uint32_t width,
+                   uint32_t height,
+                   uint32_t numSlices,
+                   ADDR_COMPUTE_SURFACE_INFO_OUTPUT &output)
+{
+   ADDR_COMPUTE_SURFACE_INFO_INPUT input;
+   std::memset(&input, 0, sizeof(ADDR_COMPUTE_SURFACE_INFO_INPUT));
+   std::memset(&output, 0, sizeof(ADDR_COMPUTE_SURFACE_INFO_OUTPUT));
+   input.size = sizeof(ADDR_COMPUTE_SURFACE_INFO_INPUT);
+   output.size = sizeof(ADDR_COMPUTE_SURFACE_INFO_OUTPUT);
+
+   input.tileMode = tileMode;
+   input.bpp = bpp;
+   input.width = width;
+   input.height = height;
+   input.numSlices = numSlices;
+   input.numSamples = 1;
+   input.numFrags = 1;
+   input.flags.inputBaseMap = 1;
+
+   return AddrComputeSurfaceInfo(gpu::getAddrLibHandle(), &input, &output) == ADDR_OK;
+}
+
+// Untile one pixel at a time using addrlib, this is the reference output
+static void
+untileReference(uint8_t *dst,
+                ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &dstInput,
+                uint8_t *src,
+                ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcInput,
+                uint32_t width,
+                uint32_t height)
+{
+   auto handle = gpu::getAddrLibHandle();
+   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT srcOutput;
+   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT dstOutput;
+   std::memset(&srcOutput, 0, sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT));
+   std::memset(&dstOutput, 0, sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT));
+   srcOutput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT);
+   dstOutput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT);
+
+   for (auto y = 0u; y < height; ++y) {
+      for (auto x = 0u; x < width; ++x) {
+         srcInput.x = x;
+         srcInput.y = y;
+         AddrComputeSurfaceAddrFromCoord(handle, &srcInput, &srcOutput);
+
+         dstInput.x = x;
+         dstInput.y = y;
+         AddrComputeSurfaceAddrFromCoord(handle, &dstInput, &dstOutput);
+
+         std::memcpy(dst + dstOutput.addr, src + srcOutput.addr, dstInput.bpp / 8);
+      }
+   }
+}
+
+template<typename Func>
+static double
+measureThroughput(uint64_t bytesPerIteration, Func func)
+{
+   auto start = Clock::now();
+
+   for (auto i = 0u; i < BenchmarkIterations; ++i) {
+      func();
+   }
+
+   auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+   return (bytesPerIteration * BenchmarkIterations) / seconds / (1024.0 * 1024.0);
+}
+
+static bool
+benchmark(const TileModeInfo &tileMode,
+          uint32_t bpp,
+          uint32_t width,
+          uint32_t height)
+{
+   auto numSlices = 1u;
+   ADDR_COMPUTE_SURFACE_INFO_OUTPUT info;
+
+   if (!computeSurfaceInfo(tileMode.mode, bpp, width, height, numSlices, info)) {
+      gCliLog->error("{} {}bpp: AddrComputeSurfaceInfo failed", tileMode.name, bpp);
+      return false;
+   }
+
+   auto tiled = std::vector<uint8_t>(info.surfSize);
+   auto linearSize = static_cast<size_t>(width) * height * (bpp / 8);
+   auto reference = std::vector<uint8_t>(linearSize);
+   auto untiled = std::vector<uint8_t>(linearSize);
+
+   std::mt19937 random { bpp ^ static_cast<uint32_t>(tileMode.mode) };
+
+   for (auto &byte : tiled) {
+      byte = static_cast<uint8_t>(random());
+   }
+
+   auto srcInput = makeAddrInput(tileMode.mode, bpp, info.pitch, info.height, numSlices);
+   auto dstInput = makeAddrInput(ADDR_TM_LINEAR_GENERAL, bpp, width, height, numSlices);
+
+   auto referenceSpeed = measureThroughput(linearSize, [&]() {
+      untileReference(reference.data(), dstInput, tiled.data(), srcInput, width, height);
+   });
+
+   auto optimisedSpeed = measureThroughput(linearSize, [&]() {
+      gpu::copySurfacePixels(untiled.data(), width, height, dstInput,
+                             tiled.data(), width, height, srcInput);
+   });
+
+   auto matches = (reference == untiled);
+
+   gCliLog->info("{:<15} {:>3}bpp  addrlib {:>8.1f} MB/s  optimised {:>8.1f} MB/s  {:>5.1f}x  {}",
+                 tileMode.name,
+                 bpp,
+                 referenceSpeed,
+                 optimisedSpeed,
+                 optimisedSpeed / referenceSpeed,
+                 matches ? "ok" : "MISMATCH");
+   return matches;
+}
+
+template<typename Func>
+static double
+measureMilliseconds(Func func)
+{
+   auto start = Clock::now();
+
+   for (auto i = 0u; i < BenchmarkIterations; ++i) {
+      func();
+   }
+
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / BenchmarkIterations;
+}
+
+// Compares gpu::convertFromTiled with gpu::convertFromTiledParallel
+static bool
+benchmarkParallel(const TileModeInfo &tileMode,
+                  const SurfaceShape &shape)
+{
+   ADDR_COMPUTE_SURFACE_INFO_OUTPUT info;
+
+   if (!computeSurfaceInfo(tileMode.mode, shape.bpp, shape.width, shape.height, shape.depth, info)) {
+      gCliLog->error("{} {}: AddrComputeSurfaceInfo failed", tileMode.name, shape.name);
+      return false;
+   }
+
+   auto tiled = std::vector<uint8_t>(info.surfSize);
+   auto linearSize = static_cast<size_t>(shape.width) * shape.height * shape.depth * (shape.bpp / 8);
+   auto serial = std::vector<uint8_t>(linearSize);
+   auto parallel = std::vector<uint8_t>(linearSize);
+
+   std::mt19937 random { shape.width ^ static_cast<uint32_t>(tileMode.mode) };
+
+   for (auto &byte : tiled) {
+      byte = static_cast<uint8_t>(random());
+   }
+
+   auto sqTileMode = static_cast<latte::SQ_TILE_MODE>(tileMode.mode);
+
+   auto serialTime = measureMilliseconds([&]() {
+      gpu::convertFromTiled(serial.data(), shape.width, tiled.data(), sqTileMode, 0,
+                            info.pitch, shape.width, shape.height, shape.depth, 0, false, shape.bpp);
+   });
+
+   auto parallelTime = measureMilliseconds([&]() {
+      gpu::convertFromTiledParallel(parallel.data(), shape.width, tiled.data(), sqTileMode, 0,
+                                    info.pitch, shape.width, shape.height, shape.depth, 0, false, shape.bpp);
+   });
+
+   auto matches = (serial == parallel);
+
+   gCliLog->info("{:<15} {:<12}  serial {:>8.3f} ms  parallel {:>8.3f} ms  {:>5.1f}x  {}",
+                 tileMode.name,
+                 shape.name,
+                 serialTime,
+                 parallelTime,
+                 serialTime / parallelTime,
+                 matches ? "ok" : "MISMATCH");
+   return matches;
+}
+
+int main(int argc, char **argv)
+{
+   std::vector<spdlog::sink_ptr> sinks;
+   sinks.push_back(spdlog::sinks::stdout_sink_st::instance());
+   gCliLog = std::make_shared<spdlog::logger>("tiling-benchmark", begin(sinks), end(sinks));
+   gCliLog->set_pattern("%v");
+
+   auto width = DefaultWidth;
+   auto height = DefaultHeight;
+
+   if (argc > 2) {
+      width = static_cast<uint32_t>(std::stoul(argv[1]));
+      height = static_cast<uint32_t>(std::stoul(argv[2]));
+   }
+
+   if (width == 0 || height == 0) {
+      gCliLog->error("Usage: {} [width height]", argv[0]);
+      return 1;
+   }
+
+   gCliLog->info("Untiling {}x{} surfaces, {} iterations each", width, height, BenchmarkIterations);
+   auto result = 0;
+
+   for (auto &tileMode : sTileModes) {
+      for (auto bpp : sBitsPerPixel) {
+         if (!benchmark(tileMode, bpp, width, height)) {
+            result = 1;
+         }
+      }
+   }
+
+   gCliLog->info("Untiling with convertFromTiled and convertFromTiledParallel");
+
+   for (auto &tileMode : sTileModes) {
+      for (auto &shape : sSurfaceShapes) {
+         if (!benchmarkParallel(tileMode, shape)) {
+            result = 1;
+         }
+      }
+   }
+
+   return result;
+}